@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRArraySlice.h"
+
+
+@interface JLRArraySlice ()
+
+@property (nonatomic, strong) NSArray *array;
+@property (nonatomic, assign) NSRange range;
+
+@end
+
+
+@implementation JLRArraySlice
+
+- (instancetype)init
+{
+    return [self initWithArray:@[] range:NSMakeRange(0, 0)];
+}
+
+- (instancetype)initWithArray:(NSArray *)array range:(NSRange)range
+{
+    NSParameterAssert(NSMaxRange(range) <= array.count);
+    
+    if ((self = [super init])) {
+        if ([array isKindOfClass:[JLRArraySlice class]]) {
+            // look straight into the innermost array
+            JLRArraySlice *slice = (JLRArraySlice *)array;
+            range.location += slice.range.location;
+            array = slice.array;
+        }
+        
+        // copying an immutable array just retains it
+        self.array = [array copy];
+        self.range = range;
+    }
+    return self;
+}
+
+- (instancetype)initWithObjects:(const id [])objects count:(NSUInteger)count
+{
+    return [self initWithArray:[[NSArray alloc] initWithObjects:objects count:count] range:NSMakeRange(0, count)];
+}
+
+
+#pragma mark - NSArray
+
+- (NSUInteger)count
+{
+    return self.range.length;
+}
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    if (index >= self.range.length) {
+        [NSException raise:NSRangeException format:@"index %@ beyond bounds of a slice of %@ objects", @(index), @(self.range.length)];
+    }
+    return [self.array objectAtIndex:self.range.location + index];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // the backing array is immutable, so this is too
+    return self;
+}
+
+- (Class)classForCoder
+{
+    return [NSArray class];
+}
+
+@end
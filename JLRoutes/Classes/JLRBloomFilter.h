@@ -0,0 +1,51 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRBloomFilter is a fixed size Bloom filter over precomputed hashes.
+ 
+ A hash that was added is always reported as possibly present. A hash that was never added is usually reported as absent,
+ and the filter is sized so that it wrongly reports one as present well under 1% of the time.
+ */
+
+@interface JLRBloomFilter : NSObject
+
+/**
+ Creates a new, empty filter.
+ 
+ @param count The number of hashes the filter is expected to hold.
+ 
+ @returns The newly initialized filter.
+ */
+- (instancetype)initWithExpectedCount:(NSUInteger)count NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, use initWithExpectedCount: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, use initWithExpectedCount: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+/// Adds a hash to the filter. Not thread safe, filters are meant to be filled before they are shared.
+- (void)addHash:(NSUInteger)hash;
+
+/// Returns NO if the hash definitely wasn't added, YES if it might have been.
+- (BOOL)mayContainHash:(NSUInteger)hash;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
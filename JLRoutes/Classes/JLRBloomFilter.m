@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRBloomFilter.h"
+
+
+// three probes into 16 bits per expected hash keep false positives to about 0.5%
+static const NSUInteger JLRBloomFilterBitsPerHash = 16;
+static const NSUInteger JLRBloomFilterProbeCount = 3;
+
+
+static NSUInteger JLRBloomFilterStep(NSUInteger hash)
+{
+    // double hashing, the second hash is taken from the high bits and kept odd so every probe lands on a different bit
+    return (hash >> (sizeof(NSUInteger) * 4)) | 1;
+}
+
+
+@interface JLRBloomFilter () {
+    uint8_t *_bits;
+    NSUInteger _bitMask;
+}
+
+@end
+
+
+@implementation JLRBloomFilter
+
+- (instancetype)initWithExpectedCount:(NSUInteger)count
+{
+    if ((self = [super init])) {
+        // round up to a power of two so that a probe is a mask rather than a division
+        NSUInteger bitCount = 64;
+        while (bitCount < count * JLRBloomFilterBitsPerHash) {
+            bitCount <<= 1;
+        }
+        
+        _bits = calloc(bitCount / 8, sizeof(uint8_t));
+        _bitMask = bitCount - 1;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_bits);
+}
+
+- (void)addHash:(NSUInteger)hash
+{
+    NSUInteger step = JLRBloomFilterStep(hash);
+    
+    for (NSUInteger probe = 0; probe < JLRBloomFilterProbeCount; probe++) {
+        NSUInteger bit = (hash + probe * step) & _bitMask;
+        _bits[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    }
+}
+
+- (BOOL)mayContainHash:(NSUInteger)hash
+{
+    NSUInteger step = JLRBloomFilterStep(hash);
+    
+    for (NSUInteger probe = 0; probe < JLRBloomFilterProbeCount; probe++) {
+        NSUInteger bit = (hash + probe * step) & _bitMask;
+        if ((_bits[bit >> 3] & (1 << (bit & 7))) == 0) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+@end
@@ -0,0 +1,57 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/// How important a logged message is. Each level includes the levels before it, see +[JLRoutes setLogLevel:].
+typedef NS_ENUM(NSUInteger, JLRLogLevel) {
+    /// Nothing is logged.
+    JLRLogLevelOff,
+    /// Routes that can't be parsed or loaded.
+    JLRLogLevelError,
+    /// Requests that are turned down without an error to explain why, such as asking for the compiled route table of routes that can't be compiled.
+    JLRLogLevelWarning,
+    /// Changes to the registered routes and the outcome of routing each URL.
+    JLRLogLevelInfo,
+    /// Every step of routing, including the routes tried and the parameters passed to handlers.
+    JLRLogLevelDebug,
+};
+
+
+/**
+ A JLRLogger receives the messages JLRoutes logs, see +[JLRoutes setLogger:].
+ 
+ Messages are only formatted, and loggers only called, for levels that +[JLRoutes logLevel] includes.
+ */
+
+@protocol JLRLogger <NSObject>
+
+/// Logs a message. May be called on any thread, including several at once.
+- (void)logMessage:(NSString *)message level:(JLRLogLevel)level;
+
+@end
+
+
+/**
+ JLROSLogger is the default logger. It logs to os_log with the com.joeldev.JLRoutes subsystem, mapping each level to the closest
+ os_log type so that debug and info messages cost little unless they're being streamed, and falls back to NSLog where os_log isn't available.
+ */
+
+@interface JLROSLogger : NSObject <JLRLogger>
+
+@end
+
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,60 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if __has_include(<os/signpost.h>)
+#import <os/log.h>
+#endif
+#import "JLRLogger.h"
+
+
+@implementation JLROSLogger
+
+- (void)logMessage:(NSString *)message level:(JLRLogLevel)level
+{
+    // @available needs the same SDKs that have os/signpost.h, see JLRoutes.m
+#if __has_include(<os/signpost.h>)
+    if (@available(iOS 10.0, macOS 10.12, tvOS 10.0, watchOS 3.0, *)) {
+        static os_log_t log = NULL;
+        static dispatch_once_t onceToken;
+        dispatch_once(&onceToken, ^{
+            log = os_log_create("com.joeldev.JLRoutes", "General");
+        });
+        
+        os_log_type_t type = OS_LOG_TYPE_DEFAULT;
+        switch (level) {
+            case JLRLogLevelOff:
+                return;
+            case JLRLogLevelError:
+                type = OS_LOG_TYPE_ERROR;
+                break;
+            case JLRLogLevelWarning:
+                type = OS_LOG_TYPE_DEFAULT;
+                break;
+            case JLRLogLevelInfo:
+                type = OS_LOG_TYPE_INFO;
+                break;
+            case JLRLogLevelDebug:
+                type = OS_LOG_TYPE_DEBUG;
+                break;
+        }
+        
+        os_log_with_type(log, type, "%{public}@", message);
+        return;
+    }
+#endif
+    
+    if (level != JLRLogLevelOff) {
+        NSLog(@"[JLRoutes]: %@", message);
+    }
+}
+
+@end
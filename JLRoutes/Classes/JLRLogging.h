@@ -0,0 +1,46 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "JLRLogger.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/// The most verbose level that is logged. Set through +[JLRoutes setLogLevel:], read by routing threads without a lock.
+extern _Atomic(JLRLogLevel) JLRLogLevelThreshold;
+
+/// Returns YES if messages of level are logged.
+NS_INLINE BOOL JLRShouldLog(JLRLogLevel level)
+{
+    // relaxed, a message logged or dropped around a change of level doesn't need ordering against anything else
+    return level != JLRLogLevelOff && level <= atomic_load_explicit(&JLRLogLevelThreshold, memory_order_relaxed);
+}
+
+/// Formats a message and passes it to the current logger, whatever the threshold. Use JLRLog instead.
+void JLRLogMessage(JLRLogLevel level, NSString *format, ...) NS_FORMAT_FUNCTION(2, 3);
+
+/// The logger JLRLogMessage passes messages to. Set through +[JLRoutes setLogger:], never nil.
+id <JLRLogger> JLRCurrentLogger(void);
+void JLRSetCurrentLogger(id <JLRLogger> _Nullable logger);
+
+/// Logs a message if its level is logged. The level is checked before any of the arguments are evaluated, so a message that
+/// isn't logged costs one comparison.
+#define JLRLog(level, format, ...) do { \
+    if (JLRShouldLog(level)) { \
+        JLRLogMessage((level), (format), ##__VA_ARGS__); \
+    } \
+} while (0)
+
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,55 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+#import "JLRLogging.h"
+
+
+_Atomic(JLRLogLevel) JLRLogLevelThreshold = JLRLogLevelError;
+
+// guards replacing the logger, messages take a reference to it under the lock and log outside of it
+static pthread_mutex_t loggerLock = PTHREAD_MUTEX_INITIALIZER;
+static id <JLRLogger> currentLogger = nil;
+
+
+id <JLRLogger> JLRCurrentLogger(void)
+{
+    pthread_mutex_lock(&loggerLock);
+    if (currentLogger == nil) {
+        currentLogger = [[JLROSLogger alloc] init];
+    }
+    id <JLRLogger> logger = currentLogger;
+    pthread_mutex_unlock(&loggerLock);
+    
+    return logger;
+}
+
+void JLRSetCurrentLogger(id <JLRLogger> logger)
+{
+    pthread_mutex_lock(&loggerLock);
+    currentLogger = logger;
+    pthread_mutex_unlock(&loggerLock);
+}
+
+void JLRLogMessage(JLRLogLevel level, NSString *format, ...)
+{
+    if (format.length == 0) {
+        return;
+    }
+    
+    va_list argsList;
+    va_start(argsList, format);
+    NSString *message = [[NSString alloc] initWithFormat:format arguments:argsList];
+    va_end(argsList);
+    
+    [JLRCurrentLogger() logMessage:message level:level];
+}
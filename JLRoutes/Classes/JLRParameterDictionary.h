@@ -0,0 +1,56 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRParameterDictionary is a read-only dictionary made of layers of other dictionaries.
+ 
+ A key is looked up in each layer in turn and the first layer that has it wins, so the layers are never merged into a
+ single copy. This is how the parameters passed to route handlers are built without copying the query params, the route
+ params and the base match parameters into one dictionary for every dispatch.
+ 
+ The layers are expected to be immutable, mutable layers are copied when they are added.
+ */
+
+@interface JLRParameterDictionary : NSDictionary
+
+/// The layers being looked through, highest precedence first.
+@property (nonatomic, copy, readonly) NSArray <NSDictionary *> *layers;
+
+/**
+ Creates a new dictionary from layers of dictionaries.
+ 
+ @param layers The layers to look keys up in, highest precedence first. Nested JLRParameterDictionary layers are flattened.
+ 
+ @returns The newly initialized dictionary.
+ */
+- (instancetype)initWithLayers:(NSArray <NSDictionary *> *)layers;
+
+/**
+ Layers the given dictionaries, highest precedence first.
+ 
+ Empty layers are dropped. If only one layer is left it is returned as is, so layering a dictionary over nothing is free.
+ 
+ @param dictionaries The dictionaries to layer, highest precedence first.
+ 
+ @returns A dictionary equal to merging the dictionaries from last to first.
+ */
++ (NSDictionary *)dictionaryByLayeringDictionaries:(NSArray <NSDictionary *> *)dictionaries;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
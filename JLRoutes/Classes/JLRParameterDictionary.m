@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRParameterDictionary.h"
+
+
+static NSArray <NSDictionary *> *JLRFlattenedLayers(NSArray <NSDictionary *> *layers)
+{
+    NSMutableArray <NSDictionary *> *flattenedLayers = [NSMutableArray arrayWithCapacity:layers.count];
+    
+    for (NSDictionary *layer in layers) {
+        if ([layer isKindOfClass:[JLRParameterDictionary class]]) {
+            [flattenedLayers addObjectsFromArray:((JLRParameterDictionary *)layer).layers];
+        } else if (layer.count > 0) {
+            // copying an immutable dictionary just retains it
+            [flattenedLayers addObject:[layer copy]];
+        }
+    }
+    
+    return flattenedLayers;
+}
+
+
+@interface JLRParameterDictionary () {
+    NSUInteger _count;
+}
+
+@property (nonatomic, copy) NSArray <NSDictionary *> *layers;
+@property (atomic, copy) NSArray *mergedKeys;
+
+@end
+
+
+@implementation JLRParameterDictionary
+
++ (NSDictionary *)dictionaryByLayeringDictionaries:(NSArray <NSDictionary *> *)dictionaries
+{
+    NSArray <NSDictionary *> *layers = JLRFlattenedLayers(dictionaries);
+    
+    if (layers.count == 0) {
+        return @{};
+    } else if (layers.count == 1) {
+        return [layers firstObject];
+    }
+    
+    return [[JLRParameterDictionary alloc] initWithLayers:layers];
+}
+
+- (instancetype)init
+{
+    return [self initWithLayers:@[]];
+}
+
+- (instancetype)initWithLayers:(NSArray <NSDictionary *> *)layers
+{
+    if ((self = [super init])) {
+        self.layers = JLRFlattenedLayers(layers);
+        _count = NSNotFound;
+    }
+    return self;
+}
+
+- (instancetype)initWithObjects:(const id [])objects forKeys:(const id <NSCopying> [])keys count:(NSUInteger)count
+{
+    return [self initWithLayers:@[[[NSDictionary alloc] initWithObjects:objects forKeys:keys count:count]]];
+}
+
+
+#pragma mark - NSDictionary
+
+- (NSUInteger)count
+{
+    if (_count == NSNotFound) {
+        // counting keys that aren't shadowed by an earlier layer doesn't need the merged keys themselves
+        NSUInteger count = 0;
+        NSUInteger layerCount = self.layers.count;
+        
+        for (NSUInteger index = 0; index < layerCount; index++) {
+            for (id key in self.layers[index]) {
+                if (![self _layersBeforeIndex:index containKey:key]) {
+                    count++;
+                }
+            }
+        }
+        
+        _count = count;
+    }
+    
+    return _count;
+}
+
+- (id)objectForKey:(id)key
+{
+    for (NSDictionary *layer in self.layers) {
+        id object = [layer objectForKey:key];
+        if (object != nil) {
+            return object;
+        }
+    }
+    
+    return nil;
+}
+
+- (NSEnumerator *)keyEnumerator
+{
+    return [[self _mergedKeys] objectEnumerator];
+}
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id __unsafe_unretained [])buffer count:(NSUInteger)len
+{
+    return [[self _mergedKeys] countByEnumeratingWithState:state objects:buffer count:len];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // every layer is immutable, so this is too
+    return self;
+}
+
+- (Class)classForCoder
+{
+    return [NSDictionary class];
+}
+
+
+#pragma mark - Private
+
+- (BOOL)_layersBeforeIndex:(NSUInteger)layerIndex containKey:(id)key
+{
+    for (NSUInteger index = 0; index < layerIndex; index++) {
+        if ([self.layers[index] objectForKey:key] != nil) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+- (NSArray *)_mergedKeys
+{
+    NSArray *mergedKeys = self.mergedKeys;
+    
+    if (mergedKeys == nil) {
+        // only built when something actually enumerates the parameters
+        NSMutableArray *keys = [NSMutableArray array];
+        NSUInteger layerCount = self.layers.count;
+        
+        for (NSUInteger index = 0; index < layerCount; index++) {
+            for (id key in self.layers[index]) {
+                if (![self _layersBeforeIndex:index containKey:key]) {
+                    [keys addObject:key];
+                }
+            }
+        }
+        
+        mergedKeys = [keys copy];
+        self.mergedKeys = mergedKeys;
+    }
+    
+    return mergedKeys;
+}
+
+@end
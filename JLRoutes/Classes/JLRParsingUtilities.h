@@ -19,10 +19,35 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (NSString *)variableValueFrom:(NSString *)value decodePlusSymbols:(BOOL)decodePlusSymbols;
 
+/**
+ Percent decodes a path component captured by a route variable, strips a trailing '#' and optionally decodes plus symbols.
+ 
+ The component is scanned once and returned as is when there is nothing to decode, otherwise it is decoded in a single
+ pass into one buffer.
+ 
+ @param pathComponent The path component to decode.
+ @param decodePlusSymbols Whether or not to replace '+' with ' ', including a '+' that was percent encoded.
+ 
+ @returns The variable value, or nil if the component isn't valid percent encoded UTF-8.
+ */
++ (nullable NSString *)variableValueByDecodingPathComponent:(NSString *)pathComponent decodePlusSymbols:(BOOL)decodePlusSymbols;
+
 + (NSDictionary *)queryParams:(NSDictionary *)queryParams decodePlusSymbols:(BOOL)decodePlusSymbols;
 
 + (NSArray <NSString *> *)expandOptionalRoutePatternsForPattern:(NSString *)routePattern;
 
+/**
+ Returns the one immutable instance of a string shared by every caller that interns an equal string, so that route definitions
+ registered with the same variable names, schemes or patterns point at the same strings instead of each keeping a copy.
+ 
+ Interned strings aren't retained by the intern table, so they go away once nothing else uses them. Thread safe.
+ 
+ @param string The string to intern.
+ 
+ @returns An immutable string equal to string.
+ */
++ (NSString *)internedString:(NSString *)string;
+
 @end
 
 
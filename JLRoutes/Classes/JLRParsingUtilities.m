@@ -10,14 +10,31 @@
  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <pthread.h>
 #import "JLRParsingUtilities.h"
+#import "JLRLogging.h"
 
 
-@interface NSArray (Combinations)
+static NSInteger JLRHexDigitValue(UniChar character)
+{
+    if (character >= '0' && character <= '9') {
+        return character - '0';
+    } else if (character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    } else if (character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    return -1;
+}
 
-- (NSArray<NSArray *> *)JLRoutes_allOrderedCombinations;
+static const NSUInteger JLRVariableValueStackBufferLength = 256;
 
-@end
+// each optional group doubles the routes a pattern expands to, so this many already make 65536 routes to register
+static const NSUInteger JLRMaximumOptionalComponentCount = 16;
+
+// guards internedStrings, which holds its strings weakly
+static pthread_mutex_t internedStringsLock = PTHREAD_MUTEX_INITIALIZER;
+static NSHashTable <NSString *> *internedStrings = nil;
 
 
 @implementation JLRParsingUtilities
@@ -30,6 +47,83 @@
     return [value stringByReplacingOccurrencesOfString:@"+" withString:@" " options:NSLiteralSearch range:NSMakeRange(0, value.length)];
 }
 
++ (NSString *)variableValueByDecodingPathComponent:(NSString *)pathComponent decodePlusSymbols:(BOOL)decodePlusSymbols
+{
+    CFStringRef string = (__bridge CFStringRef)pathComponent;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInlineBuffer inlineBuffer;
+    CFStringInitInlineBuffer(string, &inlineBuffer, CFRangeMake(0, length));
+    
+    BOOL needsDecoding = NO;
+    for (CFIndex index = 0; index < length && !needsDecoding; index++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index);
+        needsDecoding = (character == '%' || character > 0x7F || (decodePlusSymbols && character == '+'));
+    }
+    
+    if (!needsDecoding) {
+        // nothing decodes to a '#', so only a literal one can be trailing
+        if (length > 1 && CFStringGetCharacterFromInlineBuffer(&inlineBuffer, length - 1) == '#') {
+            return [pathComponent substringToIndex:(NSUInteger)length - 1];
+        }
+        return pathComponent;
+    }
+    
+    // decoding never makes the component longer, so its length bounds the decoded bytes
+    char stackBuffer[JLRVariableValueStackBufferLength];
+    char *bytes = (NSUInteger)length <= JLRVariableValueStackBufferLength ? stackBuffer : malloc((size_t)length);
+    NSUInteger byteCount = 0;
+    BOOL isValid = YES;
+    BOOL isASCII = YES;
+    
+    for (CFIndex index = 0; index < length; index++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index);
+        
+        if (character > 0x7F) {
+            isASCII = NO;
+            break;
+        }
+        
+        if (character == '%') {
+            NSInteger high = index + 2 < length ? JLRHexDigitValue(CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index + 1)) : -1;
+            NSInteger low = index + 2 < length ? JLRHexDigitValue(CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index + 2)) : -1;
+            
+            if (high < 0 || low < 0) {
+                isValid = NO;
+                break;
+            }
+            
+            character = (UniChar)(high * 16 + low);
+            index += 2;
+        }
+        
+        // the plus symbols are decoded after the percent escapes, so an escaped '+' becomes a space too
+        bytes[byteCount++] = (decodePlusSymbols && character == '+') ? ' ' : (char)character;
+    }
+    
+    NSString *value = nil;
+    
+    if (isValid && isASCII) {
+        if (byteCount > 1 && bytes[byteCount - 1] == '#') {
+            byteCount--;
+        }
+        // nil for escapes that aren't valid UTF-8, just like stringByRemovingPercentEncoding
+        value = [[NSString alloc] initWithBytes:bytes length:byteCount encoding:NSUTF8StringEncoding];
+    } else if (!isASCII) {
+        // components coming from NSURLComponents are percent encoded, so this is rare enough to do the long way
+        value = [pathComponent stringByRemovingPercentEncoding];
+        if (value.length > 1 && [value characterAtIndex:value.length - 1] == '#') {
+            value = [value substringToIndex:value.length - 1];
+        }
+        value = value != nil ? [self variableValueFrom:value decodePlusSymbols:decodePlusSymbols] : nil;
+    }
+    
+    if (bytes != stackBuffer) {
+        free(bytes);
+    }
+    
+    return value;
+}
+
 + (NSDictionary *)queryParams:(NSDictionary *)queryParams decodePlusSymbols:(BOOL)decodePlusSymbols
 {
     if (!decodePlusSymbols) {
@@ -69,10 +163,11 @@
      /path/:thing/a/b/c
      /path/:thing/a/b
      /path/:thing/a/c
-     /path/:thing/b/a
+     /path/:thing/b/c
      /path/:thing/a
      /path/:thing/b
      /path/:thing/c
+     /path/:thing/
      */
     
     if ([routePattern rangeOfString:@"("].location == NSNotFound) {
@@ -86,6 +181,26 @@
     return routes;
 }
 
++ (NSString *)internedString:(NSString *)string
+{
+    pthread_mutex_lock(&internedStringsLock);
+    
+    if (internedStrings == nil) {
+        internedStrings = [NSHashTable weakObjectsHashTable];
+    }
+    
+    NSString *internedString = [internedStrings member:string];
+    if (internedString == nil) {
+        // copying an immutable string just retains it, a mutable one mustn't change under everyone sharing it
+        internedString = [string copy];
+        [internedStrings addObject:internedString];
+    }
+    
+    pthread_mutex_unlock(&internedStringsLock);
+    
+    return internedString;
+}
+
 + (NSArray <NSString *> *)_optionalComponentsForPattern:(NSString *)routePattern baseRoute:(NSString *__autoreleasing *)outBaseRoute;
 {
     if (routePattern.length == 0) {
@@ -125,7 +240,7 @@
     }
     
     if (parseError) {
-        NSLog(@"[JLRoutes]: Parse error, unsupported route: %@", routePattern);
+        JLRLog(JLRLogLevelError, @"Parse error, unsupported route: %@", routePattern);
         return @[];
     }
     
@@ -134,50 +249,51 @@
 
 + (NSArray <NSString *> *)_routesForOptionalComponents:(NSArray <NSString *> *)optionalComponents baseRoute:(NSString *)baseRoute
 {
-    if (optionalComponents.count == 0 || baseRoute.length == 0) {
+    NSUInteger componentCount = optionalComponents.count;
+    
+    if (componentCount == 0 || baseRoute.length == 0) {
         return @[];
     }
     
-    NSMutableArray *routes = [NSMutableArray array];
-    
-    // generate all possible combinations of the components that could exist (taking order into account)
-    // aka, "/path/:thing/(/a)(/b)(/c)" should never generate a route for "/path/:thing/(/b)(/a)"
-    NSArray *combinations = [optionalComponents JLRoutes_allOrderedCombinations];
-    
-    // generate the actual final route path strings
-    for (NSArray *components in combinations) {
-        NSString *path = [components componentsJoinedByString:@""];
-        [routes addObject:[baseRoute stringByAppendingString:path]];
+    if (componentCount > JLRMaximumOptionalComponentCount) {
+        JLRLog(JLRLogLevelError, @"Too many optional components, unsupported route: %@%@", baseRoute, [optionalComponents componentsJoinedByString:@""]);
+        return @[];
     }
     
-    // sort them so that the longest routes are first (since they are the most selective)
-    [routes sortUsingSelector:@selector(length)];
-    
-    return [routes copy];
-}
-
-@end
-
-
-@implementation NSArray (JLRoutes)
-
-- (NSArray<NSArray *> *)JLRoutes_allOrderedCombinations
-{
-    NSInteger length = self.count;
-    if (length == 0) {
-        return [NSArray arrayWithObject:[NSArray array]];
+    NSUInteger maximumLength = baseRoute.length;
+    for (NSString *component in optionalComponents) {
+        maximumLength += component.length;
     }
     
-    id lastObject = [self lastObject];
-    NSArray *subarray = [self subarrayWithRange:NSMakeRange(0, length - 1)];
-    NSArray *subarrayCombinations = [subarray JLRoutes_allOrderedCombinations];
-    NSMutableArray *combinations = [NSMutableArray arrayWithArray:subarrayCombinations];
+    // every ordered combination of the components is a bitmask where the highest bit stands for the first component.
+    // aka, "/path/:thing/(/a)(/b)(/c)" should never generate a route for "/path/:thing/(/b)(/a)"
+    NSUInteger combinationCount = (NSUInteger)1 << componentCount;
+    NSMutableArray <NSString *> *routes = [NSMutableArray arrayWithCapacity:combinationCount];
     
-    for (NSArray *subarrayCombos in subarrayCombinations) {
-        [combinations addObject:[subarrayCombos arrayByAddingObject:lastObject]];
+    // counting down visits the combinations with the earliest components first
+    for (NSUInteger mask = combinationCount; mask > 0; mask--) {
+        NSUInteger combination = mask - 1;
+        NSMutableString *route = [NSMutableString stringWithCapacity:maximumLength];
+        [route appendString:baseRoute];
+        
+        for (NSUInteger index = 0; index < componentCount; index++) {
+            if (combination & ((NSUInteger)1 << (componentCount - 1 - index))) {
+                [route appendString:optionalComponents[index]];
+            }
+        }
+        
+        [routes addObject:[route copy]];
     }
     
-    return [NSArray arrayWithArray:combinations];
+    // longest routes first since they are the most selective, ties keep the earliest components first
+    [routes sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSString *route1, NSString *route2) {
+        if (route1.length == route2.length) {
+            return NSOrderedSame;
+        }
+        return route1.length > route2.length ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    
+    return [routes copy];
 }
 
 @end
@@ -0,0 +1,63 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+@class JLRRouteDefinition;
+
+
+/// The ways a route can conflict with a route that is tried before it.
+typedef NS_ENUM(NSUInteger, JLRRouteConflictType) {
+    /// Every URL the route matches is also matched by the preceding route, so it can only be reached if that route's handler declines.
+    JLRRouteConflictTypeShadowed,
+    /// Some URLs are matched by both routes, and those go to the preceding route first.
+    JLRRouteConflictTypeAmbiguous,
+};
+
+
+/**
+ JLRRouteConflict describes a pair of registered routes that can match the same URL, as found by -[JLRoutes routeConflicts].
+ */
+
+@interface JLRRouteConflict : NSObject
+
+/// How the routes conflict.
+@property (nonatomic, assign, readonly) JLRRouteConflictType type;
+
+/// The route that is tried later.
+@property (nonatomic, strong, readonly) JLRRouteDefinition *route;
+
+/// The route that is tried first, because it has a higher priority or was registered earlier.
+@property (nonatomic, strong, readonly) JLRRouteDefinition *precedingRoute;
+
+
+///-------------------------------
+/// @name Creating Conflicts
+///-------------------------------
+
+
+/// Creates a conflict between route and a route that's tried before it.
+- (instancetype)initWithType:(JLRRouteConflictType)type route:(JLRRouteDefinition *)route precedingRoute:(JLRRouteDefinition *)precedingRoute NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, please use initWithType:route:precedingRoute: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, please use initWithType:route:precedingRoute: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
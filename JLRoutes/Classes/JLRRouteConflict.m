@@ -0,0 +1,44 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRouteConflict.h"
+#import "JLRRouteDefinition.h"
+
+
+@interface JLRRouteConflict ()
+
+@property (nonatomic, assign) JLRRouteConflictType type;
+@property (nonatomic, strong) JLRRouteDefinition *route;
+@property (nonatomic, strong) JLRRouteDefinition *precedingRoute;
+
+@end
+
+
+@implementation JLRRouteConflict
+
+- (instancetype)initWithType:(JLRRouteConflictType)type route:(JLRRouteDefinition *)route precedingRoute:(JLRRouteDefinition *)precedingRoute
+{
+    if ((self = [super init])) {
+        self.type = type;
+        self.route = route;
+        self.precedingRoute = precedingRoute;
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    NSString *typeDescription = self.type == JLRRouteConflictTypeShadowed ? @"shadowed by" : @"ambiguous with";
+    return [NSString stringWithFormat:@"<%@ %p> - %@ %@ %@", NSStringFromClass([self class]), self, self.route.pattern, typeDescription, self.precedingRoute.pattern];
+}
+
+@end
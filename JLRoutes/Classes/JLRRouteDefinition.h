@@ -13,10 +13,35 @@
 #import <Foundation/Foundation.h>
 #import "JLRRouteRequest.h"
 #import "JLRRouteResponse.h"
+#import "JLRRouteVariableConstraint.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 
+/// The kind of a compiled route pattern path component.
+typedef NS_ENUM(NSUInteger, JLRRouteSegmentType) {
+    /// A literal component ('foo') that must be equal to the URL path component.
+    JLRRouteSegmentTypeLiteral,
+    /// A variable component (':foo', or ':foo<int>' with a constraint) that captures the URL path component.
+    JLRRouteSegmentTypeVariable,
+    /// A wildcard component ('*') that captures any number of URL path components, up to the components matched by the segments after it.
+    JLRRouteSegmentTypeWildcard,
+};
+
+
+/// A compiled route pattern path component.
+typedef struct {
+    /// The kind of component.
+    JLRRouteSegmentType type;
+    
+    /// The literal string for literal segments, the variable name for variable segments, or nil for wildcards. Owned by the route definition.
+    __unsafe_unretained NSString *_Nullable value;
+    
+    /// The constraint on the values a variable segment accepts, or nil if it accepts any value. Owned by the route definition.
+    __unsafe_unretained JLRRouteVariableConstraint *_Nullable constraint;
+} JLRRouteSegment;
+
+
 /**
  JLRRouteDefinition is a model object representing a registered route, including the URL scheme, route pattern, and priority.
  
@@ -35,8 +60,36 @@ NS_ASSUME_NONNULL_BEGIN
 /// The priority of this route pattern.
 @property (nonatomic, assign, readonly) NSUInteger priority;
 
+/// The route pattern split into its path components ('/foo/:bar' becomes @[@"foo", @":bar"]).
+@property (nonatomic, strong, readonly) NSArray <NSString *> *patternComponents;
+
+/// The pattern components compiled once at initialization, one segment per entry in patternComponents.
+@property (nonatomic, assign, readonly) const JLRRouteSegment *segments NS_RETURNS_INNER_POINTER;
+
+/// The number of entries in segments.
+@property (nonatomic, assign, readonly) NSUInteger segmentCount;
+
+/// YES if the pattern contains a '*' wildcard component. Segments after the first wildcard are matched against the end of the URL path.
+@property (nonatomic, assign, readonly) BOOL containsWildcard;
+
+/// The fewest URL path components this route can match. A wildcard can capture nothing, so it doesn't count towards this.
+@property (nonatomic, assign, readonly) NSUInteger minimumPathComponentCount;
+
+/// The most URL path components this route can match, or NSUIntegerMax if the pattern contains a wildcard.
+@property (nonatomic, assign, readonly) NSUInteger maximumPathComponentCount;
+
 /// The handler block to invoke when a match is found.
-@property (nonatomic, copy, readonly) BOOL (^handlerBlock)(NSDictionary *parameters);
+@property (nonatomic, copy, readonly, nullable) BOOL (^handlerBlock)(NSDictionary *parameters);
+
+/// The handler block to invoke when a match is found, for routes that report whether they handled the URL later. Nil unless created with initWithScheme:pattern:priority:asyncHandlerBlock:.
+@property (nonatomic, copy, readonly, nullable) void (^asyncHandlerBlock)(NSDictionary *parameters, void (^completion)(BOOL didRoute));
+
+/// The number of times JLRoutes tried this route against a URL it was routing, or found it among the matches its result cache remembered for one.
+/// Only counted while +[JLRoutes isInstrumentationEnabled] is YES.
+@property (nonatomic, assign, readonly) NSUInteger attemptCount;
+
+/// The number of times this route matched a URL JLRoutes was routing. Only counted while +[JLRoutes isInstrumentationEnabled] is YES.
+@property (nonatomic, assign, readonly) NSUInteger matchCount;
 
 
 ///---------------------------------
@@ -56,7 +109,20 @@ NS_ASSUME_NONNULL_BEGIN
  
  @returns The newly initialized route definition.
  */
-- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^)(NSDictionary *parameters))handlerBlock NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^__nullable)(NSDictionary *parameters))handlerBlock NS_DESIGNATED_INITIALIZER;
+
+/**
+ Creates a new route definition whose handler reports whether it handled the URL by calling a completion block, possibly later and on
+ any thread. Routing asynchronously waits for it before trying the next matching route, routing synchronously considers the URL handled.
+ 
+ @param scheme The URL scheme this route applies for, or JLRoutesGlobalRoutesScheme if global.
+ @param pattern The full route pattern ('/foo/:bar')
+ @param priority The route priority, or 0 if default.
+ @param asyncHandlerBlock The handler block to call when a successful match is found. It must call completion exactly once.
+ 
+ @returns The newly initialized route definition.
+ */
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority asyncHandlerBlock:(void (^)(NSDictionary *parameters, void (^completion)(BOOL didRoute)))asyncHandlerBlock;
 
 /// Unavailable, use initWithScheme:pattern:priority:handlerBlock: instead.
 - (instancetype)init NS_UNAVAILABLE;
@@ -81,6 +147,70 @@ NS_ASSUME_NONNULL_BEGIN
 - (JLRRouteResponse *)routeResponseForRequest:(JLRRouteRequest *)request decodePlusSymbols:(BOOL)decodePlusSymbols;
 
 
+/**
+ Returns YES if routeResponseForRequest:decodePlusSymbols: would return a match for the provided JLRRouteRequest.
+ 
+ Unlike building the response, this doesn't collect any parameters or parse the request's query. Subclasses that
+ override routeResponseForRequest:decodePlusSymbols: are asked for their full response instead.
+ 
+ @param request The JLRRouteRequest to attempt to match.
+ @param decodePlusSymbols The global plus symbol decoding option value.
+ 
+ @returns YES if the request matches this route definition, NO if not.
+ */
+- (BOOL)matchesRequest:(JLRRouteRequest *)request decodePlusSymbols:(BOOL)decodePlusSymbols;
+
+
+/**
+ Returns the ranges of the request's path components captured by this route's variables, without decoding or copying any of them.
+ 
+ A variable's range is a single path component, the wildcard's range covers every path component it captured. Only meaningful for a
+ request that matchesRequest:decodePlusSymbols: accepts, and empty for subclasses that don't support segment indexing.
+ 
+ @param request The matching JLRRouteRequest.
+ 
+ @returns NSRange values keyed by variable name, and by JLRouteWildcardComponentsKey for the wildcard.
+ */
+- (NSDictionary <NSString *, NSValue *> *)capturedPathComponentRangesForRequest:(JLRRouteRequest *)request;
+
+
+/**
+ Returns YES if some URL could be matched by both this route and another one, judging by their compiled segments alone.
+ 
+ Two routes can't match the same URL if no number of path components fits both, or if they have different literals at a path
+ component they both compare. This is conservative: it returns YES for routes of classes that don't support segment indexing.
+ 
+ @param routeDefinition The route to compare this one with.
+ 
+ @returns YES if both routes could match the same URL, NO if no URL can match both.
+ */
+- (BOOL)canMatchSameURLAsRouteDefinition:(JLRRouteDefinition *)routeDefinition;
+
+
+/**
+ Returns YES if this route matches every URL that another route matches, judging by their compiled segments alone.
+ 
+ That's the case when every number of path components the other route can match fits this route too, and every literal this route
+ compares is the same literal in the other route. Returns NO for routes of classes that don't support segment indexing.
+ 
+ @param routeDefinition The route to compare this one with.
+ 
+ @returns YES if this route matches every URL routeDefinition matches, NO if not or if it can't be told.
+ */
+- (BOOL)matchesEveryURLMatchedByRouteDefinition:(JLRRouteDefinition *)routeDefinition;
+
+
+/**
+ Returns YES if instances of this class match requests using nothing but their compiled segments, which lets JLRoutes index them by pattern.
+ 
+ This returns NO for subclasses that override -routeResponseForRequest:decodePlusSymbols:, so that they are tried against every URL.
+ Subclasses whose override only ever narrows the default matching may override this to return YES.
+ 
+ @returns YES if routes of this class can be indexed by their segments, NO if not.
+ */
++ (BOOL)supportsSegmentIndexing;
+
+
 /**
  Invoke handlerBlock with the given parameters. This may be overriden by subclasses.
  
@@ -90,6 +220,17 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)callHandlerBlockWithParameters:(NSDictionary *)parameters;
 
+
+/**
+ Invoke the handler with the given parameters, reporting whether it handled the URL to completion. This may be overriden by subclasses.
+ 
+ Calls asyncHandlerBlock if there is one, otherwise calls completion with the result of -callHandlerBlockWithParameters:.
+ 
+ @param parameters The parameters to pass to the handler.
+ @param completion Called exactly once with YES if the URL is considered handled and NO if not, possibly later and on any thread.
+ */
+- (void)callHandlerBlockWithParameters:(NSDictionary *)parameters completion:(void (^)(BOOL didRoute))completion;
+
 @end
 
 
@@ -10,19 +10,71 @@
  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <stdatomic.h>
 #import "JLRRouteDefinition.h"
 #import "JLRoutes.h"
 #import "JLRParsingUtilities.h"
+#import "JLRParameterDictionary.h"
+#import "JLRArraySlice.h"
+#import "JLRLogging.h"
 
 
-@interface JLRRouteDefinition ()
+// the number of segments whose constrained values a match carries over to the parameters, later ones are decoded again
+#define JLRCarriedConstrainedValueCapacity 16
+
+// the URL path component a segment is compared with. segments after the wildcard line up with the end of the path, which
+// underflows to an out of range index for a path too short to match.
+static inline NSUInteger JLRPathComponentIndexForSegment(NSUInteger segmentIndex, NSUInteger wildcardIndex, NSUInteger segmentCount, NSUInteger pathComponentCount)
+{
+    if (wildcardIndex == NSNotFound || segmentIndex <= wildcardIndex) {
+        return segmentIndex;
+    }
+    return pathComponentCount - segmentCount + segmentIndex;
+}
+
+
+@interface JLRRouteDefinition () {
+    JLRRouteSegment *_compiledSegments;
+    
+    // routes are tried from any thread routing a URL, see JLRRouteDefinition (JLRoutesInstrumentation)
+    _Atomic(NSUInteger) _attemptCount;
+    _Atomic(NSUInteger) _matchCount;
+    _Atomic(NSUInteger) _hitCount;
+}
 
 @property (nonatomic, copy) NSString *pattern;
 @property (nonatomic, copy) NSString *scheme;
 @property (nonatomic, assign) NSUInteger priority;
 @property (nonatomic, copy) BOOL (^handlerBlock)(NSDictionary *parameters);
+@property (nonatomic, copy) void (^asyncHandlerBlock)(NSDictionary *parameters, void (^completion)(BOOL didRoute));
+
+// set by JLRoutes for routes expanded from a pattern with optional groups, see JLRRouteDefinition (JLRoutesRegistration)
+@property (nonatomic, copy) NSString *registeredPattern;
+
+@property (nonatomic, strong) NSArray <NSString *> *patternComponents;
+@property (nonatomic, strong) NSArray <NSString *> *variableNames;
+@property (nonatomic, assign) NSUInteger segmentCount;
+@property (nonatomic, assign) BOOL containsWildcard;
+@property (nonatomic, assign) NSUInteger minimumPathComponentCount;
+@property (nonatomic, assign) NSUInteger maximumPathComponentCount;
+
+// the index of the first wildcard, or NSNotFound. the segments before it line up with the start of the URL path.
+@property (nonatomic, assign) NSUInteger wildcardIndex;
 
-@property (nonatomic, strong) NSArray *patternComponents;
+// keeps the segments' constraints alive. a route with a constraint that failed to compile matches nothing.
+@property (nonatomic, strong) NSArray <JLRRouteVariableConstraint *> *variableConstraints;
+@property (nonatomic, assign) BOOL hasInvalidConstraint;
+
+// the match parameters that are the same for every URL this route matches
+@property (nonatomic, strong) NSDictionary *constantMatchParameters;
+
+// the keys of routeParams, known once the pattern is compiled. dictionaries made with it hash their keys with the key set's
+// precomputed perfect hash and share the keys rather than each holding onto them.
+@property (nonatomic, strong) id routeParamsKeySet;
+
+// creates a route from segments compiled earlier, for JLRRouteTable. the segments are copied, their strings and constraints
+// are retained by patternComponents, variableNames and variableConstraints.
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^)(NSDictionary *parameters))handlerBlock patternComponents:(NSArray <NSString *> *)patternComponents segments:(const JLRRouteSegment *)segments wildcardIndex:(NSUInteger)wildcardIndex minimumPathComponentCount:(NSUInteger)minimumPathComponentCount maximumPathComponentCount:(NSUInteger)maximumPathComponentCount hasInvalidConstraint:(BOOL)hasInvalidConstraint NS_DESIGNATED_INITIALIZER;
 
 @end
 
@@ -32,85 +84,277 @@
 - (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^)(NSDictionary *parameters))handlerBlock
 {
     if ((self = [super init])) {
-        self.scheme = scheme;
-        self.pattern = pattern;
+        // interned so that routes share them, and so that looking them up usually finds the identical string
+        self.scheme = [JLRParsingUtilities internedString:scheme];
+        self.pattern = [JLRParsingUtilities internedString:pattern];
         self.priority = priority;
         self.handlerBlock = handlerBlock;
+        self.constantMatchParameters = @{JLRoutePatternKey: self.pattern, JLRouteSchemeKey: self.scheme ?: [NSNull null]};
         
         if ([pattern characterAtIndex:0] == '/') {
             pattern = [pattern substringFromIndex:1];
         }
         
         self.patternComponents = [pattern componentsSeparatedByString:@"/"];
+        [self _compilePatternComponents];
+    }
+    return self;
+}
+
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^)(NSDictionary *parameters))handlerBlock patternComponents:(NSArray <NSString *> *)patternComponents segments:(const JLRRouteSegment *)segments wildcardIndex:(NSUInteger)wildcardIndex minimumPathComponentCount:(NSUInteger)minimumPathComponentCount maximumPathComponentCount:(NSUInteger)maximumPathComponentCount hasInvalidConstraint:(BOOL)hasInvalidConstraint
+{
+    if ((self = [super init])) {
+        // the table already shares its strings between its routes, so they aren't interned again
+        self.scheme = scheme;
+        self.pattern = pattern;
+        self.priority = priority;
+        self.handlerBlock = handlerBlock;
+        self.constantMatchParameters = @{JLRoutePatternKey: self.pattern, JLRouteSchemeKey: self.scheme ?: [NSNull null]};
+        self.patternComponents = patternComponents;
+        
+        NSUInteger segmentCount = patternComponents.count;
+        NSMutableArray <NSString *> *variableNames = [NSMutableArray array];
+        NSMutableArray <JLRRouteVariableConstraint *> *variableConstraints = [NSMutableArray array];
+        
+        _compiledSegments = calloc(segmentCount, sizeof(JLRRouteSegment));
+        _segmentCount = segmentCount;
+        _containsWildcard = (wildcardIndex != NSNotFound);
+        _wildcardIndex = wildcardIndex;
+        _minimumPathComponentCount = minimumPathComponentCount;
+        _maximumPathComponentCount = maximumPathComponentCount;
+        _hasInvalidConstraint = hasInvalidConstraint;
+        
+        for (NSUInteger index = 0; index < segmentCount; index++) {
+            JLRRouteSegment segment = segments[index];
+            _compiledSegments[index] = segment;
+            
+            if (segment.type == JLRRouteSegmentTypeVariable) {
+                [variableNames addObject:segment.value];
+            }
+            if (segment.constraint != nil) {
+                [variableConstraints addObject:segment.constraint];
+            }
+        }
+        
+        self.variableNames = variableNames;
+        self.variableConstraints = variableConstraints;
+        self.routeParamsKeySet = [NSDictionary sharedKeySetForKeys:_containsWildcard ? [variableNames arrayByAddingObject:JLRouteWildcardComponentsKey] : variableNames];
     }
     return self;
 }
 
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority asyncHandlerBlock:(void (^)(NSDictionary *parameters, void (^completion)(BOOL didRoute)))asyncHandlerBlock
+{
+    if ((self = [self initWithScheme:scheme pattern:pattern priority:priority handlerBlock:nil])) {
+        self.asyncHandlerBlock = asyncHandlerBlock;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_compiledSegments);
+}
+
 - (NSString *)description
 {
     return [NSString stringWithFormat:@"<%@ %p> - %@ (priority: %@)", NSStringFromClass([self class]), self, self.pattern, @(self.priority)];
 }
 
+- (NSUInteger)attemptCount
+{
+    return atomic_load_explicit(&_attemptCount, memory_order_relaxed);
+}
+
+- (NSUInteger)matchCount
+{
+    return atomic_load_explicit(&_matchCount, memory_order_relaxed);
+}
+
+- (void)recordAttemptDidMatch:(BOOL)didMatch
+{
+    atomic_fetch_add_explicit(&_attemptCount, 1, memory_order_relaxed);
+    if (didMatch) {
+        atomic_fetch_add_explicit(&_matchCount, 1, memory_order_relaxed);
+    }
+}
+
+- (NSUInteger)hitCount
+{
+    return atomic_load_explicit(&_hitCount, memory_order_relaxed);
+}
+
+- (void)recordHit
+{
+    atomic_fetch_add_explicit(&_hitCount, 1, memory_order_relaxed);
+}
+
+- (void)halveHitCount
+{
+    // a hit recorded in between may be lost, which doesn't matter for ordering by how often routes are hit
+    atomic_store_explicit(&_hitCount, atomic_load_explicit(&_hitCount, memory_order_relaxed) / 2, memory_order_relaxed);
+}
+
+- (const JLRRouteSegment *)segments
+{
+    return _compiledSegments;
+}
+
 - (JLRRouteResponse *)routeResponseForRequest:(JLRRouteRequest *)request decodePlusSymbols:(BOOL)decodePlusSymbols
 {
-    BOOL patternContainsWildcard = [self.patternComponents containsObject:@"*"];
+    NSArray <NSString *> *pathComponents = request.pathComponents;
+    
+    // the constrained values are decoded and checked (and integers parsed) while matching, and passed on as they are
+    __strong id constrainedValues[JLRCarriedConstrainedValueCapacity];
     
-    if (request.pathComponents.count != self.patternComponents.count && !patternContainsWildcard) {
+    if (![self _matchesPathComponents:pathComponents decodePlusSymbols:decodePlusSymbols constrainedValues:constrainedValues]) {
         // definitely not a match, nothing left to do
         return [JLRRouteResponse invalidMatchResponse];
     }
     
-    JLRRouteResponse *response = [JLRRouteResponse invalidMatchResponse];
-    NSMutableDictionary *routeParams = [NSMutableDictionary dictionary];
-    BOOL isMatch = YES;
-    NSUInteger index = 0;
+    // it's a match, so now it's worth collecting the variables. the base params win over the route params,
+    // which win over the query params, without any of them being copied into a merged dictionary.
+    NSMutableDictionary *routeParams = [NSMutableDictionary dictionaryWithSharedKeySet:self.routeParamsKeySet];
+    [self _addRouteParamsForPathComponents:pathComponents constrainedValues:constrainedValues toParams:routeParams decodePlusSymbols:decodePlusSymbols];
     
-    for (NSString *patternComponent in self.patternComponents) {
-        NSString *URLComponent = nil;
-        
-        // figure out which URLComponent it is, taking wildcards into account
-        if (index < [request.pathComponents count]) {
-            URLComponent = request.pathComponents[index];
-        } else if ([patternComponent isEqualToString:@"*"]) {
-            // match /foo by /foo/*
-            URLComponent = [request.pathComponents lastObject];
-        }
-        
-        if ([patternComponent hasPrefix:@":"]) {
-            // this is a variable, set it in the params
-            NSString *variableName = [self variableNameForValue:patternComponent];
-            NSString *variableValue = [self variableValueForValue:URLComponent decodePlusSymbols:decodePlusSymbols];
-            routeParams[variableName] = variableValue;
-        } else if ([patternComponent isEqualToString:@"*"]) {
-            // match wildcards
-            NSUInteger minRequiredParams = index;
-            if (request.pathComponents.count >= minRequiredParams) {
-                // match: /a/b/c/* has to be matched by at least /a/b/c
-                routeParams[JLRouteWildcardComponentsKey] = [request.pathComponents subarrayWithRange:NSMakeRange(index, request.pathComponents.count - index)];
-                isMatch = YES;
-            } else {
-                // not a match: /a/b/c/* cannot be matched by URL /a/b/
-                isMatch = NO;
-            }
-            break;
-        } else if (![patternComponent isEqualToString:URLComponent]) {
-            // break if this is a static component and it isn't a match
-            isMatch = NO;
-            break;
+    // only the URL differs between matches, the pattern and scheme entries are built once
+    NSDictionary *URLParams = @{JLRouteURLKey: request.URL ?: [NSNull null]};
+    NSArray <NSDictionary *> *layers = @[URLParams, self.constantMatchParameters, routeParams, [request queryParamsDecodingPlusSymbols:decodePlusSymbols]];
+    return [JLRRouteResponse validMatchResponseWithParameters:[JLRParameterDictionary dictionaryByLayeringDictionaries:layers]];
+}
+
+- (BOOL)matchesRequest:(JLRRouteRequest *)request decodePlusSymbols:(BOOL)decodePlusSymbols
+{
+    SEL matchSelector = @selector(routeResponseForRequest:decodePlusSymbols:);
+    
+    if ([[self class] instanceMethodForSelector:matchSelector] != [JLRRouteDefinition instanceMethodForSelector:matchSelector]) {
+        // custom matching logic, only the response can tell
+        return [self routeResponseForRequest:request decodePlusSymbols:decodePlusSymbols].isMatch;
+    }
+    
+    return [self _matchesPathComponents:request.pathComponents decodePlusSymbols:decodePlusSymbols constrainedValues:NULL];
+}
+
+- (NSDictionary <NSString *, NSValue *> *)capturedPathComponentRangesForRequest:(JLRRouteRequest *)request
+{
+    if (![[self class] supportsSegmentIndexing]) {
+        // the segments don't say what custom matching logic captures
+        return @{};
+    }
+    
+    NSUInteger pathComponentCount = request.pathComponents.count;
+    NSMutableDictionary <NSString *, NSValue *> *ranges = [NSMutableDictionary dictionaryWithCapacity:self.variableNames.count + (self.containsWildcard ? 1 : 0)];
+    
+    for (NSUInteger index = 0; index < _segmentCount; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        
+        if (segment.type == JLRRouteSegmentTypeWildcard && index == _wildcardIndex) {
+            // a wildcard can capture nothing at all, just like the parameters get an empty array then
+            NSUInteger capturedCount = pathComponentCount > _minimumPathComponentCount ? pathComponentCount - _minimumPathComponentCount : 0;
+            ranges[JLRouteWildcardComponentsKey] = [NSValue valueWithRange:NSMakeRange(index, capturedCount)];
+            continue;
         }
-        index++;
+        
+        NSUInteger pathComponentIndex = JLRPathComponentIndexForSegment(index, _wildcardIndex, _segmentCount, pathComponentCount);
+        if (segment.type == JLRRouteSegmentTypeVariable && pathComponentIndex < pathComponentCount) {
+            ranges[segment.value] = [NSValue valueWithRange:NSMakeRange(pathComponentIndex, 1)];
+        }
+    }
+    
+    return ranges;
+}
+
+- (BOOL)canMatchSameURLAsRouteDefinition:(JLRRouteDefinition *)routeDefinition
+{
+    if (![[self class] supportsSegmentIndexing] || ![[routeDefinition class] supportsSegmentIndexing]) {
+        return YES;
     }
     
-    if (isMatch) {
-        // if it's a match, set up the param dictionary and create a valid match response
-        NSMutableDictionary *params = [NSMutableDictionary dictionary];
-        [params addEntriesFromDictionary:[JLRParsingUtilities queryParams:request.queryParams decodePlusSymbols:decodePlusSymbols]];
-        [params addEntriesFromDictionary:routeParams];
-        [params addEntriesFromDictionary:[self baseMatchParametersForRequest:request]];
-        response = [JLRRouteResponse validMatchResponseWithParameters:[params copy]];
+    if (self.minimumPathComponentCount > routeDefinition.maximumPathComponentCount || routeDefinition.minimumPathComponentCount > self.maximumPathComponentCount) {
+        return NO;
     }
     
-    return response;
+    // only the segments before both routes' wildcards are compared with the same path components whatever the path's length
+    NSUInteger comparedCount = MIN(MIN(_wildcardIndex, _segmentCount), MIN(routeDefinition.wildcardIndex, routeDefinition.segmentCount));
+    
+    for (NSUInteger index = 0; index < comparedCount; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        JLRRouteSegment otherSegment = routeDefinition.segments[index];
+        
+        if (segment.type == JLRRouteSegmentTypeLiteral && otherSegment.type == JLRRouteSegmentTypeLiteral && ![segment.value isEqualToString:otherSegment.value]) {
+            return NO;
+        }
+        
+        // a constrained variable can't take a literal it rejects
+        if (segment.constraint != nil && otherSegment.type == JLRRouteSegmentTypeLiteral && ![segment.constraint acceptsValue:(NSString *)otherSegment.value]) {
+            return NO;
+        }
+        if (otherSegment.constraint != nil && segment.type == JLRRouteSegmentTypeLiteral && ![otherSegment.constraint acceptsValue:(NSString *)segment.value]) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+- (BOOL)matchesEveryURLMatchedByRouteDefinition:(JLRRouteDefinition *)routeDefinition
+{
+    if (![[self class] supportsSegmentIndexing] || ![[routeDefinition class] supportsSegmentIndexing]) {
+        return NO;
+    }
+    
+    if (self.minimumPathComponentCount > routeDefinition.minimumPathComponentCount || routeDefinition.maximumPathComponentCount > self.maximumPathComponentCount) {
+        return NO;
+    }
+    
+    if (_wildcardIndex != NSNotFound && _wildcardIndex + 1 < _segmentCount) {
+        // segments after the wildcard line up with the end of the path, which this doesn't compare
+        return NO;
+    }
+    
+    if (self.hasInvalidConstraint) {
+        return NO;
+    }
+    
+    // the other route has a segment at every component this one compares, and they all need to be at least as specific. plain
+    // variables and wildcards match any component, so only this route's literals and constraints matter, and only the other
+    // route's segments before its wildcard are sure to be compared with the same path components.
+    NSUInteger otherLeadingSegmentCount = MIN(routeDefinition.wildcardIndex, routeDefinition.segmentCount);
+    
+    for (NSUInteger index = 0; index < self.minimumPathComponentCount; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        
+        if (segment.type != JLRRouteSegmentTypeLiteral && segment.constraint == nil) {
+            continue;
+        }
+        
+        if (index >= otherLeadingSegmentCount) {
+            return NO;
+        }
+        
+        JLRRouteSegment otherSegment = routeDefinition.segments[index];
+        BOOL isAsSpecific = NO;
+        
+        if (segment.type == JLRRouteSegmentTypeLiteral) {
+            isAsSpecific = (otherSegment.type == JLRRouteSegmentTypeLiteral && [segment.value isEqualToString:otherSegment.value]);
+        } else if (otherSegment.type == JLRRouteSegmentTypeLiteral) {
+            isAsSpecific = [segment.constraint acceptsValue:(NSString *)otherSegment.value];
+        } else {
+            isAsSpecific = (otherSegment.constraint != nil && [segment.constraint isEqualToConstraint:otherSegment.constraint]);
+        }
+        
+        if (!isAsSpecific) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
++ (BOOL)supportsSegmentIndexing
+{
+    SEL matchSelector = @selector(routeResponseForRequest:decodePlusSymbols:);
+    return [self instanceMethodForSelector:matchSelector] == [JLRRouteDefinition instanceMethodForSelector:matchSelector];
 }
 
 - (NSString *)variableNameForValue:(NSString *)value
@@ -132,30 +376,183 @@
 
 - (NSString *)variableValueForValue:(NSString *)value decodePlusSymbols:(BOOL)decodePlusSymbols
 {
-    NSString *var = [value stringByRemovingPercentEncoding];
+    // strips a trailing fragment too
+    return [JLRParsingUtilities variableValueByDecodingPathComponent:value decodePlusSymbols:decodePlusSymbols];
+}
+
+- (BOOL)callHandlerBlockWithParameters:(NSDictionary *)parameters
+{
+    if (self.asyncHandlerBlock != nil) {
+        // there's no waiting for the answer here, so the URL counts as handled
+        self.asyncHandlerBlock(parameters, ^(BOOL didRoute) {});
+        return YES;
+    }
     
-    if (var.length > 1 && [var characterAtIndex:var.length - 1] == '#') {
-        // Strip of trailing fragment
-        var = [var substringToIndex:var.length - 1];
+    if (self.handlerBlock == nil) {
+        return YES;
+    }
+    
+    return self.handlerBlock(parameters);
+}
+
+- (void)callHandlerBlockWithParameters:(NSDictionary *)parameters completion:(void (^)(BOOL didRoute))completion
+{
+    if (self.asyncHandlerBlock != nil) {
+        self.asyncHandlerBlock(parameters, completion);
+        return;
+    }
+    
+    completion([self callHandlerBlockWithParameters:parameters]);
+}
+
+
+#pragma mark - Private
+
+- (BOOL)_matchesPathComponents:(NSArray <NSString *> *)pathComponents decodePlusSymbols:(BOOL)decodePlusSymbols constrainedValues:(__strong id *)constrainedValues
+{
+    // constrainedValues, if given, has room for JLRCarriedConstrainedValueCapacity parameters by segment index. on a match
+    // it holds the parameter for each constrained segment that fits, and nil for every other segment.
+    // structural check only, this must not allocate since most routes tried for a URL won't match it. the exceptions are
+    // regular expression constraints, and constrained values that need decoding before they can be checked.
+    NSUInteger pathComponentCount = pathComponents.count;
+    
+    if (pathComponentCount < _minimumPathComponentCount || pathComponentCount > _maximumPathComponentCount || _hasInvalidConstraint) {
+        return NO;
+    }
+    
+    // the component count check above already guarantees /a/b/c/* is matched by /a/b/c but not by /a/b, and that the
+    // segments after a wildcard line up with components the segments before it didn't take
+    for (NSUInteger index = 0; index < _segmentCount; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        
+        if (segment.type == JLRRouteSegmentTypeLiteral && ![segment.value isEqualToString:pathComponents[JLRPathComponentIndexForSegment(index, _wildcardIndex, _segmentCount, pathComponentCount)]]) {
+            return NO;
+        }
     }
     
-    var = [JLRParsingUtilities variableValueFrom:var decodePlusSymbols:decodePlusSymbols];
+    // literals are cheaper to compare, so constraints are only checked when they all matched
+    for (NSUInteger index = 0; index < _segmentCount && _variableConstraints.count > 0; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        
+        if (segment.constraint != nil) {
+            NSString *pathComponent = pathComponents[JLRPathComponentIndexForSegment(index, _wildcardIndex, _segmentCount, pathComponentCount)];
+            NSString *variableValue = [self variableValueForValue:pathComponent decodePlusSymbols:decodePlusSymbols];
+            
+            if (variableValue == nil) {
+                return NO;
+            }
+            
+            if (constrainedValues != NULL && index < JLRCarriedConstrainedValueCapacity) {
+                constrainedValues[index] = [segment.constraint parameterValueForAcceptedValue:variableValue];
+                if (constrainedValues[index] == nil) {
+                    return NO;
+                }
+            } else if (![segment.constraint acceptsValue:variableValue]) {
+                return NO;
+            }
+        }
+    }
     
-    return var;
+    return YES;
 }
 
-- (NSDictionary *)baseMatchParametersForRequest:(JLRRouteRequest *)request
+- (void)_addRouteParamsForPathComponents:(NSArray <NSString *> *)pathComponents constrainedValues:(__strong id *)constrainedValues toParams:(NSMutableDictionary *)params decodePlusSymbols:(BOOL)decodePlusSymbols
 {
-    return @{JLRoutePatternKey: self.pattern ?: [NSNull null], JLRouteURLKey: request.URL ?: [NSNull null], JLRouteSchemeKey: self.scheme ?: [NSNull null]};
+    // only called once _matchesPathComponents: has confirmed the match, so the variables line up with the path
+    NSUInteger pathComponentCount = pathComponents.count;
+    
+    for (NSUInteger index = 0; index < _segmentCount; index++) {
+        JLRRouteSegment segment = _compiledSegments[index];
+        
+        if (segment.type == JLRRouteSegmentTypeWildcard && index == _wildcardIndex) {
+            // a view of the path components rather than a copy of them, most handlers never look
+            NSRange capturedRange = NSMakeRange(index, pathComponentCount - _minimumPathComponentCount);
+            params[JLRouteWildcardComponentsKey] = [[JLRArraySlice alloc] initWithArray:pathComponents range:capturedRange];
+            continue;
+        }
+        
+        if (segment.constraint != nil && index < JLRCarriedConstrainedValueCapacity) {
+            params[segment.value] = constrainedValues[index];
+            continue;
+        }
+        
+        if (segment.type == JLRRouteSegmentTypeVariable) {
+            NSUInteger pathComponentIndex = JLRPathComponentIndexForSegment(index, _wildcardIndex, _segmentCount, pathComponentCount);
+            NSString *variableValue = [self variableValueForValue:pathComponents[pathComponentIndex] decodePlusSymbols:decodePlusSymbols];
+            if (variableValue != nil) {
+                // constrained values past JLRCarriedConstrainedValueCapacity were already checked, integers are passed parsed
+                params[segment.value] = segment.constraint != nil ? [segment.constraint parameterValueForValue:variableValue] : variableValue;
+            }
+        }
+    }
 }
 
-- (BOOL)callHandlerBlockWithParameters:(NSDictionary *)parameters
+- (void)_compilePatternComponents
 {
-    if (self.handlerBlock == nil) {
-        return YES;
+    NSUInteger componentCount = self.patternComponents.count;
+    NSMutableArray <NSString *> *variableNames = [NSMutableArray array];
+    NSMutableArray <JLRRouteVariableConstraint *> *variableConstraints = [NSMutableArray array];
+    
+    _compiledSegments = calloc(componentCount, sizeof(JLRRouteSegment));
+    _segmentCount = componentCount;
+    _containsWildcard = NO;
+    _wildcardIndex = NSNotFound;
+    _minimumPathComponentCount = componentCount;
+    _maximumPathComponentCount = componentCount;
+    
+    NSUInteger index = 0;
+    for (NSString *component in self.patternComponents) {
+        JLRRouteSegment *segment = &_compiledSegments[index];
+        
+        if ([component isEqualToString:@"*"]) {
+            segment->type = JLRRouteSegmentTypeWildcard;
+            segment->value = nil;
+            
+            if (!_containsWildcard) {
+                // the first wildcard can capture nothing at all, any later one matches a single component
+                _containsWildcard = YES;
+                _wildcardIndex = index;
+                _minimumPathComponentCount = componentCount - 1;
+                _maximumPathComponentCount = NSUIntegerMax;
+            }
+        } else if ([component hasPrefix:@":"]) {
+            NSString *variableComponent = component;
+            NSRange constraintStart = [component rangeOfString:@"<"];
+            
+            if (constraintStart.location != NSNotFound && [component hasSuffix:@">"]) {
+                // ':name<constraint>', variableConstraints keeps the constraint alive for as long as the segment points at it
+                NSString *constraintPattern = [component substringWithRange:NSMakeRange(NSMaxRange(constraintStart), component.length - NSMaxRange(constraintStart) - 1)];
+                NSError *constraintError = nil;
+                JLRRouteVariableConstraint *constraint = [[JLRRouteVariableConstraint alloc] initWithPattern:constraintPattern error:&constraintError];
+                
+                if (constraint != nil) {
+                    [variableConstraints addObject:constraint];
+                    segment->constraint = constraint;
+                } else {
+                    JLRLog(JLRLogLevelError, @"Invalid variable constraint, route will never match: %@ (%@)", self.pattern, constraintError.localizedDescription);
+                    _hasInvalidConstraint = YES;
+                }
+                
+                variableComponent = [component substringToIndex:constraintStart.location];
+            }
+            
+            // variableNames keeps the name alive for as long as the segment points at it
+            NSString *variableName = [JLRParsingUtilities internedString:[self variableNameForValue:variableComponent]];
+            [variableNames addObject:variableName];
+            segment->type = JLRRouteSegmentTypeVariable;
+            segment->value = variableName;
+        } else {
+            // the literal is kept alive by patternComponents
+            segment->type = JLRRouteSegmentTypeLiteral;
+            segment->value = component;
+        }
+        
+        index++;
     }
     
-    return self.handlerBlock(parameters);
+    self.variableNames = variableNames;
+    self.variableConstraints = variableConstraints;
+    self.routeParamsKeySet = [NSDictionary sharedKeySetForKeys:_containsWildcard ? [variableNames arrayByAddingObject:JLRouteWildcardComponentsKey] : variableNames];
 }
 
 @end
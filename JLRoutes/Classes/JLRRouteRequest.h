@@ -28,7 +28,7 @@ NS_ASSUME_NONNULL_BEGIN
 /// The URL's path components.
 @property (nonatomic, strong, readonly) NSArray *pathComponents;
 
-/// The URL's query parameters.
+/// The URL's query parameters. These are parsed the first time they are asked for.
 @property (nonatomic, strong, readonly) NSDictionary *queryParams;
 
 
@@ -47,12 +47,83 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent NS_DESIGNATED_INITIALIZER;
 
+/**
+ Creates a new route request, unless the hash of its first path component fails a test.
+ 
+ The URL is only tokenized once: the hash is taken from the path being split up, and nothing is allocated for a URL that
+ fails the test. URLs that only NSURLComponents can parse aren't tested, and always get a request.
+ 
+ @param URL The URL to route.
+ @param alwaysTreatsHostAsPathComponent The global option for if to treat the URL host as a path component or not.
+ @param test Returns whether a request is wanted for a URL whose first path component has the given hashForPathComponent: hash.
+ 
+ @returns The newly initialized route request, or nil if test returned NO.
+ */
++ (nullable instancetype)requestWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:(BOOL (NS_NOESCAPE ^)(NSUInteger firstPathComponentHash))test;
+
+/**
+ Like requestWithURL:alwaysTreatsHostAsPathComponent:passingFirstPathComponentTest:, but a URL that fails the test can still get a request.
+ 
+ The rejected request keeps the laid out URL and the hash that failed the test, and only splits up its path the first time
+ its path components are asked for. Another test of the same URL can then be run with getFirstPathComponentHash:,
+ without the URL being tokenized again.
+ 
+ @param URL The URL to route.
+ @param alwaysTreatsHostAsPathComponent The global option for if to treat the URL host as a path component or not.
+ @param test Returns whether a request is wanted for a URL whose first path component has the given hashForPathComponent: hash.
+ @param rejectedRequest If not NULL, set to a request for the URL if test returned NO, and left alone otherwise.
+ 
+ @returns The newly initialized route request, or nil if test returned NO.
+ */
++ (nullable instancetype)requestWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:(BOOL (NS_NOESCAPE ^)(NSUInteger firstPathComponentHash))test rejectedRequest:(JLRRouteRequest *_Nullable __autoreleasing *_Nullable)rejectedRequest;
+
 /// Unavailable, use initWithURL:alwaysTreatsHostAsPathComponent: instead.
 - (instancetype)init NS_UNAVAILABLE;
 
 /// Unavailable, use initWithURL:alwaysTreatsHostAsPathComponent: instead.
 + (instancetype)new NS_UNAVAILABLE;
 
+
+///-------------------------------
+/// @name Accessing Query Parameters
+///-------------------------------
+
+
+/**
+ Returns the URL's query parameters, with '+' decoded as a space if requested.
+ 
+ The decoded parameters are only built once per request, so every route tried for the request shares them.
+ 
+ @param decodePlusSymbols The global plus symbol decoding option value.
+ 
+ @returns The query parameters, decoded as requested.
+ */
+- (NSDictionary *)queryParamsDecodingPlusSymbols:(BOOL)decodePlusSymbols;
+
+
+///-------------------------------
+/// @name Hashing Path Components
+///-------------------------------
+
+
+/**
+ Returns the hash of a path component, as used by getFirstPathComponentHash:.
+ 
+ @param pathComponent The path component to hash.
+ 
+ @returns The path component's hash.
+ */
++ (NSUInteger)hashForPathComponent:(NSString *)pathComponent;
+
+/**
+ Gets the hash of the request's first path component, which is taken while the URL is tokenized rather than from its string.
+ 
+ @param hash On return, the hash of the first path component, the same as hashForPathComponent: would give for it.
+ 
+ @returns YES if the hash is known, NO if the URL is one that only NSURLComponents can parse, in which case hash is left alone.
+ */
+- (BOOL)getFirstPathComponentHash:(NSUInteger *)hash;
+
 @end
 
 
@@ -11,6 +11,17 @@
  */
 
 #import "JLRRouteRequest.h"
+#import "JLRParsingUtilities.h"
+#import "JLRScratchStorage.h"
+
+
+// byte ranges of the parts of a URL string. location is NSNotFound for a query or fragment that isn't there at all.
+typedef struct {
+    NSRange host;
+    NSRange path;
+    NSRange query;
+    NSRange fragment;
+} JLRURLTokens;
 
 
 @interface JLRRouteRequest ()
@@ -19,95 +30,678 @@
 @property (nonatomic, strong) NSArray *pathComponents;
 @property (nonatomic, strong) NSDictionary *queryParams;
 
+// query parsing is deferred until something asks for the params, which most routes tried for a URL never do
+@property (nonatomic, copy) NSString *URLString;
+@property (nonatomic, assign) BOOL alwaysTreatsHostAsPathComponent;
+@property (nonatomic, assign) NSRange queryRange;
+@property (nonatomic, assign) NSRange fragmentQueryRange;
+@property (nonatomic, strong) NSURLComponents *URLComponents;
+@property (nonatomic, strong) NSDictionary *plusDecodedQueryParams;
+
+// taken while tokenizing, so the first path component filters of later routes controllers don't need to tokenize again
+@property (nonatomic, assign) BOOL hasFirstPathComponentHash;
+@property (nonatomic, assign) NSUInteger firstPathComponentHash;
+
 @end
 
 
-@implementation JLRRouteRequest
+static const char *JLRBytesForString(NSString *string)
+{
+    if (string == nil) {
+        return NULL;
+    }
+    return CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8) ?: [string UTF8String];
+}
 
-- (instancetype)initWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent
+static BOOL JLRIsURLCharacter(unsigned char character)
 {
-    if ((self = [super init])) {
-        self.URL = URL;
+    // unreserved and reserved characters, except for the brackets around IPv6 hosts, plus '%' for escapes
+    return isalnum(character) || (character != '\0' && strchr("-._~!$&'()*+,;=:/?#@%", character) != NULL);
+}
+
+static BOOL JLRTokenizeURL(const char *bytes, NSUInteger length, JLRURLTokens *tokens)
+{
+    NSUInteger index = 0;
+    
+    // scheme, which has to be followed by an authority
+    if (length == 0 || !isalpha((unsigned char)bytes[0])) {
+        return NO;
+    }
+    
+    while (index < length && (isalnum((unsigned char)bytes[index]) || bytes[index] == '+' || bytes[index] == '-' || bytes[index] == '.')) {
+        index++;
+    }
+    
+    if (index + 3 > length || bytes[index] != ':' || bytes[index + 1] != '/' || bytes[index + 2] != '/') {
+        return NO;
+    }
+    index += 3;
+    
+    for (NSUInteger characterIndex = index; characterIndex < length; characterIndex++) {
+        unsigned char character = (unsigned char)bytes[characterIndex];
+        if (!JLRIsURLCharacter(character)) {
+            return NO;
+        }
+        if (character == '%' && (characterIndex + 2 >= length || !isxdigit((unsigned char)bytes[characterIndex + 1]) || !isxdigit((unsigned char)bytes[characterIndex + 2]))) {
+            return NO;
+        }
+    }
+    
+    // host, leaving user info, ports and escaped hosts to NSURLComponents
+    tokens->host.location = index;
+    while (index < length && bytes[index] != '/' && bytes[index] != '?' && bytes[index] != '#') {
+        if (bytes[index] == '@' || bytes[index] == ':' || bytes[index] == '%') {
+            return NO;
+        }
+        index++;
+    }
+    tokens->host.length = index - tokens->host.location;
+    
+    // path
+    tokens->path.location = index;
+    while (index < length && bytes[index] != '?' && bytes[index] != '#') {
+        index++;
+    }
+    tokens->path.length = index - tokens->path.location;
+    
+    // query
+    tokens->query = NSMakeRange(NSNotFound, 0);
+    if (index < length && bytes[index] == '?') {
+        index++;
+        tokens->query.location = index;
+        while (index < length && bytes[index] != '#') {
+            index++;
+        }
+        tokens->query.length = index - tokens->query.location;
+    }
+    
+    // fragment, as long as it would parse as a plain path and query rather than with a scheme or authority of its own
+    tokens->fragment = NSMakeRange(NSNotFound, 0);
+    if (index < length) {
+        index++;
+        tokens->fragment = NSMakeRange(index, length - index);
         
-        NSURLComponents *components = [NSURLComponents componentsWithString:[self.URL absoluteString]];
+        const char *fragment = bytes + index;
+        if (memchr(fragment, '#', length - index) != NULL || memchr(fragment, ':', length - index) != NULL || (length - index >= 2 && fragment[0] == '/' && fragment[1] == '/')) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+static BOOL JLRRangeContainsCharacter(const char *bytes, NSRange range, char character)
+{
+    return range.location != NSNotFound && memchr(bytes + range.location, character, range.length) != NULL;
+}
+
+static BOOL JLRRangeEqualsString(const char *bytes, NSRange range, const char *string)
+{
+    return strlen(string) == range.length && memcmp(bytes + range.location, string, range.length) == 0;
+}
+
+static BOOL JLRRangesEqual(const char *bytes, NSRange range1, NSRange range2)
+{
+    return range1.length == range2.length && memcmp(bytes + range1.location, bytes + range2.location, range1.length) == 0;
+}
+
+static BOOL JLRFirstQueryItemHasValue(const char *bytes, NSRange query)
+{
+    const char *item = bytes + query.location;
+    const char *ampersand = memchr(item, '&', query.length);
+    NSUInteger itemLength = ampersand != NULL ? (NSUInteger)(ampersand - item) : query.length;
+    const char *equals = memchr(item, '=', itemLength);
+    
+    return equals != NULL && equals + 1 < item + itemLength;
+}
+
+// a tokenized URL along with how its fragment and host contribute to the final path and query
+typedef struct {
+    JLRURLTokens tokens;
+    BOOL treatsHostAsPathComponent;
+    NSRange fragmentPath;
+    NSRange fragmentQuery;
+} JLRURLLayout;
+
+static BOOL JLRLayOutURL(const char *bytes, BOOL alwaysTreatsHostAsPathComponent, JLRURLLayout *layout)
+{
+    JLRURLTokens tokens;
+    if (!JLRTokenizeURL(bytes, strlen(bytes), &tokens)) {
+        return NO;
+    }
+    
+    layout->tokens = tokens;
+    layout->treatsHostAsPathComponent = tokens.host.length > 0 && (alwaysTreatsHostAsPathComponent || (!JLRRangeEqualsString(bytes, tokens.host, "localhost") && memchr(bytes + tokens.host.location, '.', tokens.host.length) == NULL));
+    
+    // the fragment is parsed as a URL of its own. if it leads with query params they are merged in with the rest, and
+    // its path is added to the main path after a '#', unless that path was itself the query params.
+    layout->fragmentPath = NSMakeRange(NSNotFound, 0);
+    layout->fragmentQuery = NSMakeRange(NSNotFound, 0);
+    
+    if (tokens.fragment.location != NSNotFound) {
+        const char *fragment = bytes + tokens.fragment.location;
+        const char *questionMark = memchr(fragment, '?', tokens.fragment.length);
+        NSRange path = tokens.fragment;
+        NSRange query = tokens.fragment;
         
-        if (components.host.length > 0 && (alwaysTreatsHostAsPathComponent || (![components.host isEqualToString:@"localhost"] && [components.host rangeOfString:@"."].location == NSNotFound))) {
-            // convert the host to "/" so that the host is considered a path component
-            NSString *host = [components.percentEncodedHost copy];
-            components.host = @"/";
-            components.percentEncodedPath = [host stringByAppendingPathComponent:(components.percentEncodedPath ?: @"")];
+        if (questionMark != NULL) {
+            path.length = (NSUInteger)(questionMark - fragment);
+            query = NSMakeRange(path.location + path.length + 1, tokens.fragment.length - path.length - 1);
+        } else if (memchr(fragment, '%', tokens.fragment.length) != NULL) {
+            // without a query the decoded path gets used as the query, which doesn't always survive re-encoding
+            return NO;
         }
         
-        NSString *path = [components percentEncodedPath];
+        BOOL fragmentContainsQueryParams = JLRFirstQueryItemHasValue(bytes, query);
         
-        // handle fragment if needed
-        if (components.fragment != nil) {
-            BOOL fragmentContainsQueryParams = NO;
-            NSURLComponents *fragmentComponents = [NSURLComponents componentsWithString:components.percentEncodedFragment];
-            
-            if (fragmentComponents.query == nil && fragmentComponents.path != nil) {
-                fragmentComponents.query = fragmentComponents.path;
-            }
-            
-            if (fragmentComponents.queryItems.count > 0) {
-                // determine if this fragment is only valid query params and nothing else
-                fragmentContainsQueryParams = fragmentComponents.queryItems.firstObject.value.length > 0;
-            }
-            
-            if (fragmentContainsQueryParams) {
-                // include fragment query params in with the standard set
-                components.queryItems = [(components.queryItems ?: @[]) arrayByAddingObjectsFromArray:fragmentComponents.queryItems];
-            }
-            
-            if (fragmentComponents.path != nil && (!fragmentContainsQueryParams || ![fragmentComponents.path isEqualToString:fragmentComponents.query])) {
-                // handle fragment by include fragment path as part of the main path
-                path = [path stringByAppendingString:[NSString stringWithFormat:@"#%@", fragmentComponents.percentEncodedPath]];
+        if (fragmentContainsQueryParams) {
+            if (JLRRangeContainsCharacter(bytes, tokens.query, '%') || JLRRangeContainsCharacter(bytes, query, '%')) {
+                // merging query items re-encodes them, which turns escaped '&' and '=' back into separators
+                return NO;
             }
+            layout->fragmentQuery = query;
         }
         
-        // strip off leading slash so that we don't have an empty first path component
-        if (path.length > 0 && [path characterAtIndex:0] == '/') {
-            path = [path substringFromIndex:1];
+        if (!fragmentContainsQueryParams || (questionMark != NULL && !JLRRangesEqual(bytes, path, query))) {
+            layout->fragmentPath = path;
         }
+    }
+    
+    return YES;
+}
+
+static NSUInteger JLRPathCapacity(const JLRURLLayout *layout)
+{
+    // at most the host, the path, a '/' between them and the fragment path after a '#'
+    return layout->tokens.host.length + layout->tokens.path.length + (layout->fragmentPath.location != NSNotFound ? layout->fragmentPath.length : 0) + 2;
+}
+
+static NSRange JLRAssemblePath(const char *bytes, const JLRURLLayout *layout, char *path)
+{
+    NSRange host = layout->tokens.host;
+    NSRange URLPath = layout->tokens.path;
+    NSUInteger pathLength = 0;
+    
+    if (layout->treatsHostAsPathComponent) {
+        // same result as [host stringByAppendingPathComponent:path], which collapses repeated slashes and drops a trailing one
+        memcpy(path, bytes + host.location, host.length);
+        pathLength = host.length;
+        path[pathLength++] = '/';
         
-        // strip off trailing slash for the same reason
-        if (path.length > 0 && [path characterAtIndex:path.length - 1] == '/') {
-            path = [path substringToIndex:path.length - 1];
+        for (NSUInteger index = URLPath.location; index < NSMaxRange(URLPath); index++) {
+            if (bytes[index] != '/' || path[pathLength - 1] != '/') {
+                path[pathLength++] = bytes[index];
+            }
         }
         
-        // split apart into path components
-        self.pathComponents = [path componentsSeparatedByString:@"/"];
+        if (path[pathLength - 1] == '/') {
+            pathLength--;
+        }
+    } else {
+        memcpy(path, bytes + URLPath.location, URLPath.length);
+        pathLength = URLPath.length;
+    }
+    
+    if (layout->fragmentPath.location != NSNotFound) {
+        path[pathLength++] = '#';
+        memcpy(path + pathLength, bytes + layout->fragmentPath.location, layout->fragmentPath.length);
+        pathLength += layout->fragmentPath.length;
+    }
+    
+    // strip off one leading and one trailing slash so that we don't have empty first or last path components
+    NSUInteger start = 0;
+    NSUInteger end = pathLength;
+    
+    if (end > start && path[start] == '/') {
+        start++;
+    }
+    
+    if (end > start && path[end - 1] == '/') {
+        end--;
+    }
+    
+    return NSMakeRange(start, end - start);
+}
+
+static NSUInteger JLRHashBytes(const char *bytes, NSUInteger length)
+{
+    // 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (NSUInteger index = 0; index < length; index++) {
+        hash ^= (unsigned char)bytes[index];
+        hash *= 1099511628211ULL;
+    }
+    return (NSUInteger)hash;
+}
+
+static NSUInteger JLRHashFirstPathComponent(const char *path, NSRange pathRange)
+{
+    const char *separator = memchr(path + pathRange.location, '/', pathRange.length);
+    NSUInteger componentLength = separator != NULL ? (NSUInteger)(separator - (path + pathRange.location)) : pathRange.length;
+    return JLRHashBytes(path + pathRange.location, componentLength);
+}
+
+static CFArrayRef JLRCreatePathComponents(JLRScratchStorage *scratchStorage, const char *path, NSRange pathRange)
+{
+    // the component strings go straight into one immutable array, so the only allocations are the strings and the array
+    NSUInteger componentCount = 1;
+    for (NSUInteger index = pathRange.location; index < NSMaxRange(pathRange); index++) {
+        if (path[index] == '/') {
+            componentCount++;
+        }
+    }
+    
+    // split apart into path components
+    CFStringRef *pathComponents = JLRScratchStorageGetBuffer(scratchStorage, JLRScratchBufferPathComponents, componentCount * sizeof(CFStringRef));
+    NSUInteger createdCount = 0;
+    NSUInteger componentStart = pathRange.location;
+    
+    for (NSUInteger index = pathRange.location; index <= NSMaxRange(pathRange); index++) {
+        if (index == NSMaxRange(pathRange) || path[index] == '/') {
+            CFStringRef pathComponent = CFStringCreateWithBytes(kCFAllocatorDefault, (const UInt8 *)path + componentStart, (CFIndex)(index - componentStart), kCFStringEncodingUTF8, false);
+            if (pathComponent == NULL) {
+                break;
+            }
+            pathComponents[createdCount++] = pathComponent;
+            componentStart = index + 1;
+        }
+    }
+    
+    CFArrayRef pathComponentsArray = NULL;
+    if (createdCount == componentCount) {
+        pathComponentsArray = CFArrayCreate(kCFAllocatorDefault, (const void **)pathComponents, (CFIndex)componentCount, &kCFTypeArrayCallBacks);
+    }
+    
+    // the array retained the strings
+    for (NSUInteger index = 0; index < createdCount; index++) {
+        CFRelease(pathComponents[index]);
+    }
+    
+    // NULL for a component that isn't valid UTF-8
+    return pathComponentsArray;
+}
+
+static int JLRHexValue(char character)
+{
+    if (character >= '0' && character <= '9') {
+        return character - '0';
+    } else if (character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    } else if (character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    return -1;
+}
+
+static NSString *JLRDecodedString(const char *bytes, NSRange range)
+{
+    if (!JLRRangeContainsCharacter(bytes, range, '%')) {
+        return [[NSString alloc] initWithBytes:bytes + range.location length:range.length encoding:NSUTF8StringEncoding];
+    }
+    
+    // decoding never makes the string longer, so it's decoded into scratch memory and only the result is allocated
+    JLRScratchStorage *scratchStorage = JLRScratchStorageAcquire();
+    char *decodedBytes = JLRScratchStorageGetBuffer(scratchStorage, JLRScratchBufferDecoding, range.length);
+    NSUInteger decodedLength = 0;
+    BOOL isValid = YES;
+    
+    for (NSUInteger index = range.location; index < NSMaxRange(range) && isValid; index++) {
+        if (bytes[index] != '%') {
+            decodedBytes[decodedLength++] = bytes[index];
+            continue;
+        }
         
-        // convert query items into a dictionary
-        NSArray <NSURLQueryItem *> *queryItems = [components queryItems] ?: @[];
-        NSMutableDictionary *queryParams = [NSMutableDictionary dictionary];
-        for (NSURLQueryItem *item in queryItems) {
-            if (item.value == nil) {
-                continue;
+        int highValue = index + 2 < NSMaxRange(range) ? JLRHexValue(bytes[index + 1]) : -1;
+        int lowValue = highValue >= 0 ? JLRHexValue(bytes[index + 2]) : -1;
+        isValid = (lowValue >= 0);
+        decodedBytes[decodedLength++] = (char)(highValue * 16 + lowValue);
+        index += 2;
+    }
+    
+    // nil for escapes that aren't valid UTF-8, just like stringByRemovingPercentEncoding
+    NSString *string = isValid ? [[NSString alloc] initWithBytes:decodedBytes length:decodedLength encoding:NSUTF8StringEncoding] : nil;
+    JLRScratchStorageRelinquish(scratchStorage);
+    
+    return string;
+}
+
+static BOOL JLRAddQueryParams(const char *bytes, NSRange query, NSMutableDictionary *queryParams)
+{
+    if (query.location == NSNotFound) {
+        return YES;
+    }
+    
+    NSUInteger itemStart = query.location;
+    
+    while (itemStart <= NSMaxRange(query)) {
+        const char *ampersand = memchr(bytes + itemStart, '&', NSMaxRange(query) - itemStart);
+        NSUInteger itemEnd = ampersand != NULL ? (NSUInteger)(ampersand - bytes) : NSMaxRange(query);
+        const char *equals = memchr(bytes + itemStart, '=', itemEnd - itemStart);
+        
+        // items without a value are skipped
+        if (equals != NULL) {
+            NSUInteger valueStart = (NSUInteger)(equals - bytes) + 1;
+            NSString *name = JLRDecodedString(bytes, NSMakeRange(itemStart, valueStart - 1 - itemStart));
+            NSString *value = JLRDecodedString(bytes, NSMakeRange(valueStart, itemEnd - valueStart));
+            
+            if (name == nil || value == nil) {
+                return NO;
             }
             
-            if (queryParams[item.name] == nil) {
+            if (queryParams[name] == nil) {
                 // first time seeing a param with this name, set it
-                queryParams[item.name] = item.value;
-            } else if ([queryParams[item.name] isKindOfClass:[NSArray class]]) {
+                queryParams[name] = value;
+            } else if ([queryParams[name] isKindOfClass:[NSArray class]]) {
                 // already an array of these items, append it
-                NSArray *values = (NSArray *)(queryParams[item.name]);
-                queryParams[item.name] = [values arrayByAddingObject:item.value];
+                NSArray *values = (NSArray *)(queryParams[name]);
+                queryParams[name] = [values arrayByAddingObject:value];
             } else {
                 // existing non-array value for this key, create an array
-                id existingValue = queryParams[item.name];
-                queryParams[item.name] = @[existingValue, item.value];
+                id existingValue = queryParams[name];
+                queryParams[name] = @[existingValue, value];
             }
         }
         
-        self.queryParams = [queryParams copy];
+        itemStart = itemEnd + 1;
+    }
+    
+    return YES;
+}
+
+
+@interface JLRRouteRequest ()
+
+// a rejected request keeps its layout, and splits up the path the first time the path components are asked for
+@property (nonatomic, assign) BOOL defersPathComponents;
+@property (nonatomic, assign) JLRURLLayout deferredLayout;
+
+// for a URL +requestWithURL:... has already laid out and split up, so it isn't tokenized a second time. nil path
+// components are split up from layout on demand.
+- (instancetype)_initWithURL:(NSURL *)URL URLString:(NSString *)URLString alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent layout:(const JLRURLLayout *)layout pathComponents:(NSArray *)pathComponents firstPathComponentHash:(NSUInteger)firstPathComponentHash NS_DESIGNATED_INITIALIZER;
+
+@end
+
+
+@implementation JLRRouteRequest
+
+- (instancetype)initWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent
+{
+    if ((self = [super init])) {
+        self.URL = URL;
+        self.URLString = [URL absoluteString];
+        self.alwaysTreatsHostAsPathComponent = alwaysTreatsHostAsPathComponent;
+        self.queryRange = NSMakeRange(NSNotFound, 0);
+        self.fragmentQueryRange = NSMakeRange(NSNotFound, 0);
+        
+        // the tokenizer only takes URLs it can break up exactly the way NSURLComponents would, and leaves the
+        // rest (user info, ports, non-ASCII characters and some unusual fragments) to NSURLComponents itself.
+        NSArray *pathComponents = [self _pathComponentsByTokenizingURLString:self.URLString];
+        if (pathComponents == nil) {
+            pathComponents = [self _pathComponentsByParsingURLString:self.URLString];
+        }
+        self.pathComponents = pathComponents;
     }
     return self;
 }
 
++ (instancetype)requestWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:(BOOL (NS_NOESCAPE ^)(NSUInteger firstPathComponentHash))test
+{
+    return [self requestWithURL:URL alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:test rejectedRequest:NULL];
+}
+
++ (instancetype)requestWithURL:(NSURL *)URL alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:(BOOL (NS_NOESCAPE ^)(NSUInteger firstPathComponentHash))test rejectedRequest:(JLRRouteRequest *__autoreleasing *)rejectedRequest
+{
+    NSString *URLString = [URL absoluteString];
+    const char *bytes = JLRBytesForString(URLString);
+    JLRURLLayout layout;
+    
+    if (bytes == NULL || !JLRLayOutURL(bytes, alwaysTreatsHostAsPathComponent, &layout)) {
+        // only NSURLComponents can parse this URL, so there's no hash to test it by
+        return [[self alloc] initWithURL:URL alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent];
+    }
+    
+    // the first path component is tested straight from the assembled path, and the same path is split up if it passes
+    JLRScratchStorage *scratchStorage = JLRScratchStorageAcquire();
+    char *path = JLRScratchStorageGetBuffer(scratchStorage, JLRScratchBufferPath, JLRPathCapacity(&layout));
+    NSRange pathRange = JLRAssemblePath(bytes, &layout, path);
+    
+    NSUInteger firstPathComponentHash = JLRHashFirstPathComponent(path, pathRange);
+    if (!test(firstPathComponentHash)) {
+        JLRScratchStorageRelinquish(scratchStorage);
+        if (rejectedRequest != NULL) {
+            *rejectedRequest = [[self alloc] _initWithURL:URL URLString:URLString alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent layout:&layout pathComponents:nil firstPathComponentHash:firstPathComponentHash];
+        }
+        return nil;
+    }
+    
+    NSArray *pathComponents = CFBridgingRelease(JLRCreatePathComponents(scratchStorage, path, pathRange));
+    JLRScratchStorageRelinquish(scratchStorage);
+    
+    if (pathComponents == nil) {
+        return [[self alloc] initWithURL:URL alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent];
+    }
+    
+    return [[self alloc] _initWithURL:URL URLString:URLString alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent layout:&layout pathComponents:pathComponents firstPathComponentHash:firstPathComponentHash];
+}
+
+- (instancetype)_initWithURL:(NSURL *)URL URLString:(NSString *)URLString alwaysTreatsHostAsPathComponent:(BOOL)alwaysTreatsHostAsPathComponent layout:(const JLRURLLayout *)layout pathComponents:(NSArray *)pathComponents firstPathComponentHash:(NSUInteger)firstPathComponentHash
+{
+    if ((self = [super init])) {
+        self.URL = URL;
+        self.URLString = URLString;
+        self.alwaysTreatsHostAsPathComponent = alwaysTreatsHostAsPathComponent;
+        self.queryRange = layout->tokens.query;
+        self.fragmentQueryRange = layout->fragmentQuery;
+        self.pathComponents = pathComponents;
+        self.hasFirstPathComponentHash = YES;
+        self.firstPathComponentHash = firstPathComponentHash;
+        
+        if (pathComponents == nil) {
+            self.defersPathComponents = YES;
+            self.deferredLayout = *layout;
+        }
+    }
+    return self;
+}
+
+- (NSArray *)pathComponents
+{
+    if (_pathComponents == nil && self.defersPathComponents) {
+        self.defersPathComponents = NO;
+        _pathComponents = [self _pathComponentsBySplittingDeferredLayout];
+    }
+    return _pathComponents;
+}
+
+- (NSDictionary *)queryParams
+{
+    if (_queryParams == nil) {
+        _queryParams = [self _parseQueryParams];
+    }
+    return _queryParams;
+}
+
+- (NSDictionary *)queryParamsDecodingPlusSymbols:(BOOL)decodePlusSymbols
+{
+    if (!decodePlusSymbols) {
+        return self.queryParams;
+    }
+    
+    if (self.plusDecodedQueryParams == nil) {
+        self.plusDecodedQueryParams = [JLRParsingUtilities queryParams:self.queryParams decodePlusSymbols:YES];
+    }
+    return self.plusDecodedQueryParams;
+}
+
 - (NSString *)description
 {
     return [NSString stringWithFormat:@"<%@ %p> - URL: %@", NSStringFromClass([self class]), self, [self.URL absoluteString]];
 }
 
+#pragma mark - Path Component Hashes
+
++ (NSUInteger)hashForPathComponent:(NSString *)pathComponent
+{
+    const char *bytes = JLRBytesForString(pathComponent);
+    return JLRHashBytes(bytes, strlen(bytes));
+}
+
+- (BOOL)getFirstPathComponentHash:(NSUInteger *)hash
+{
+    if (!self.hasFirstPathComponentHash) {
+        return NO;
+    }
+    
+    *hash = self.firstPathComponentHash;
+    return YES;
+}
+
+#pragma mark - Tokenizing
+
+- (NSArray *)_pathComponentsByTokenizingURLString:(NSString *)URLString
+{
+    const char *bytes = JLRBytesForString(URLString);
+    JLRURLLayout layout;
+    
+    if (bytes == NULL || !JLRLayOutURL(bytes, self.alwaysTreatsHostAsPathComponent, &layout)) {
+        return nil;
+    }
+    
+    // the path is assembled in the thread's scratch storage
+    JLRScratchStorage *scratchStorage = JLRScratchStorageAcquire();
+    char *path = JLRScratchStorageGetBuffer(scratchStorage, JLRScratchBufferPath, JLRPathCapacity(&layout));
+    NSRange pathRange = JLRAssemblePath(bytes, &layout, path);
+    CFArrayRef pathComponents = JLRCreatePathComponents(scratchStorage, path, pathRange);
+    NSUInteger firstPathComponentHash = JLRHashFirstPathComponent(path, pathRange);
+    JLRScratchStorageRelinquish(scratchStorage);
+    
+    if (pathComponents != NULL) {
+        self.queryRange = layout.tokens.query;
+        self.fragmentQueryRange = layout.fragmentQuery;
+        self.hasFirstPathComponentHash = YES;
+        self.firstPathComponentHash = firstPathComponentHash;
+    }
+    
+    // nil leaves a component that isn't valid UTF-8 to NSURLComponents
+    return CFBridgingRelease(pathComponents);
+}
+
+- (NSArray *)_pathComponentsBySplittingDeferredLayout
+{
+    // the URL was laid out and its path assembled once already, only to have its first path component turned down
+    const char *bytes = JLRBytesForString(self.URLString);
+    JLRURLLayout layout = self.deferredLayout;
+    
+    JLRScratchStorage *scratchStorage = JLRScratchStorageAcquire();
+    char *path = JLRScratchStorageGetBuffer(scratchStorage, JLRScratchBufferPath, JLRPathCapacity(&layout));
+    NSRange pathRange = JLRAssemblePath(bytes, &layout, path);
+    NSArray *pathComponents = CFBridgingRelease(JLRCreatePathComponents(scratchStorage, path, pathRange));
+    JLRScratchStorageRelinquish(scratchStorage);
+    
+    // a component that isn't valid UTF-8 is left to NSURLComponents
+    return pathComponents ?: [self _pathComponentsByParsingURLString:self.URLString];
+}
+
+- (NSDictionary *)_parseQueryParams
+{
+    if (self.URLComponents == nil) {
+        if (self.queryRange.location == NSNotFound && self.fragmentQueryRange.location == NSNotFound) {
+            return @{};
+        }
+        
+        const char *bytes = JLRBytesForString(self.URLString);
+        NSMutableDictionary *queryParams = [NSMutableDictionary dictionary];
+        
+        if (bytes != NULL && JLRAddQueryParams(bytes, self.queryRange, queryParams) && JLRAddQueryParams(bytes, self.fragmentQueryRange, queryParams)) {
+            return [queryParams copy];
+        }
+        
+        // an escape that doesn't decode to UTF-8, leave it to NSURLComponents
+        [self _pathComponentsByParsingURLString:self.URLString];
+    }
+    
+    // convert query items into a dictionary
+    NSArray <NSURLQueryItem *> *queryItems = [self.URLComponents queryItems] ?: @[];
+    NSMutableDictionary *queryParams = [NSMutableDictionary dictionary];
+    for (NSURLQueryItem *item in queryItems) {
+        if (item.value == nil) {
+            continue;
+        }
+        
+        if (queryParams[item.name] == nil) {
+            // first time seeing a param with this name, set it
+            queryParams[item.name] = item.value;
+        } else if ([queryParams[item.name] isKindOfClass:[NSArray class]]) {
+            // already an array of these items, append it
+            NSArray *values = (NSArray *)(queryParams[item.name]);
+            queryParams[item.name] = [values arrayByAddingObject:item.value];
+        } else {
+            // existing non-array value for this key, create an array
+            id existingValue = queryParams[item.name];
+            queryParams[item.name] = @[existingValue, item.value];
+        }
+    }
+    
+    return [queryParams copy];
+}
+
+#pragma mark - Parsing With NSURLComponents
+
+- (NSArray *)_pathComponentsByParsingURLString:(NSString *)URLString
+{
+    NSURLComponents *components = [NSURLComponents componentsWithString:URLString];
+    
+    if (components.host.length > 0 && (self.alwaysTreatsHostAsPathComponent || (![components.host isEqualToString:@"localhost"] && [components.host rangeOfString:@"."].location == NSNotFound))) {
+        // convert the host to "/" so that the host is considered a path component
+        NSString *host = [components.percentEncodedHost copy];
+        components.host = @"/";
+        components.percentEncodedPath = [host stringByAppendingPathComponent:(components.percentEncodedPath ?: @"")];
+    }
+    
+    NSString *path = [components percentEncodedPath];
+    
+    // handle fragment if needed
+    if (components.fragment != nil) {
+        BOOL fragmentContainsQueryParams = NO;
+        NSURLComponents *fragmentComponents = [NSURLComponents componentsWithString:components.percentEncodedFragment];
+        
+        if (fragmentComponents.query == nil && fragmentComponents.path != nil) {
+            fragmentComponents.query = fragmentComponents.path;
+        }
+        
+        if (fragmentComponents.queryItems.count > 0) {
+            // determine if this fragment is only valid query params and nothing else
+            fragmentContainsQueryParams = fragmentComponents.queryItems.firstObject.value.length > 0;
+        }
+        
+        if (fragmentContainsQueryParams) {
+            // include fragment query params in with the standard set
+            components.queryItems = [(components.queryItems ?: @[]) arrayByAddingObjectsFromArray:fragmentComponents.queryItems];
+        }
+        
+        if (fragmentComponents.path != nil && (!fragmentContainsQueryParams || ![fragmentComponents.path isEqualToString:fragmentComponents.query])) {
+            // handle fragment by include fragment path as part of the main path
+            path = [path stringByAppendingString:[NSString stringWithFormat:@"#%@", fragmentComponents.percentEncodedPath]];
+        }
+    }
+    
+    // strip off leading slash so that we don't have an empty first path component
+    if (path.length > 0 && [path characterAtIndex:0] == '/') {
+        path = [path substringFromIndex:1];
+    }
+    
+    // strip off trailing slash for the same reason
+    if (path.length > 0 && [path characterAtIndex:path.length - 1] == '/') {
+        path = [path substringToIndex:path.length - 1];
+    }
+    
+    // split apart into path components
+    NSArray *pathComponents = [path componentsSeparatedByString:@"/"];
+    
+    // the query items are turned into params on demand, see -_parseQueryParams
+    self.URLComponents = components;
+    
+    return pathComponents;
+}
+
 @end
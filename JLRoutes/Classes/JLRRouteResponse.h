@@ -33,7 +33,7 @@ NS_ASSUME_NONNULL_BEGIN
 ///-------------------------------
 
 
-/// Creates an invalid match response.
+/// Returns an invalid match response. This is a shared instance, so it is never allocated on a failed match.
 + (instancetype)invalidMatchResponse;
 
 /// Creates a valid match response with the given parameters.
@@ -25,9 +25,22 @@
 
 + (instancetype)invalidMatchResponse
 {
-    JLRRouteResponse *response = [[[self class] alloc] init];
-    response.match = NO;
-    return response;
+    if (self != [JLRRouteResponse class]) {
+        // subclasses get their own instance, the shared one is always a JLRRouteResponse
+        JLRRouteResponse *response = [[[self class] alloc] init];
+        response.match = NO;
+        return response;
+    }
+    
+    // an invalid match response carries no state, so a single shared instance serves every failed match
+    static JLRRouteResponse *sharedInvalidMatchResponse = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInvalidMatchResponse = [[JLRRouteResponse alloc] init];
+        sharedInvalidMatchResponse.match = NO;
+    });
+    
+    return sharedInvalidMatchResponse;
 }
 
 + (instancetype)validMatchResponseWithParameters:(NSDictionary *)parameters
@@ -0,0 +1,72 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRRouteResultCache is a bounded, thread safe least-recently-used cache from strings to objects.
+ 
+ Once the cache holds capacity objects, adding another one evicts whichever object was looked up or added least recently.
+ The cache counts lookups that found a usable object as hits and every other lookup as a miss.
+ */
+
+@interface JLRRouteResultCache : NSObject
+
+/// The maximum number of objects held at once.
+@property (nonatomic, assign, readonly) NSUInteger capacity;
+
+/// The number of lookups that returned an object.
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+
+/// The number of lookups that didn't return an object.
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+
+
+/**
+ Creates a new, empty cache.
+ 
+ @param capacity The maximum number of objects to hold at once. Must be greater than 0.
+ 
+ @returns The newly initialized cache.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, use initWithCapacity: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, use initWithCapacity: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+
+/**
+ Looks up the object for a key and marks it as the most recently used.
+ 
+ @param key The key to look up.
+ @param isValid Called with the cached object, if there is one. Returning NO removes the object and counts the lookup as a miss.
+ 
+ @returns The cached object, or nil if there isn't a valid one.
+ */
+- (nullable id)objectForKey:(NSString *)key passingTest:(BOOL (NS_NOESCAPE ^)(id object))isValid;
+
+/// Adds an object as the most recently used, evicting the least recently used object if the cache is full.
+- (void)setObject:(id)object forKey:(NSString *)key;
+
+/// Removes all objects. The hit and miss counts are kept.
+- (void)removeAllObjects;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
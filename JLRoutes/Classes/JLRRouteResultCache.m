@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRouteResultCache.h"
+#import <pthread.h>
+
+
+@interface JLRRouteResultCacheNode : NSObject
+
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, strong) id object;
+
+// the list runs from most to least recently used. next is strong and previous is not, so the list doesn't form retain cycles.
+@property (nonatomic, strong) JLRRouteResultCacheNode *next;
+@property (nonatomic, weak) JLRRouteResultCacheNode *previous;
+
+@end
+
+
+@implementation JLRRouteResultCacheNode
+
+@end
+
+
+@interface JLRRouteResultCache () {
+    pthread_mutex_t _lock;
+}
+
+@property (nonatomic, assign) NSUInteger capacity;
+@property (nonatomic, assign) NSUInteger hitCount;
+@property (nonatomic, assign) NSUInteger missCount;
+
+@property (nonatomic, strong) NSMutableDictionary <NSString *, JLRRouteResultCacheNode *> *nodes;
+@property (nonatomic, strong) JLRRouteResultCacheNode *head;
+@property (nonatomic, weak) JLRRouteResultCacheNode *tail;
+
+@end
+
+
+@implementation JLRRouteResultCache
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+    NSParameterAssert(capacity > 0);
+    
+    if ((self = [super init])) {
+        self.capacity = capacity;
+        self.nodes = [NSMutableDictionary dictionaryWithCapacity:capacity];
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - %@ of %@ (hits: %@, misses: %@)", NSStringFromClass([self class]), self, @(self.nodes.count), @(self.capacity), @(self.hitCount), @(self.missCount)];
+}
+
+- (id)objectForKey:(NSString *)key passingTest:(BOOL (NS_NOESCAPE ^)(id object))isValid
+{
+    pthread_mutex_lock(&_lock);
+    
+    JLRRouteResultCacheNode *node = self.nodes[key];
+    id object = node.object;
+    
+    if (node != nil && !isValid(object)) {
+        [self _removeNode:node];
+        object = nil;
+    }
+    
+    if (object != nil) {
+        self.hitCount++;
+        [self _unlinkNode:node];
+        [self _insertNodeAtHead:node];
+    } else {
+        self.missCount++;
+    }
+    
+    pthread_mutex_unlock(&_lock);
+    
+    return object;
+}
+
+- (void)setObject:(id)object forKey:(NSString *)key
+{
+    pthread_mutex_lock(&_lock);
+    
+    JLRRouteResultCacheNode *node = self.nodes[key];
+    
+    if (node != nil) {
+        [self _unlinkNode:node];
+    } else {
+        node = [[JLRRouteResultCacheNode alloc] init];
+        node.key = key;
+        self.nodes[node.key] = node;
+        
+        if (self.nodes.count > self.capacity) {
+            [self _removeNode:self.tail];
+        }
+    }
+    
+    node.object = object;
+    [self _insertNodeAtHead:node];
+    
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)removeAllObjects
+{
+    pthread_mutex_lock(&_lock);
+    [self.nodes removeAllObjects];
+    self.head = nil;
+    self.tail = nil;
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Private
+
+- (void)_insertNodeAtHead:(JLRRouteResultCacheNode *)node
+{
+    node.next = self.head;
+    node.previous = nil;
+    self.head.previous = node;
+    self.head = node;
+    
+    if (self.tail == nil) {
+        self.tail = node;
+    }
+}
+
+- (void)_unlinkNode:(JLRRouteResultCacheNode *)node
+{
+    JLRRouteResultCacheNode *next = node.next;
+    JLRRouteResultCacheNode *previous = node.previous;
+    
+    if (previous != nil) {
+        previous.next = next;
+    } else {
+        self.head = next;
+    }
+    
+    if (next != nil) {
+        next.previous = previous;
+    } else {
+        self.tail = previous;
+    }
+    
+    node.next = nil;
+    node.previous = nil;
+}
+
+- (void)_removeNode:(JLRRouteResultCacheNode *)node
+{
+    [self _unlinkNode:node];
+    [self.nodes removeObjectForKey:node.key];
+}
+
+@end
@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class JLRRouteDefinition;
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRRouteTable is the serializable form of a scheme's compiled routes, in routing order.
+ 
+ Each route is recorded with its pattern, its priority, the pattern it was registered with, which is what handlers are bound by
+ when the table is loaded again, and its compiled segments. Loading a table builds route definitions straight from those segments,
+ so no pattern is split, compiled or sorted again. The binary form starts with a route set hash of the patterns, registered patterns
+ and priorities, which identifies the route set the table was built from, and a hash of the compiled segments, so that a stale or
+ corrupted table is rejected before anything is registered.
+ */
+
+@interface JLRRouteTable : NSObject
+
+/// The scheme the routes were registered in.
+@property (nonatomic, copy, readonly) NSString *scheme;
+
+/// The route patterns, in routing order.
+@property (nonatomic, copy, readonly) NSArray <NSString *> *patterns;
+
+/// The pattern each route was registered with, which is the route pattern itself unless it was expanded from optional groups.
+@property (nonatomic, copy, readonly) NSArray <NSString *> *registeredPatterns;
+
+/// The priority of each route.
+@property (nonatomic, copy, readonly) NSArray <NSNumber *> *priorities;
+
+/// A hash of the scheme and of every route's pattern, registered pattern and priority, in order.
+@property (nonatomic, assign, readonly) uint64_t routeSetHash;
+
+
+/**
+ Creates a table from routes that are already in routing order.
+ 
+ @param scheme The scheme the routes were registered in.
+ @param routes The routes, which must all be instances of JLRRouteDefinition itself rather than of a subclass.
+ @param registeredPatterns The pattern each route was registered with.
+ 
+ @returns The newly initialized table.
+ */
+- (instancetype)initWithScheme:(NSString *)scheme routes:(NSArray <JLRRouteDefinition *> *)routes registeredPatterns:(NSArray <NSString *> *)registeredPatterns NS_DESIGNATED_INITIALIZER;
+
+/**
+ Reads a table from its binary form. The data may be memory-mapped, nothing is kept pointing into it.
+ 
+ @param data The binary form of a table, as returned by -data.
+ @param error Set to a JLRoutesErrorInvalidRouteTable error if the data isn't a valid table.
+ 
+ @returns The newly initialized table, or nil if the data isn't a valid table.
+ */
+- (nullable instancetype)initWithData:(NSData *)data error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, use initWithScheme:routes:registeredPatterns: or initWithData:error: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, use initWithScheme:routes:registeredPatterns: or initWithData:error: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+/// The binary form of the table. Each distinct string is stored once, so the many routes expanded from one pattern stay compact.
+- (NSData *)data;
+
+/**
+ Creates the route definition for one of the table's routes from its compiled segments, without parsing its pattern.
+ 
+ Variable constraints are compiled once per table however many routes share them, and a constraint that doesn't compile leaves
+ the route matching nothing, just like registering its pattern would.
+ 
+ @param index The index of the route, in routing order.
+ @param scheme The scheme of the route, shared as is rather than interned for each route.
+ @param handlerBlock The handler block to call when the route matches.
+ 
+ @returns The newly initialized route definition.
+ */
+- (JLRRouteDefinition *)routeDefinitionAtIndex:(NSUInteger)index scheme:(nullable NSString *)scheme handlerBlock:(nullable BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
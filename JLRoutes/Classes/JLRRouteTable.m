@@ -0,0 +1,543 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRouteTable.h"
+#import "JLRoutes.h"
+#import "JLRRouteDefinition.h"
+#import "JLRLogging.h"
+
+
+/*
+ The binary form is little-endian throughout:
+ 
+ header         'JLRT', version (u32), route set hash (u64), segments hash (u64), scheme string (u32), route count (u32),
+                segment count (u32), string count (u32), string bytes length (u32)
+ strings        string count * (offset into the string bytes (u32), length (u32))
+ routes         route count * (pattern string (u32), registered pattern string (u32), priority (u64), first segment (u32),
+                segment count (u32), wildcard index (u32), minimum path component count (u32), maximum path component count (u32),
+                flags (u32))
+ segments       segment count * (type (u32), pattern component string (u32), value string (u32), constraint string (u32))
+ string bytes   the UTF-8 bytes of every string, back to back
+ 
+ The segments hash covers the route and segment records exactly as they are stored. A missing string, wildcard index or
+ maximum path component count is stored as JLRRouteTableNone.
+ */
+
+static const uint32_t JLRRouteTableMagic = (uint32_t)'J' | ((uint32_t)'L' << 8) | ((uint32_t)'R' << 16) | ((uint32_t)'T' << 24);
+static const uint32_t JLRRouteTableVersion = 2;
+static const NSUInteger JLRRouteTableHeaderLength = 44;
+static const NSUInteger JLRRouteTableStringRecordLength = 8;
+static const NSUInteger JLRRouteTableRouteRecordLength = 40;
+static const NSUInteger JLRRouteTableSegmentRecordLength = 16;
+static const uint32_t JLRRouteTableNone = UINT32_MAX;
+
+// set for a route with a variable constraint that didn't compile when the route was registered, which never matches
+static const uint32_t JLRRouteTableRouteFlagInvalidConstraint = 1;
+
+// a route record, with its strings as indexes into the table's strings
+typedef struct {
+    uint32_t pattern;
+    uint32_t registeredPattern;
+    uint64_t priority;
+    uint32_t firstSegment;
+    uint32_t segmentCount;
+    uint32_t wildcardIndex;
+    uint32_t minimumPathComponentCount;
+    uint32_t maximumPathComponentCount;
+    uint32_t flags;
+} JLRRouteTableRoute;
+
+// a segment record, with its strings as indexes into the table's strings
+typedef struct {
+    uint32_t type;
+    uint32_t component;
+    uint32_t value;
+    uint32_t constraint;
+} JLRRouteTableSegment;
+
+static void JLRAppendUInt32(NSMutableData *data, uint32_t value)
+{
+    uint32_t littleEndianValue = CFSwapInt32HostToLittle(value);
+    [data appendBytes:&littleEndianValue length:sizeof(littleEndianValue)];
+}
+
+static void JLRAppendUInt64(NSMutableData *data, uint64_t value)
+{
+    uint64_t littleEndianValue = CFSwapInt64HostToLittle(value);
+    [data appendBytes:&littleEndianValue length:sizeof(littleEndianValue)];
+}
+
+static uint32_t JLRReadUInt32(const uint8_t *bytes, NSUInteger offset)
+{
+    uint32_t value = 0;
+    memcpy(&value, bytes + offset, sizeof(value));
+    return CFSwapInt32LittleToHost(value);
+}
+
+static uint64_t JLRReadUInt64(const uint8_t *bytes, NSUInteger offset)
+{
+    uint64_t value = 0;
+    memcpy(&value, bytes + offset, sizeof(value));
+    return CFSwapInt64LittleToHost(value);
+}
+
+static uint64_t JLRHashAppendBytes(uint64_t hash, const void *bytes, NSUInteger length)
+{
+    // 64-bit FNV-1a, so that a hash computed on one architecture matches the others
+    const uint8_t *byte = bytes;
+    for (NSUInteger index = 0; index < length; index++) {
+        hash ^= byte[index];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t JLRHashAppendString(uint64_t hash, NSString *string)
+{
+    const char *bytes = [string UTF8String];
+    // the terminating NUL keeps "ab" + "c" from hashing like "a" + "bc"
+    return JLRHashAppendBytes(hash, bytes, strlen(bytes) + 1);
+}
+
+static NSError *JLRInvalidRouteTableError(NSString *reason)
+{
+    return [NSError errorWithDomain:JLRoutesErrorDomain code:JLRoutesErrorInvalidRouteTable userInfo:@{NSLocalizedDescriptionKey: @"Invalid compiled route table.", NSLocalizedFailureReasonErrorKey: reason}];
+}
+
+static BOOL JLRIsValidStringIndex(uint32_t stringIndex, NSUInteger stringCount, BOOL allowsNone)
+{
+    return stringIndex < stringCount || (allowsNone && stringIndex == JLRRouteTableNone);
+}
+
+
+@interface JLRRouteDefinition (JLRRouteTable)
+
+// creates a route from segments that are already compiled, implemented by JLRRouteDefinition itself
+- (instancetype)initWithScheme:(NSString *)scheme pattern:(NSString *)pattern priority:(NSUInteger)priority handlerBlock:(BOOL (^)(NSDictionary *parameters))handlerBlock patternComponents:(NSArray <NSString *> *)patternComponents segments:(const JLRRouteSegment *)segments wildcardIndex:(NSUInteger)wildcardIndex minimumPathComponentCount:(NSUInteger)minimumPathComponentCount maximumPathComponentCount:(NSUInteger)maximumPathComponentCount hasInvalidConstraint:(BOOL)hasInvalidConstraint;
+
+@end
+
+
+@interface JLRRouteTable () {
+    JLRRouteTableRoute *_routeRecords;
+    JLRRouteTableSegment *_segmentRecords;
+    NSUInteger _segmentCount;
+    uint32_t _schemeString;
+    
+    // reused for every route built by routeDefinitionAtIndex:handlerBlock:
+    JLRRouteSegment *_scratchSegments;
+    __unsafe_unretained NSString **_scratchComponents;
+    NSUInteger _scratchCapacity;
+}
+
+@property (nonatomic, copy) NSString *scheme;
+@property (nonatomic, copy) NSArray <NSString *> *patterns;
+@property (nonatomic, copy) NSArray <NSString *> *registeredPatterns;
+@property (nonatomic, copy) NSArray <NSNumber *> *priorities;
+@property (nonatomic, assign) uint64_t routeSetHash;
+
+// every string the records refer to, each stored once
+@property (nonatomic, copy) NSArray <NSString *> *strings;
+
+// constraints compiled so far, by constraint string. NSNull for one that doesn't compile.
+@property (nonatomic, strong) NSMutableDictionary <NSNumber *, id> *constraintsByString;
+
+@end
+
+
+@implementation JLRRouteTable
+
+- (instancetype)initWithScheme:(NSString *)scheme routes:(NSArray <JLRRouteDefinition *> *)routes registeredPatterns:(NSArray <NSString *> *)registeredPatterns
+{
+    NSParameterAssert(routes.count == registeredPatterns.count);
+    
+    if ((self = [super init])) {
+        NSMutableArray <NSString *> *strings = [NSMutableArray array];
+        NSMutableDictionary <NSString *, NSNumber *> *stringIndexes = [NSMutableDictionary dictionary];
+        uint32_t (^indexOfString)(NSString *) = ^uint32_t (NSString *string) {
+            if (string == nil) {
+                return JLRRouteTableNone;
+            }
+            
+            NSNumber *stringIndex = stringIndexes[string];
+            if (stringIndex == nil) {
+                stringIndex = @(strings.count);
+                stringIndexes[string] = stringIndex;
+                [strings addObject:string];
+            }
+            return [stringIndex unsignedIntValue];
+        };
+        
+        NSUInteger routeCount = routes.count;
+        NSUInteger segmentCount = 0;
+        for (JLRRouteDefinition *route in routes) {
+            segmentCount += route.segmentCount;
+        }
+        
+        _routeRecords = calloc(MAX(routeCount, (NSUInteger)1), sizeof(JLRRouteTableRoute));
+        _segmentRecords = calloc(MAX(segmentCount, (NSUInteger)1), sizeof(JLRRouteTableSegment));
+        _segmentCount = segmentCount;
+        _schemeString = indexOfString(scheme);
+        
+        NSMutableArray <NSString *> *patterns = [NSMutableArray arrayWithCapacity:routeCount];
+        NSMutableArray <NSNumber *> *priorities = [NSMutableArray arrayWithCapacity:routeCount];
+        NSUInteger segmentIndex = 0;
+        
+        for (NSUInteger index = 0; index < routeCount; index++) {
+            JLRRouteDefinition *route = routes[index];
+            JLRRouteTableRoute *routeRecord = &_routeRecords[index];
+            
+            routeRecord->pattern = indexOfString(route.pattern);
+            routeRecord->registeredPattern = indexOfString(registeredPatterns[index]);
+            routeRecord->priority = route.priority;
+            routeRecord->firstSegment = (uint32_t)segmentIndex;
+            routeRecord->segmentCount = (uint32_t)route.segmentCount;
+            routeRecord->wildcardIndex = JLRRouteTableNone;
+            routeRecord->minimumPathComponentCount = (uint32_t)route.minimumPathComponentCount;
+            routeRecord->maximumPathComponentCount = route.maximumPathComponentCount == NSUIntegerMax ? JLRRouteTableNone : (uint32_t)route.maximumPathComponentCount;
+            
+            for (NSUInteger routeSegmentIndex = 0; routeSegmentIndex < route.segmentCount; routeSegmentIndex++) {
+                JLRRouteSegment segment = route.segments[routeSegmentIndex];
+                NSString *component = route.patternComponents[routeSegmentIndex];
+                JLRRouteTableSegment *segmentRecord = &_segmentRecords[segmentIndex++];
+                
+                segmentRecord->type = (uint32_t)segment.type;
+                segmentRecord->component = indexOfString(component);
+                segmentRecord->value = indexOfString(segment.value);
+                segmentRecord->constraint = indexOfString(segment.constraint.pattern);
+                
+                if (segment.type == JLRRouteSegmentTypeWildcard && routeRecord->wildcardIndex == JLRRouteTableNone) {
+                    routeRecord->wildcardIndex = (uint32_t)routeSegmentIndex;
+                }
+                
+                // a constrained variable without a constraint is one whose constraint didn't compile
+                if (segment.type == JLRRouteSegmentTypeVariable && segment.constraint == nil && [component rangeOfString:@"<"].location != NSNotFound && [component hasSuffix:@">"]) {
+                    routeRecord->flags |= JLRRouteTableRouteFlagInvalidConstraint;
+                }
+            }
+            
+            [patterns addObject:route.pattern];
+            [priorities addObject:@(route.priority)];
+        }
+        
+        self.scheme = scheme;
+        self.patterns = patterns;
+        self.registeredPatterns = registeredPatterns;
+        self.priorities = priorities;
+        self.strings = strings;
+        self.routeSetHash = [self _computedRouteSetHash];
+    }
+    return self;
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+    if ((self = [super init])) {
+        NSString *failureReason = [self _readData:data];
+        if (failureReason != nil) {
+            if (error != NULL) {
+                *error = JLRInvalidRouteTableError(failureReason);
+            }
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_routeRecords);
+    free(_segmentRecords);
+    free(_scratchSegments);
+    free(_scratchComponents);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - %@ (%@ routes, route set hash: %016llx)", NSStringFromClass([self class]), self, self.scheme, @(self.patterns.count), self.routeSetHash];
+}
+
+- (NSData *)data
+{
+    NSUInteger routeCount = self.patterns.count;
+    NSMutableData *records = [NSMutableData dataWithCapacity:routeCount * JLRRouteTableRouteRecordLength + _segmentCount * JLRRouteTableSegmentRecordLength];
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        JLRRouteTableRoute routeRecord = _routeRecords[index];
+        JLRAppendUInt32(records, routeRecord.pattern);
+        JLRAppendUInt32(records, routeRecord.registeredPattern);
+        JLRAppendUInt64(records, routeRecord.priority);
+        JLRAppendUInt32(records, routeRecord.firstSegment);
+        JLRAppendUInt32(records, routeRecord.segmentCount);
+        JLRAppendUInt32(records, routeRecord.wildcardIndex);
+        JLRAppendUInt32(records, routeRecord.minimumPathComponentCount);
+        JLRAppendUInt32(records, routeRecord.maximumPathComponentCount);
+        JLRAppendUInt32(records, routeRecord.flags);
+    }
+    
+    for (NSUInteger index = 0; index < _segmentCount; index++) {
+        JLRRouteTableSegment segmentRecord = _segmentRecords[index];
+        JLRAppendUInt32(records, segmentRecord.type);
+        JLRAppendUInt32(records, segmentRecord.component);
+        JLRAppendUInt32(records, segmentRecord.value);
+        JLRAppendUInt32(records, segmentRecord.constraint);
+    }
+    
+    NSArray <NSString *> *strings = self.strings;
+    NSMutableData *stringRecords = [NSMutableData dataWithCapacity:strings.count * JLRRouteTableStringRecordLength];
+    NSMutableData *stringBytes = [NSMutableData data];
+    
+    for (NSString *string in strings) {
+        const char *bytes = [string UTF8String];
+        NSUInteger length = strlen(bytes);
+        JLRAppendUInt32(stringRecords, (uint32_t)stringBytes.length);
+        JLRAppendUInt32(stringRecords, (uint32_t)length);
+        [stringBytes appendBytes:bytes length:length];
+    }
+    
+    NSMutableData *data = [NSMutableData dataWithCapacity:JLRRouteTableHeaderLength + stringRecords.length + records.length + stringBytes.length];
+    JLRAppendUInt32(data, JLRRouteTableMagic);
+    JLRAppendUInt32(data, JLRRouteTableVersion);
+    JLRAppendUInt64(data, self.routeSetHash);
+    JLRAppendUInt64(data, JLRHashAppendBytes(14695981039346656037ULL, records.bytes, records.length));
+    JLRAppendUInt32(data, _schemeString);
+    JLRAppendUInt32(data, (uint32_t)routeCount);
+    JLRAppendUInt32(data, (uint32_t)_segmentCount);
+    JLRAppendUInt32(data, (uint32_t)strings.count);
+    JLRAppendUInt32(data, (uint32_t)stringBytes.length);
+    [data appendData:stringRecords];
+    [data appendData:records];
+    [data appendData:stringBytes];
+    
+    return [data copy];
+}
+
+- (JLRRouteDefinition *)routeDefinitionAtIndex:(NSUInteger)index scheme:(NSString *)scheme handlerBlock:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock
+{
+    JLRRouteTableRoute routeRecord = _routeRecords[index];
+    NSArray <NSString *> *strings = self.strings;
+    NSUInteger segmentCount = routeRecord.segmentCount;
+    BOOL hasInvalidConstraint = (routeRecord.flags & JLRRouteTableRouteFlagInvalidConstraint) != 0;
+    
+    if (segmentCount > _scratchCapacity) {
+        _scratchCapacity = MAX(segmentCount, _scratchCapacity * 2);
+        _scratchSegments = reallocf(_scratchSegments, _scratchCapacity * sizeof(JLRRouteSegment));
+        _scratchComponents = (__unsafe_unretained NSString **)reallocf(_scratchComponents, _scratchCapacity * sizeof(NSString *));
+    }
+    
+    // the segments point at the table's strings and constraints, which the route holds on to through its pattern
+    // components, variable names and constraints once it's created
+    for (NSUInteger segmentIndex = 0; segmentIndex < segmentCount; segmentIndex++) {
+        JLRRouteTableSegment segmentRecord = _segmentRecords[routeRecord.firstSegment + segmentIndex];
+        JLRRouteSegment *segment = &_scratchSegments[segmentIndex];
+        
+        segment->type = (JLRRouteSegmentType)segmentRecord.type;
+        segment->value = segmentRecord.value != JLRRouteTableNone ? strings[segmentRecord.value] : nil;
+        segment->constraint = segmentRecord.constraint != JLRRouteTableNone ? [self _constraintForString:segmentRecord.constraint] : nil;
+        _scratchComponents[segmentIndex] = strings[segmentRecord.component];
+        
+        if (segmentRecord.constraint != JLRRouteTableNone && segment->constraint == nil) {
+            hasInvalidConstraint = YES;
+        }
+    }
+    
+    NSArray <NSString *> *patternComponents = [NSArray arrayWithObjects:_scratchComponents count:segmentCount];
+    NSUInteger wildcardIndex = routeRecord.wildcardIndex != JLRRouteTableNone ? routeRecord.wildcardIndex : NSNotFound;
+    NSUInteger maximumPathComponentCount = routeRecord.maximumPathComponentCount != JLRRouteTableNone ? routeRecord.maximumPathComponentCount : NSUIntegerMax;
+    
+    return [[JLRRouteDefinition alloc] initWithScheme:scheme pattern:strings[routeRecord.pattern] priority:(NSUInteger)routeRecord.priority handlerBlock:handlerBlock patternComponents:patternComponents segments:_scratchSegments wildcardIndex:wildcardIndex minimumPathComponentCount:routeRecord.minimumPathComponentCount maximumPathComponentCount:maximumPathComponentCount hasInvalidConstraint:hasInvalidConstraint];
+}
+
+
+#pragma mark - Private
+
+- (uint64_t)_computedRouteSetHash
+{
+    uint64_t hash = JLRHashAppendString(14695981039346656037ULL, self.scheme);
+    
+    for (NSUInteger index = 0; index < self.patterns.count; index++) {
+        hash = JLRHashAppendString(hash, self.patterns[index]);
+        hash = JLRHashAppendString(hash, self.registeredPatterns[index]);
+        
+        uint64_t priority = CFSwapInt64HostToLittle([self.priorities[index] unsignedLongLongValue]);
+        hash = JLRHashAppendBytes(hash, &priority, sizeof(priority));
+    }
+    
+    return hash;
+}
+
+- (JLRRouteVariableConstraint *)_constraintForString:(uint32_t)constraintString
+{
+    // compiled once per table, however many of its routes share the constraint
+    if (self.constraintsByString == nil) {
+        self.constraintsByString = [NSMutableDictionary dictionary];
+    }
+    
+    id constraint = self.constraintsByString[@(constraintString)];
+    
+    if (constraint == nil) {
+        NSError *constraintError = nil;
+        constraint = [[JLRRouteVariableConstraint alloc] initWithPattern:self.strings[constraintString] error:&constraintError];
+        if (constraint == nil) {
+            JLRLog(JLRLogLevelError, @"Invalid variable constraint in compiled route table, routes using it will never match: %@ (%@)", self.strings[constraintString], constraintError.localizedDescription);
+        }
+        self.constraintsByString[@(constraintString)] = constraint ?: [NSNull null];
+    }
+    
+    return constraint != [NSNull null] ? constraint : nil;
+}
+
+- (nullable NSString *)_readData:(NSData *)data
+{
+    // returns why the data isn't a valid table, or nil once the table has been read from it
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    
+    if (length < JLRRouteTableHeaderLength || JLRReadUInt32(bytes, 0) != JLRRouteTableMagic) {
+        return @"The data is not a compiled route table.";
+    }
+    
+    if (JLRReadUInt32(bytes, 4) != JLRRouteTableVersion) {
+        return [NSString stringWithFormat:@"The compiled route table version %@ is not supported.", @(JLRReadUInt32(bytes, 4))];
+    }
+    
+    uint64_t routeSetHash = JLRReadUInt64(bytes, 8);
+    uint64_t segmentsHash = JLRReadUInt64(bytes, 16);
+    uint32_t schemeString = JLRReadUInt32(bytes, 24);
+    uint32_t routeCount = JLRReadUInt32(bytes, 28);
+    uint32_t segmentCount = JLRReadUInt32(bytes, 32);
+    uint32_t stringCount = JLRReadUInt32(bytes, 36);
+    uint32_t stringBytesLength = JLRReadUInt32(bytes, 40);
+    
+    uint64_t expectedLength = (uint64_t)JLRRouteTableHeaderLength + (uint64_t)stringCount * JLRRouteTableStringRecordLength + (uint64_t)routeCount * JLRRouteTableRouteRecordLength + (uint64_t)segmentCount * JLRRouteTableSegmentRecordLength + stringBytesLength;
+    if (expectedLength != length) {
+        return @"The compiled route table is truncated.";
+    }
+    
+    NSUInteger stringRecordsOffset = JLRRouteTableHeaderLength;
+    NSUInteger routeRecordsOffset = stringRecordsOffset + stringCount * JLRRouteTableStringRecordLength;
+    NSUInteger segmentRecordsOffset = routeRecordsOffset + routeCount * JLRRouteTableRouteRecordLength;
+    NSUInteger stringBytesOffset = segmentRecordsOffset + segmentCount * JLRRouteTableSegmentRecordLength;
+    
+    if (JLRHashAppendBytes(14695981039346656037ULL, bytes + routeRecordsOffset, stringBytesOffset - routeRecordsOffset) != segmentsHash) {
+        return @"The compiled segments of the compiled route table don't match their hash.";
+    }
+    
+    NSMutableArray <NSString *> *strings = [NSMutableArray arrayWithCapacity:stringCount];
+    for (NSUInteger index = 0; index < stringCount; index++) {
+        uint32_t stringOffset = JLRReadUInt32(bytes, stringRecordsOffset + index * JLRRouteTableStringRecordLength);
+        uint32_t stringLength = JLRReadUInt32(bytes, stringRecordsOffset + index * JLRRouteTableStringRecordLength + 4);
+        
+        if ((uint64_t)stringOffset + stringLength > stringBytesLength) {
+            return @"A string in the compiled route table is out of bounds.";
+        }
+        
+        // copied out, since the data is likely to be memory-mapped
+        NSString *string = [[NSString alloc] initWithBytes:bytes + stringBytesOffset + stringOffset length:stringLength encoding:NSUTF8StringEncoding];
+        if (string == nil) {
+            return @"A string in the compiled route table is not valid UTF-8.";
+        }
+        [strings addObject:string];
+    }
+    
+    if (schemeString >= stringCount) {
+        return @"The scheme of the compiled route table is out of bounds.";
+    }
+    
+    _segmentRecords = calloc(MAX(segmentCount, 1U), sizeof(JLRRouteTableSegment));
+    _segmentCount = segmentCount;
+    
+    for (NSUInteger index = 0; index < segmentCount; index++) {
+        NSUInteger recordOffset = segmentRecordsOffset + index * JLRRouteTableSegmentRecordLength;
+        JLRRouteTableSegment *segmentRecord = &_segmentRecords[index];
+        
+        segmentRecord->type = JLRReadUInt32(bytes, recordOffset);
+        segmentRecord->component = JLRReadUInt32(bytes, recordOffset + 4);
+        segmentRecord->value = JLRReadUInt32(bytes, recordOffset + 8);
+        segmentRecord->constraint = JLRReadUInt32(bytes, recordOffset + 12);
+        
+        // literals and variables have a value, only variables have a constraint
+        BOOL isWildcard = (segmentRecord->type == JLRRouteSegmentTypeWildcard);
+        BOOL isValid = segmentRecord->type <= JLRRouteSegmentTypeWildcard && JLRIsValidStringIndex(segmentRecord->component, stringCount, NO);
+        isValid = isValid && (isWildcard ? segmentRecord->value == JLRRouteTableNone : JLRIsValidStringIndex(segmentRecord->value, stringCount, NO));
+        isValid = isValid && (segmentRecord->type == JLRRouteSegmentTypeVariable ? JLRIsValidStringIndex(segmentRecord->constraint, stringCount, YES) : segmentRecord->constraint == JLRRouteTableNone);
+        
+        if (!isValid) {
+            return @"A segment in the compiled route table is invalid.";
+        }
+    }
+    
+    _routeRecords = calloc(MAX(routeCount, 1U), sizeof(JLRRouteTableRoute));
+    
+    NSMutableArray <NSString *> *patterns = [NSMutableArray arrayWithCapacity:routeCount];
+    NSMutableArray <NSString *> *registeredPatterns = [NSMutableArray arrayWithCapacity:routeCount];
+    NSMutableArray <NSNumber *> *priorities = [NSMutableArray arrayWithCapacity:routeCount];
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        NSUInteger recordOffset = routeRecordsOffset + index * JLRRouteTableRouteRecordLength;
+        JLRRouteTableRoute *routeRecord = &_routeRecords[index];
+        
+        routeRecord->pattern = JLRReadUInt32(bytes, recordOffset);
+        routeRecord->registeredPattern = JLRReadUInt32(bytes, recordOffset + 4);
+        routeRecord->priority = JLRReadUInt64(bytes, recordOffset + 8);
+        routeRecord->firstSegment = JLRReadUInt32(bytes, recordOffset + 16);
+        routeRecord->segmentCount = JLRReadUInt32(bytes, recordOffset + 20);
+        routeRecord->wildcardIndex = JLRReadUInt32(bytes, recordOffset + 24);
+        routeRecord->minimumPathComponentCount = JLRReadUInt32(bytes, recordOffset + 28);
+        routeRecord->maximumPathComponentCount = JLRReadUInt32(bytes, recordOffset + 32);
+        routeRecord->flags = JLRReadUInt32(bytes, recordOffset + 36);
+        
+        if (![self _isValidRouteRecord:routeRecord stringCount:stringCount] || strings[routeRecord->pattern].length == 0) {
+            return @"A route in the compiled route table is invalid.";
+        }
+        
+        [patterns addObject:strings[routeRecord->pattern]];
+        [registeredPatterns addObject:strings[routeRecord->registeredPattern]];
+        [priorities addObject:@(routeRecord->priority)];
+    }
+    
+    _schemeString = schemeString;
+    self.scheme = strings[schemeString];
+    self.patterns = patterns;
+    self.registeredPatterns = registeredPatterns;
+    self.priorities = priorities;
+    self.strings = strings;
+    self.routeSetHash = [self _computedRouteSetHash];
+    
+    if (self.routeSetHash != routeSetHash) {
+        return @"The contents of the compiled route table don't match its route set hash.";
+    }
+    
+    return nil;
+}
+
+- (BOOL)_isValidRouteRecord:(const JLRRouteTableRoute *)routeRecord stringCount:(NSUInteger)stringCount
+{
+    if (!JLRIsValidStringIndex(routeRecord->pattern, stringCount, NO) || !JLRIsValidStringIndex(routeRecord->registeredPattern, stringCount, NO)) {
+        return NO;
+    }
+    
+    if (routeRecord->segmentCount == 0 || (uint64_t)routeRecord->firstSegment + routeRecord->segmentCount > _segmentCount || (routeRecord->flags & ~JLRRouteTableRouteFlagInvalidConstraint) != 0) {
+        return NO;
+    }
+    
+    // the counts follow from where the first wildcard is, which has to be a wildcard segment
+    uint32_t segmentCount = routeRecord->segmentCount;
+    
+    if (routeRecord->wildcardIndex == JLRRouteTableNone) {
+        return routeRecord->minimumPathComponentCount == segmentCount && routeRecord->maximumPathComponentCount == segmentCount;
+    }
+    
+    return routeRecord->wildcardIndex < segmentCount && _segmentRecords[routeRecord->firstSegment + routeRecord->wildcardIndex].type == JLRRouteSegmentTypeWildcard && routeRecord->minimumPathComponentCount == segmentCount - 1 && routeRecord->maximumPathComponentCount == JLRRouteTableNone;
+}
+
+@end
@@ -0,0 +1,53 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+@class JLRRouteDefinition;
+
+
+/**
+ JLRRouteTrie is a compiled index of route definitions keyed on their pattern path components.
+ 
+ Each node has static children keyed by literal component, a single child shared by all ':variable' components,
+ and a list of the routes whose pattern has a '*' wildcard at that depth. Looking up a URL walks the tree once per
+ path component, so the cost depends on the depth of the path rather than on the number of registered routes.
+ 
+ The trie only narrows down the set of routes that could match. Candidates are still confirmed by calling
+ -routeResponseForRequest:decodePlusSymbols: on each of them, so matching behavior is unchanged. Route definition
+ subclasses that override matching are always returned as candidates.
+ 
+ Copies share their nodes with the trie they were copied from, and a node is only copied once either trie changes it.
+ */
+
+@interface JLRRouteTrie : NSObject <NSCopying>
+
+/// Inserts a route. Routes are ordered by priority and then by insertion order, the same way JLRoutes orders them.
+- (void)addRoute:(JLRRouteDefinition *)route;
+
+/// Removes a previously inserted route.
+- (void)removeRoute:(JLRRouteDefinition *)route;
+
+/// Removes all routes.
+- (void)removeAllRoutes;
+
+/// Returns the routes that could match the given path components, in priority order. Each node keeps its routes in that
+/// order, so the lists of the nodes a lookup reaches are merged rather than sorted.
+- (NSArray <JLRRouteDefinition *> *)candidateRoutesForPathComponents:(NSArray <NSString *> *)pathComponents;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,476 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRouteTrie.h"
+#import "JLRRouteDefinition.h"
+#import <stdatomic.h>
+
+
+// the generation of the nodes a trie may change in place. a copy and the trie it was copied from each move on to a new one,
+// so the nodes they share are only ever changed by copying them first.
+static _Atomic(NSUInteger) JLRRouteTrieLastGeneration = 0;
+
+static NSUInteger JLRRouteTrieNewGeneration(void)
+{
+    return atomic_fetch_add_explicit(&JLRRouteTrieLastGeneration, 1, memory_order_relaxed) + 1;
+}
+
+
+// where a route goes among the routes of every list, by priority and then by the order the routes were added in
+typedef struct {
+    NSUInteger priority;
+    NSUInteger sequenceNumber;
+} JLRRouteTrieOrder;
+
+static inline BOOL JLRRouteTrieOrderPrecedes(JLRRouteTrieOrder order1, JLRRouteTrieOrder order2)
+{
+    if (order1.priority != order2.priority) {
+        return order1.priority > order2.priority;
+    }
+    return order1.sequenceNumber < order2.sequenceNumber;
+}
+
+
+@interface JLRRouteTrieList : NSObject {
+    JLRRouteTrieOrder *_orders;
+}
+
+// immutable, so lists are shared between nodes and their copies, and a lookup that only finds one returns its routes as they are
+@property (nonatomic, copy, readonly) NSArray <JLRRouteDefinition *> *routes;
+
++ (JLRRouteTrieList *)emptyList;
+- (JLRRouteTrieOrder)orderAtIndex:(NSUInteger)index;
+- (JLRRouteTrieList *)listByAddingRoute:(JLRRouteDefinition *)route sequenceNumber:(NSUInteger)sequenceNumber;
+- (JLRRouteTrieList *)listByRemovingRoute:(JLRRouteDefinition *)route;
+
+@end
+
+
+@implementation JLRRouteTrieList
+
++ (JLRRouteTrieList *)emptyList
+{
+    static JLRRouteTrieList *emptyList = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        emptyList = [[JLRRouteTrieList alloc] initWithRoutes:@[] orders:NULL];
+    });
+    return emptyList;
+}
+
+- (instancetype)initWithRoutes:(NSArray <JLRRouteDefinition *> *)routes orders:(JLRRouteTrieOrder *)orders
+{
+    // takes over orders, which holds one order for each route
+    if ((self = [super init])) {
+        _routes = [routes copy];
+        _orders = orders;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_orders);
+}
+
+- (JLRRouteTrieOrder)orderAtIndex:(NSUInteger)index
+{
+    return _orders[index];
+}
+
+- (JLRRouteTrieList *)listByAddingRoute:(JLRRouteDefinition *)route sequenceNumber:(NSUInteger)sequenceNumber
+{
+    // the new route was added after every route already here, so it goes after all of those with at least its priority
+    NSUInteger count = self.routes.count;
+    JLRRouteTrieOrder order = {route.priority, sequenceNumber};
+    NSUInteger index = count;
+    
+    while (index > 0 && _orders[index - 1].priority < order.priority) {
+        index--;
+    }
+    
+    JLRRouteTrieOrder *orders = malloc((count + 1) * sizeof(JLRRouteTrieOrder));
+    if (index > 0) {
+        memcpy(orders, _orders, index * sizeof(JLRRouteTrieOrder));
+    }
+    orders[index] = order;
+    if (index < count) {
+        memcpy(orders + index + 1, _orders + index, (count - index) * sizeof(JLRRouteTrieOrder));
+    }
+    
+    NSMutableArray <JLRRouteDefinition *> *routes = [self.routes mutableCopy];
+    [routes insertObject:route atIndex:index];
+    
+    return [[JLRRouteTrieList alloc] initWithRoutes:routes orders:orders];
+}
+
+- (JLRRouteTrieList *)listByRemovingRoute:(JLRRouteDefinition *)route
+{
+    // the list itself if it doesn't have the route
+    NSUInteger index = [self.routes indexOfObjectIdenticalTo:route];
+    if (index == NSNotFound) {
+        return self;
+    }
+    
+    NSUInteger count = self.routes.count;
+    if (count == 1) {
+        return [JLRRouteTrieList emptyList];
+    }
+    
+    JLRRouteTrieOrder *orders = malloc((count - 1) * sizeof(JLRRouteTrieOrder));
+    memcpy(orders, _orders, index * sizeof(JLRRouteTrieOrder));
+    memcpy(orders + index, _orders + index + 1, (count - index - 1) * sizeof(JLRRouteTrieOrder));
+    
+    NSMutableArray <JLRRouteDefinition *> *routes = [self.routes mutableCopy];
+    [routes removeObjectAtIndex:index];
+    
+    return [[JLRRouteTrieList alloc] initWithRoutes:routes orders:orders];
+}
+
+@end
+
+
+#pragma mark -
+
+@interface JLRRouteTrieNode : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger generation;
+@property (nonatomic, strong) NSMutableDictionary <NSString *, JLRRouteTrieNode *> *staticChildren;
+@property (nonatomic, strong) JLRRouteTrieNode *variableChild;
+@property (nonatomic, strong) JLRRouteTrieList *wildcardRoutes;
+@property (nonatomic, strong) JLRRouteTrieList *terminalRoutes;
+
+- (instancetype)initWithGeneration:(NSUInteger)generation;
+- (BOOL)isEmpty;
+- (JLRRouteTrieNode *)copyForGeneration:(NSUInteger)generation;
+
+@end
+
+
+@implementation JLRRouteTrieNode
+
+- (instancetype)initWithGeneration:(NSUInteger)generation
+{
+    if ((self = [super init])) {
+        _generation = generation;
+        self.staticChildren = [NSMutableDictionary dictionary];
+        self.wildcardRoutes = [JLRRouteTrieList emptyList];
+        self.terminalRoutes = [JLRRouteTrieList emptyList];
+    }
+    return self;
+}
+
+- (BOOL)isEmpty
+{
+    return self.staticChildren.count == 0 && self.variableChild == nil && self.wildcardRoutes.routes.count == 0 && self.terminalRoutes.routes.count == 0;
+}
+
+- (JLRRouteTrieNode *)copyForGeneration:(NSUInteger)generation
+{
+    // only this node is copied, its children and lists are shared until they're changed too
+    JLRRouteTrieNode *copy = [[JLRRouteTrieNode alloc] initWithGeneration:generation];
+    
+    [copy.staticChildren addEntriesFromDictionary:self.staticChildren];
+    copy.variableChild = self.variableChild;
+    copy.wildcardRoutes = self.wildcardRoutes;
+    copy.terminalRoutes = self.terminalRoutes;
+    
+    return copy;
+}
+
+@end
+
+
+#pragma mark -
+
+// the lists a lookup finds candidates in, kept on the stack unless there are a lot of them
+#define JLRRouteTrieInlineListCapacity 16
+
+typedef struct {
+    __unsafe_unretained JLRRouteTrieList **lists;
+    NSUInteger count;
+    NSUInteger capacity;
+    __unsafe_unretained JLRRouteTrieList *inlineLists[JLRRouteTrieInlineListCapacity];
+} JLRRouteTrieListCollection;
+
+static void JLRRouteTrieCollectList(JLRRouteTrieListCollection *collection, JLRRouteTrieList *list)
+{
+    if (list.routes.count == 0) {
+        return;
+    }
+    
+    if (collection->count == collection->capacity) {
+        collection->capacity *= 2;
+        if (collection->lists == collection->inlineLists) {
+            collection->lists = (__unsafe_unretained JLRRouteTrieList **)malloc(collection->capacity * sizeof(JLRRouteTrieList *));
+            memcpy(collection->lists, collection->inlineLists, sizeof(collection->inlineLists));
+        } else {
+            collection->lists = (__unsafe_unretained JLRRouteTrieList **)realloc(collection->lists, collection->capacity * sizeof(JLRRouteTrieList *));
+        }
+    }
+    
+    collection->lists[collection->count++] = list;
+}
+
+static NSArray <JLRRouteDefinition *> *JLRRouteTrieMergeLists(const JLRRouteTrieListCollection *collection)
+{
+    // each list is already in order, so they're merged by repeatedly taking the first route left in any of them
+    if (collection->count == 0) {
+        return [JLRRouteTrieList emptyList].routes;
+    } else if (collection->count == 1) {
+        return collection->lists[0].routes;
+    }
+    
+    NSUInteger totalCount = 0;
+    for (NSUInteger listIndex = 0; listIndex < collection->count; listIndex++) {
+        totalCount += collection->lists[listIndex].routes.count;
+    }
+    
+    NSMutableArray <JLRRouteDefinition *> *candidates = [NSMutableArray arrayWithCapacity:totalCount];
+    NSUInteger *positions = calloc(collection->count, sizeof(NSUInteger));
+    
+    for (NSUInteger candidateIndex = 0; candidateIndex < totalCount; candidateIndex++) {
+        NSUInteger nextListIndex = NSNotFound;
+        JLRRouteTrieOrder nextOrder = {0, 0};
+        
+        for (NSUInteger listIndex = 0; listIndex < collection->count; listIndex++) {
+            JLRRouteTrieList *list = collection->lists[listIndex];
+            if (positions[listIndex] == list.routes.count) {
+                continue;
+            }
+            
+            JLRRouteTrieOrder order = [list orderAtIndex:positions[listIndex]];
+            if (nextListIndex == NSNotFound || JLRRouteTrieOrderPrecedes(order, nextOrder)) {
+                nextListIndex = listIndex;
+                nextOrder = order;
+            }
+        }
+        
+        [candidates addObject:collection->lists[nextListIndex].routes[positions[nextListIndex]++]];
+    }
+    
+    free(positions);
+    return candidates;
+}
+
+
+@interface JLRRouteTrie ()
+
+// nil while the trie doesn't hold any indexed routes
+@property (nonatomic, strong) JLRRouteTrieNode *rootNode;
+@property (nonatomic, strong) JLRRouteTrieList *unindexedRoutes;
+@property (nonatomic, assign) NSUInteger routeCount;
+@property (nonatomic, assign) NSUInteger nextSequenceNumber;
+@property (nonatomic, assign) NSUInteger generation;
+
+@end
+
+
+@implementation JLRRouteTrie
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        self.unindexedRoutes = [JLRRouteTrieList emptyList];
+        self.generation = JLRRouteTrieNewGeneration();
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - %@ routes", NSStringFromClass([self class]), self, @(self.routeCount)];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // the copy shares every node, and from now on neither trie changes a shared node without copying it first
+    JLRRouteTrie *copy = [[[self class] allocWithZone:zone] init];
+    
+    copy.rootNode = self.rootNode;
+    copy.unindexedRoutes = self.unindexedRoutes;
+    copy.routeCount = self.routeCount;
+    copy.nextSequenceNumber = self.nextSequenceNumber;
+    self.generation = JLRRouteTrieNewGeneration();
+    
+    return copy;
+}
+
+- (void)addRoute:(JLRRouteDefinition *)route
+{
+    NSUInteger sequenceNumber = self.nextSequenceNumber++;
+    self.routeCount++;
+    
+    if (![[route class] supportsSegmentIndexing]) {
+        self.unindexedRoutes = [self.unindexedRoutes listByAddingRoute:route sequenceNumber:sequenceNumber];
+        return;
+    }
+    
+    JLRRouteTrieNode *node = self.rootNode = [self _editableNode:self.rootNode];
+    
+    for (NSUInteger index = 0; index < route.segmentCount; index++) {
+        JLRRouteSegment segment = route.segments[index];
+        
+        if (segment.type == JLRRouteSegmentTypeWildcard) {
+            // segments after a wildcard line up with the end of the path instead of a depth, so the route lives at the
+            // wildcard's depth and checks them itself when it's tried
+            node.wildcardRoutes = [node.wildcardRoutes listByAddingRoute:route sequenceNumber:sequenceNumber];
+            return;
+        }
+        
+        node = [self _editableChildOfNode:node forSegment:segment];
+    }
+    
+    node.terminalRoutes = [node.terminalRoutes listByAddingRoute:route sequenceNumber:sequenceNumber];
+}
+
+- (void)removeRoute:(JLRRouteDefinition *)route
+{
+    BOOL didRemove = NO;
+    
+    if (![[route class] supportsSegmentIndexing]) {
+        JLRRouteTrieList *unindexedRoutes = [self.unindexedRoutes listByRemovingRoute:route];
+        didRemove = (unindexedRoutes != self.unindexedRoutes);
+        self.unindexedRoutes = unindexedRoutes;
+    } else if (self.rootNode != nil) {
+        self.rootNode = [self _nodeByRemovingRoute:route fromNode:self.rootNode segmentIndex:0 didRemove:&didRemove];
+    }
+    
+    if (didRemove) {
+        self.routeCount--;
+    }
+}
+
+- (void)removeAllRoutes
+{
+    self.rootNode = nil;
+    self.unindexedRoutes = [JLRRouteTrieList emptyList];
+    self.routeCount = 0;
+}
+
+- (NSArray <JLRRouteDefinition *> *)candidateRoutesForPathComponents:(NSArray <NSString *> *)pathComponents
+{
+    JLRRouteTrieListCollection collection;
+    collection.lists = collection.inlineLists;
+    collection.count = 0;
+    collection.capacity = JLRRouteTrieInlineListCapacity;
+    
+    JLRRouteTrieCollectList(&collection, self.unindexedRoutes);
+    [self _collectListsFromNode:self.rootNode pathComponents:pathComponents depth:0 collection:&collection];
+    
+    NSArray <JLRRouteDefinition *> *candidates = JLRRouteTrieMergeLists(&collection);
+    
+    if (collection.lists != collection.inlineLists) {
+        free(collection.lists);
+    }
+    
+    return candidates;
+}
+
+
+#pragma mark - Private
+
+- (JLRRouteTrieNode *)_editableNode:(JLRRouteTrieNode *)node
+{
+    // a node this trie can change in place, which is a copy of node if it's shared with another trie
+    if (node == nil) {
+        return [[JLRRouteTrieNode alloc] initWithGeneration:self.generation];
+    }
+    return node.generation == self.generation ? node : [node copyForGeneration:self.generation];
+}
+
+- (JLRRouteTrieNode *)_editableChildOfNode:(JLRRouteTrieNode *)node forSegment:(JLRRouteSegment)segment
+{
+    // node has to be editable already, it's updated to point at the child if that had to be created or copied
+    BOOL isVariable = (segment.type == JLRRouteSegmentTypeVariable);
+    JLRRouteTrieNode *child = isVariable ? node.variableChild : node.staticChildren[(NSString *)segment.value];
+    JLRRouteTrieNode *editableChild = [self _editableNode:child];
+    
+    if (editableChild != child) {
+        if (isVariable) {
+            node.variableChild = editableChild;
+        } else {
+            node.staticChildren[(NSString *)segment.value] = editableChild;
+        }
+    }
+    
+    return editableChild;
+}
+
+- (JLRRouteTrieNode *)_nodeByRemovingRoute:(JLRRouteDefinition *)route fromNode:(JLRRouteTrieNode *)node segmentIndex:(NSUInteger)segmentIndex didRemove:(BOOL *)didRemove
+{
+    // returns node itself if the route isn't under it, and nil for a node the removal left empty so that the branch is pruned
+    JLRRouteSegment segment = {0};
+    BOOL isTerminal = (segmentIndex == route.segmentCount);
+    
+    if (!isTerminal) {
+        segment = route.segments[segmentIndex];
+    }
+    
+    if (isTerminal || segment.type == JLRRouteSegmentTypeWildcard) {
+        JLRRouteTrieList *list = isTerminal ? node.terminalRoutes : node.wildcardRoutes;
+        JLRRouteTrieList *remainingList = [list listByRemovingRoute:route];
+        if (remainingList == list) {
+            return node;
+        }
+        
+        *didRemove = YES;
+        node = [self _editableNode:node];
+        if (isTerminal) {
+            node.terminalRoutes = remainingList;
+        } else {
+            node.wildcardRoutes = remainingList;
+        }
+        return [node isEmpty] ? nil : node;
+    }
+    
+    BOOL isVariable = (segment.type == JLRRouteSegmentTypeVariable);
+    JLRRouteTrieNode *child = isVariable ? node.variableChild : node.staticChildren[(NSString *)segment.value];
+    if (child == nil) {
+        return node;
+    }
+    
+    JLRRouteTrieNode *remainingChild = [self _nodeByRemovingRoute:route fromNode:child segmentIndex:segmentIndex + 1 didRemove:didRemove];
+    if (remainingChild == child) {
+        return node;
+    }
+    
+    node = [self _editableNode:node];
+    if (isVariable) {
+        node.variableChild = remainingChild;
+    } else if (remainingChild != nil) {
+        node.staticChildren[(NSString *)segment.value] = remainingChild;
+    } else {
+        [node.staticChildren removeObjectForKey:(NSString *)segment.value];
+    }
+    return [node isEmpty] ? nil : node;
+}
+
+- (void)_collectListsFromNode:(JLRRouteTrieNode *)node pathComponents:(NSArray <NSString *> *)pathComponents depth:(NSUInteger)depth collection:(JLRRouteTrieListCollection *)collection
+{
+    if (node == nil) {
+        return;
+    }
+    
+    // a wildcard at this depth matches whatever is left of the path, including nothing at all
+    JLRRouteTrieCollectList(collection, node.wildcardRoutes);
+    
+    if (depth == pathComponents.count) {
+        JLRRouteTrieCollectList(collection, node.terminalRoutes);
+        return;
+    }
+    
+    [self _collectListsFromNode:node.staticChildren[pathComponents[depth]] pathComponents:pathComponents depth:depth + 1 collection:collection];
+    [self _collectListsFromNode:node.variableChild pathComponents:pathComponents depth:depth + 1 collection:collection];
+}
+
+@end
@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/// The kinds of constraint a route variable can have.
+typedef NS_ENUM(NSUInteger, JLRRouteVariableConstraintType) {
+    /// ':id<int>' accepts a decimal integer that fits in a long long, optionally negative, and captures it as an NSNumber.
+    JLRRouteVariableConstraintTypeInteger,
+    /// ':id<uuid>' accepts a UUID string such as 'E621E1F8-C36C-495A-93FC-0C247A3E6E5F', in either case.
+    JLRRouteVariableConstraintTypeUUID,
+    /// ':slug<[a-z-]+>' accepts values that the regular expression matches in full.
+    JLRRouteVariableConstraintTypeRegularExpression,
+};
+
+
+/**
+ JLRRouteVariableConstraint is the compiled form of the '<...>' suffix of a route variable, which limits the path components the variable accepts.
+ 
+ Constraints are checked against the decoded variable value while matching, so a route whose variable rejects a URL path component
+ doesn't match it and routing moves on without calling its handler. Since patterns are split on '/' and optional groups use parentheses,
+ a regular expression constraint can't contain either.
+ */
+
+@interface JLRRouteVariableConstraint : NSObject
+
+/// The kind of constraint.
+@property (nonatomic, assign, readonly) JLRRouteVariableConstraintType type;
+
+/// The text between the angle brackets ('int', 'uuid' or the regular expression).
+@property (nonatomic, copy, readonly) NSString *pattern;
+
+
+///-------------------------------
+/// @name Creating Constraints
+///-------------------------------
+
+
+/**
+ Creates a constraint from the text between a variable's angle brackets.
+ 
+ @param pattern 'int', 'uuid', or a regular expression.
+ @param error Set to the reason the regular expression is invalid, if it is.
+ 
+ @returns The newly initialized constraint, or nil if pattern is an invalid regular expression.
+ */
+- (nullable instancetype)initWithPattern:(NSString *)pattern error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, please use initWithPattern:error: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, please use initWithPattern:error: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+
+///-------------------------------
+/// @name Checking Values
+///-------------------------------
+
+
+/// Returns YES if the variable accepts the decoded value. Integer and UUID constraints don't allocate.
+- (BOOL)acceptsValue:(NSString *)value;
+
+/// Returns the parameter a handler is passed for an accepted value: an NSNumber for integer constraints, value itself otherwise.
+- (id)parameterValueForValue:(NSString *)value;
+
+/// Returns the parameter a handler is passed for value if the variable accepts it, or nil if it doesn't, checking and parsing the value once.
+- (nullable id)parameterValueForAcceptedValue:(NSString *)value;
+
+/// Returns YES if this constraint accepts exactly the values another one accepts, judging by their patterns.
+- (BOOL)isEqualToConstraint:(JLRRouteVariableConstraint *)constraint;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,159 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRouteVariableConstraint.h"
+
+
+static BOOL JLRIsHexDigit(UniChar character)
+{
+    return (character >= '0' && character <= '9') || (character >= 'a' && character <= 'f') || (character >= 'A' && character <= 'F');
+}
+
+// parses a whole string as a decimal long long, without allocating
+static BOOL JLRParseInteger(NSString *value, long long *outInteger)
+{
+    CFStringRef string = (__bridge CFStringRef)value;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInlineBuffer inlineBuffer;
+    CFStringInitInlineBuffer(string, &inlineBuffer, CFRangeMake(0, length));
+    
+    BOOL isNegative = (length > 0 && CFStringGetCharacterFromInlineBuffer(&inlineBuffer, 0) == '-');
+    CFIndex index = isNegative ? 1 : 0;
+    if (index == length) {
+        return NO;
+    }
+    
+    // accumulated as a magnitude, which can be one more than LLONG_MAX for a negative value
+    unsigned long long limit = isNegative ? (unsigned long long)LLONG_MAX + 1 : (unsigned long long)LLONG_MAX;
+    unsigned long long magnitude = 0;
+    
+    for (; index < length; index++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index);
+        if (character < '0' || character > '9') {
+            return NO;
+        }
+        
+        unsigned long long digit = (unsigned long long)(character - '0');
+        if (magnitude > (limit - digit) / 10) {
+            return NO;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    
+    if (outInteger != NULL) {
+        *outInteger = isNegative ? (long long)(0 - magnitude) : (long long)magnitude;
+    }
+    return YES;
+}
+
+static BOOL JLRIsUUIDString(NSString *value)
+{
+    CFStringRef string = (__bridge CFStringRef)value;
+    CFIndex length = CFStringGetLength(string);
+    if (length != 36) {
+        return NO;
+    }
+    
+    CFStringInlineBuffer inlineBuffer;
+    CFStringInitInlineBuffer(string, &inlineBuffer, CFRangeMake(0, length));
+    
+    for (CFIndex index = 0; index < length; index++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index);
+        BOOL isHyphenIndex = (index == 8 || index == 13 || index == 18 || index == 23);
+        
+        if (isHyphenIndex ? character != '-' : !JLRIsHexDigit(character)) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+
+@interface JLRRouteVariableConstraint ()
+
+@property (nonatomic, assign) JLRRouteVariableConstraintType type;
+@property (nonatomic, copy) NSString *pattern;
+@property (nonatomic, strong) NSRegularExpression *regularExpression;
+
+@end
+
+
+@implementation JLRRouteVariableConstraint
+
+- (instancetype)initWithPattern:(NSString *)pattern error:(NSError **)error
+{
+    if ((self = [super init])) {
+        self.pattern = pattern;
+        
+        if ([pattern isEqualToString:@"int"]) {
+            self.type = JLRRouteVariableConstraintTypeInteger;
+        } else if ([pattern isEqualToString:@"uuid"]) {
+            self.type = JLRRouteVariableConstraintTypeUUID;
+        } else {
+            // anchored at both ends, so that every alternative has to match the whole value
+            NSString *anchoredPattern = [NSString stringWithFormat:@"^(?:%@)$", pattern];
+            self.type = JLRRouteVariableConstraintTypeRegularExpression;
+            self.regularExpression = [NSRegularExpression regularExpressionWithPattern:anchoredPattern options:0 error:error];
+            
+            if (self.regularExpression == nil) {
+                return nil;
+            }
+        }
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - <%@>", NSStringFromClass([self class]), self, self.pattern];
+}
+
+- (BOOL)acceptsValue:(NSString *)value
+{
+    if (self.type == JLRRouteVariableConstraintTypeInteger) {
+        return JLRParseInteger(value, NULL);
+    } else if (self.type == JLRRouteVariableConstraintTypeUUID) {
+        return JLRIsUUIDString(value);
+    }
+    
+    return [self.regularExpression rangeOfFirstMatchInString:value options:0 range:NSMakeRange(0, value.length)].location != NSNotFound;
+}
+
+- (id)parameterValueForValue:(NSString *)value
+{
+    long long integer = 0;
+    
+    if (self.type == JLRRouteVariableConstraintTypeInteger && JLRParseInteger(value, &integer)) {
+        return @(integer);
+    }
+    
+    return value;
+}
+
+- (id)parameterValueForAcceptedValue:(NSString *)value
+{
+    long long integer = 0;
+    
+    if (self.type == JLRRouteVariableConstraintTypeInteger) {
+        return JLRParseInteger(value, &integer) ? @(integer) : nil;
+    }
+    
+    return [self acceptsValue:value] ? value : nil;
+}
+
+- (BOOL)isEqualToConstraint:(JLRRouteVariableConstraint *)constraint
+{
+    return self.type == constraint.type && [self.pattern isEqualToString:constraint.pattern];
+}
+
+@end
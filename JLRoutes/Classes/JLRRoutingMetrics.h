@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+@class JLRRouteDefinition;
+
+
+/**
+ JLRRoutingMetrics describes what routing a single URL cost, as reported to a JLRoutes routingMetricsHandler.
+ 
+ The durations split the time spent in routeURL: between parsing the URL into a request, trying routes against it, and running
+ the handlers of the routes that matched.
+ */
+
+@interface JLRRoutingMetrics : NSObject
+
+/// The routed URL.
+@property (nonatomic, strong, readonly) NSURL *URL;
+
+/// YES if one of the router's own routes handled the URL.
+@property (nonatomic, assign, readonly) BOOL didRoute;
+
+/// The route that handled the URL, or nil if none did.
+@property (nonatomic, strong, readonly, nullable) JLRRouteDefinition *matchedRoute;
+
+/// The number of routes tried against the URL. Zero when the matches were remembered by the result cache or the URL was rejected up front.
+@property (nonatomic, assign, readonly) NSUInteger attemptCount;
+
+/// The time spent parsing the URL into a request.
+@property (nonatomic, assign, readonly) NSTimeInterval parseDuration;
+
+/// The time spent trying routes against the request, not counting their handlers.
+@property (nonatomic, assign, readonly) NSTimeInterval matchDuration;
+
+/// The time spent in the handlers of matching routes.
+@property (nonatomic, assign, readonly) NSTimeInterval handlerDuration;
+
+
+///-------------------------------
+/// @name Creating Metrics
+///-------------------------------
+
+
+/// Creates metrics with the given values.
+- (instancetype)initWithURL:(NSURL *)URL didRoute:(BOOL)didRoute matchedRoute:(nullable JLRRouteDefinition *)matchedRoute attemptCount:(NSUInteger)attemptCount parseDuration:(NSTimeInterval)parseDuration matchDuration:(NSTimeInterval)matchDuration handlerDuration:(NSTimeInterval)handlerDuration NS_DESIGNATED_INITIALIZER;
+
+/// Unavailable, please use initWithURL:didRoute:matchedRoute:attemptCount:parseDuration:matchDuration:handlerDuration: instead.
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unavailable, please use initWithURL:didRoute:matchedRoute:attemptCount:parseDuration:matchDuration:handlerDuration: instead.
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
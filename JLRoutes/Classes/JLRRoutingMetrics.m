@@ -0,0 +1,50 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRRoutingMetrics.h"
+
+
+@interface JLRRoutingMetrics ()
+
+@property (nonatomic, strong) NSURL *URL;
+@property (nonatomic, assign) BOOL didRoute;
+@property (nonatomic, strong) JLRRouteDefinition *matchedRoute;
+@property (nonatomic, assign) NSUInteger attemptCount;
+@property (nonatomic, assign) NSTimeInterval parseDuration;
+@property (nonatomic, assign) NSTimeInterval matchDuration;
+@property (nonatomic, assign) NSTimeInterval handlerDuration;
+
+@end
+
+
+@implementation JLRRoutingMetrics
+
+- (instancetype)initWithURL:(NSURL *)URL didRoute:(BOOL)didRoute matchedRoute:(JLRRouteDefinition *)matchedRoute attemptCount:(NSUInteger)attemptCount parseDuration:(NSTimeInterval)parseDuration matchDuration:(NSTimeInterval)matchDuration handlerDuration:(NSTimeInterval)handlerDuration
+{
+    if ((self = [super init])) {
+        self.URL = URL;
+        self.didRoute = didRoute;
+        self.matchedRoute = matchedRoute;
+        self.attemptCount = attemptCount;
+        self.parseDuration = parseDuration;
+        self.matchDuration = matchDuration;
+        self.handlerDuration = handlerDuration;
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - %@ routed: %@, attempts: %@, parse: %.6fs, match: %.6fs, handlers: %.6fs", NSStringFromClass([self class]), self, self.URL, (self.didRoute ? @"YES" : @"NO"), @(self.attemptCount), self.parseDuration, self.matchDuration, self.handlerDuration];
+}
+
+@end
@@ -0,0 +1,60 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRSchemeTable is an immutable, case-insensitive dispatch table from URL schemes to objects.
+ 
+ Schemes are compared ignoring ASCII case, as RFC 3986 requires, and every scheme is kept in the spelling it was first
+ added with. A small table finds the very string a scheme was added with by pointer, without hashing it. Any other scheme,
+ such as one read from a URL, is hashed once into a small open addressed table and compared character by character. Lookups
+ neither allocate nor lock, and are safe from any thread.
+ */
+
+@interface JLRSchemeTable : NSObject
+
+/// The objects in the table, keyed by scheme in the spelling each one was added with.
+@property (nonatomic, copy, readonly) NSDictionary <NSString *, id> *objectsByScheme;
+
+
+/**
+ Creates a new table.
+ 
+ @param objectsByScheme The objects to put in the table, keyed by scheme. No two schemes may differ only by case.
+ 
+ @returns The newly initialized table.
+ */
+- (instancetype)initWithObjectsByScheme:(NSDictionary <NSString *, id> *)objectsByScheme NS_DESIGNATED_INITIALIZER;
+
+/// Creates a new, empty table.
+- (instancetype)init;
+
+/// Returns the object for a scheme, ignoring case, or nil if there isn't one.
+- (nullable id)objectForScheme:(nullable NSString *)scheme;
+
+/// Returns the scheme in the table that a scheme matches ignoring case, in the spelling it was added with, or nil if there isn't one.
+- (nullable NSString *)schemeMatchingScheme:(nullable NSString *)scheme;
+
+/// Returns a copy of the table with the object for scheme set, replacing the object for any scheme that matches it ignoring case.
+- (JLRSchemeTable *)tableBySettingObject:(id)object forScheme:(NSString *)scheme;
+
+/// Returns a copy of the table without the scheme, or any scheme that matches it ignoring case.
+- (JLRSchemeTable *)tableByRemovingScheme:(NSString *)scheme;
+
+@end
+
+
+NS_ASSUME_NONNULL_END
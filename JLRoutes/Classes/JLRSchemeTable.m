@@ -0,0 +1,202 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "JLRSchemeTable.h"
+
+
+typedef struct {
+    // both are kept alive by objectsByScheme
+    __unsafe_unretained NSString *scheme;
+    __unsafe_unretained id object;
+    NSUInteger hash;
+} JLRSchemeTableSlot;
+
+// tables with fewer slots than this are scanned for the identical scheme before hashing
+static const NSUInteger JLRSchemeTableIdentityScanLimit = 16;
+
+static UniChar JLRFoldedSchemeCharacter(UniChar character)
+{
+    return (character >= 'A' && character <= 'Z') ? (UniChar)(character + ('a' - 'A')) : character;
+}
+
+static NSUInteger JLRSchemeHash(NSString *scheme)
+{
+    // FNV-1a over the case folded characters
+    CFStringRef string = (__bridge CFStringRef)scheme;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInlineBuffer inlineBuffer;
+    CFStringInitInlineBuffer(string, &inlineBuffer, CFRangeMake(0, length));
+    
+    NSUInteger hash = (NSUInteger)2166136261U;
+    for (CFIndex index = 0; index < length; index++) {
+        hash ^= JLRFoldedSchemeCharacter(CFStringGetCharacterFromInlineBuffer(&inlineBuffer, index));
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static BOOL JLRSchemesEqual(NSString *scheme1, NSString *scheme2)
+{
+    if (scheme1 == scheme2) {
+        return YES;
+    }
+    
+    CFStringRef string1 = (__bridge CFStringRef)scheme1;
+    CFStringRef string2 = (__bridge CFStringRef)scheme2;
+    CFIndex length = CFStringGetLength(string1);
+    
+    if (CFStringGetLength(string2) != length) {
+        return NO;
+    }
+    
+    CFStringInlineBuffer inlineBuffer1;
+    CFStringInlineBuffer inlineBuffer2;
+    CFStringInitInlineBuffer(string1, &inlineBuffer1, CFRangeMake(0, length));
+    CFStringInitInlineBuffer(string2, &inlineBuffer2, CFRangeMake(0, length));
+    
+    for (CFIndex index = 0; index < length; index++) {
+        UniChar character1 = JLRFoldedSchemeCharacter(CFStringGetCharacterFromInlineBuffer(&inlineBuffer1, index));
+        UniChar character2 = JLRFoldedSchemeCharacter(CFStringGetCharacterFromInlineBuffer(&inlineBuffer2, index));
+        if (character1 != character2) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+
+@interface JLRSchemeTable () {
+    JLRSchemeTableSlot *_slots;
+    NSUInteger _slotMask;
+}
+
+@property (nonatomic, copy) NSDictionary <NSString *, id> *objectsByScheme;
+
+@end
+
+
+@implementation JLRSchemeTable
+
+- (instancetype)init
+{
+    return [self initWithObjectsByScheme:@{}];
+}
+
+- (instancetype)initWithObjectsByScheme:(NSDictionary <NSString *, id> *)objectsByScheme
+{
+    if ((self = [super init])) {
+        self.objectsByScheme = objectsByScheme;
+        
+        // at most half full, so probe sequences stay short
+        NSUInteger slotCount = 8;
+        while (slotCount < objectsByScheme.count * 2) {
+            slotCount *= 2;
+        }
+        
+        _slots = calloc(slotCount, sizeof(JLRSchemeTableSlot));
+        _slotMask = slotCount - 1;
+        
+        for (NSString *scheme in self.objectsByScheme) {
+            NSUInteger hash = JLRSchemeHash(scheme);
+            NSUInteger slotIndex = hash & _slotMask;
+            
+            while (_slots[slotIndex].scheme != nil) {
+                slotIndex = (slotIndex + 1) & _slotMask;
+            }
+            
+            _slots[slotIndex].scheme = scheme;
+            _slots[slotIndex].object = self.objectsByScheme[scheme];
+            _slots[slotIndex].hash = hash;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_slots);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p> - %@", NSStringFromClass([self class]), self, self.objectsByScheme];
+}
+
+- (id)objectForScheme:(NSString *)scheme
+{
+    JLRSchemeTableSlot *slot = [self _slotForScheme:scheme];
+    return slot != NULL ? slot->object : nil;
+}
+
+- (NSString *)schemeMatchingScheme:(NSString *)scheme
+{
+    JLRSchemeTableSlot *slot = [self _slotForScheme:scheme];
+    return slot != NULL ? slot->scheme : nil;
+}
+
+- (JLRSchemeTable *)tableBySettingObject:(id)object forScheme:(NSString *)scheme
+{
+    NSMutableDictionary <NSString *, id> *objectsByScheme = [self.objectsByScheme mutableCopy];
+    // keeps the spelling the scheme was first added with
+    objectsByScheme[[self schemeMatchingScheme:scheme] ?: [scheme copy]] = object;
+    return [[JLRSchemeTable alloc] initWithObjectsByScheme:objectsByScheme];
+}
+
+- (JLRSchemeTable *)tableByRemovingScheme:(NSString *)scheme
+{
+    NSString *matchingScheme = [self schemeMatchingScheme:scheme];
+    
+    if (matchingScheme == nil) {
+        return self;
+    }
+    
+    NSMutableDictionary <NSString *, id> *objectsByScheme = [self.objectsByScheme mutableCopy];
+    [objectsByScheme removeObjectForKey:matchingScheme];
+    return [[JLRSchemeTable alloc] initWithObjectsByScheme:objectsByScheme];
+}
+
+
+#pragma mark - Private
+
+- (JLRSchemeTableSlot *)_slotForScheme:(NSString *)scheme
+{
+    if (scheme == nil) {
+        return NULL;
+    }
+    
+    // a scheme that is the very string that was added, like JLRoutesGlobalRoutesScheme, is found without hashing it. a small
+    // table is quicker to scan for it than the scheme is to hash.
+    if (_slotMask < JLRSchemeTableIdentityScanLimit) {
+        for (NSUInteger slotIndex = 0; slotIndex <= _slotMask; slotIndex++) {
+            if (_slots[slotIndex].scheme == scheme) {
+                return &_slots[slotIndex];
+            }
+        }
+    }
+    
+    NSUInteger hash = JLRSchemeHash(scheme);
+    NSUInteger slotIndex = hash & _slotMask;
+    
+    // the table is never full, so there's always an empty slot to stop at
+    while (_slots[slotIndex].scheme != nil) {
+        JLRSchemeTableSlot *slot = &_slots[slotIndex];
+        if (slot->hash == hash && JLRSchemesEqual(slot->scheme, scheme)) {
+            return slot;
+        }
+        slotIndex = (slotIndex + 1) & _slotMask;
+    }
+    
+    return NULL;
+}
+
+@end
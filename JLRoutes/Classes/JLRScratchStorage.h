@@ -0,0 +1,52 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+/**
+ JLRScratchStorage is memory owned by one thread and reused by every URL it parses, so that steady state parsing doesn't
+ allocate buffers of its own. Each buffer grows to the largest size asked of it, up to a limit past which it's given back
+ once it's no longer in use.
+ 
+ Storage is taken with JLRScratchStorageAcquire() and must be given back with JLRScratchStorageRelinquish() on the same
+ thread before anything that could parse another URL, such as a route handler, is called. If the thread's storage is
+ already in use, a temporary storage is returned instead and freed when it's relinquished.
+ */
+typedef struct JLRScratchStorage JLRScratchStorage;
+
+/// The separate buffers of a scratch storage, which can be in use at the same time.
+typedef NS_ENUM(NSUInteger, JLRScratchBuffer) {
+    /// The assembled URL path.
+    JLRScratchBufferPath,
+    /// The path component strings, before they're put into an array.
+    JLRScratchBufferPathComponents,
+    /// Percent decoded bytes.
+    JLRScratchBufferDecoding,
+    
+    JLRScratchBufferCount,
+};
+
+/// Takes the calling thread's scratch storage, or a temporary one if it's already in use.
+JLRScratchStorage *JLRScratchStorageAcquire(void);
+
+/// Gives back a storage returned by JLRScratchStorageAcquire(). Its buffers mustn't be used afterwards.
+void JLRScratchStorageRelinquish(JLRScratchStorage *storage);
+
+/// Returns one of the storage's buffers with room for at least size bytes. Its contents are undefined, and it stays valid
+/// until the same buffer is asked for again or the storage is relinquished.
+void *JLRScratchStorageGetBuffer(JLRScratchStorage *storage, JLRScratchBuffer buffer, size_t size);
+
+
+NS_ASSUME_NONNULL_END
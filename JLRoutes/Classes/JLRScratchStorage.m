@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+#import "JLRScratchStorage.h"
+
+
+// buffers larger than this are freed when the storage is relinquished, so that one long URL doesn't pin its memory forever
+static const size_t JLRScratchStorageRetainedCapacity = 16 * 1024;
+static const size_t JLRScratchStorageMinimumCapacity = 256;
+
+struct JLRScratchStorage {
+    void *buffers[JLRScratchBufferCount];
+    size_t capacities[JLRScratchBufferCount];
+    BOOL isInUse;
+    BOOL isTemporary;
+};
+
+static pthread_key_t scratchStorageKey;
+static pthread_once_t scratchStorageKeyOnce = PTHREAD_ONCE_INIT;
+
+
+static void JLRScratchStorageFree(void *storage)
+{
+    JLRScratchStorage *scratchStorage = storage;
+    
+    for (NSUInteger index = 0; index < JLRScratchBufferCount; index++) {
+        free(scratchStorage->buffers[index]);
+    }
+    free(scratchStorage);
+}
+
+static void JLRCreateScratchStorageKey(void)
+{
+    // the destructor frees a thread's storage when it exits
+    pthread_key_create(&scratchStorageKey, JLRScratchStorageFree);
+}
+
+JLRScratchStorage *JLRScratchStorageAcquire(void)
+{
+    pthread_once(&scratchStorageKeyOnce, JLRCreateScratchStorageKey);
+    
+    JLRScratchStorage *storage = pthread_getspecific(scratchStorageKey);
+    if (storage == NULL) {
+        storage = calloc(1, sizeof(JLRScratchStorage));
+        pthread_setspecific(scratchStorageKey, storage);
+    }
+    
+    if (storage->isInUse) {
+        // a parse nested inside another one on the same thread
+        JLRScratchStorage *temporaryStorage = calloc(1, sizeof(JLRScratchStorage));
+        temporaryStorage->isTemporary = YES;
+        temporaryStorage->isInUse = YES;
+        return temporaryStorage;
+    }
+    
+    storage->isInUse = YES;
+    return storage;
+}
+
+void JLRScratchStorageRelinquish(JLRScratchStorage *storage)
+{
+    if (storage->isTemporary) {
+        JLRScratchStorageFree(storage);
+        return;
+    }
+    
+    for (NSUInteger index = 0; index < JLRScratchBufferCount; index++) {
+        if (storage->capacities[index] > JLRScratchStorageRetainedCapacity) {
+            free(storage->buffers[index]);
+            storage->buffers[index] = NULL;
+            storage->capacities[index] = 0;
+        }
+    }
+    
+    storage->isInUse = NO;
+}
+
+void *JLRScratchStorageGetBuffer(JLRScratchStorage *storage, JLRScratchBuffer buffer, size_t size)
+{
+    if (size > storage->capacities[buffer]) {
+        // the contents don't need to be kept, so there's no point in realloc copying them
+        size_t capacity = MAX(MAX(size, storage->capacities[buffer] * 2), JLRScratchStorageMinimumCapacity);
+        free(storage->buffers[buffer]);
+        storage->buffers[buffer] = malloc(capacity);
+        storage->capacities[buffer] = capacity;
+    }
+    
+    return storage->buffers[buffer];
+}
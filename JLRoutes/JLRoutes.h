@@ -11,11 +11,14 @@
  */
 
 #import <Foundation/Foundation.h>
+#import "JLRLogger.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 
 @class JLRRouteDefinition;
+@class JLRRoutingMetrics;
+@class JLRRouteConflict;
 
 
 /// The matching route pattern, passed in the handler parameters.
@@ -34,10 +37,26 @@ extern NSString *const JLRouteWildcardComponentsKey;
 /// @see JLRoutes +globalRoutes
 extern NSString *const JLRoutesGlobalRoutesScheme;
 
+/// The error domain of errors returned by JLRoutes.
+extern NSString *const JLRoutesErrorDomain;
+
+/// The codes of errors in JLRoutesErrorDomain.
+typedef NS_ENUM(NSInteger, JLRoutesErrorCode) {
+    /// The data isn't a compiled route table this version of JLRoutes can read, or it is corrupted.
+    JLRoutesErrorInvalidRouteTable = 1,
+    /// The compiled route table wasn't built from the expected route set, or not for the receiving scheme.
+    JLRoutesErrorRouteSetHashMismatch = 2,
+    /// No handler was given for one of the patterns in the compiled route table.
+    JLRoutesErrorMissingHandler = 3,
+};
+
 
 
 /**
  The JLRoutes class is the main entry-point into the JLRoutes framework. Used for accessing schemes, managing routes, and routing URLs.
+ 
+ Schemes and routes may be registered, removed and routed from any thread. Routing works from immutable snapshots of the routes and
+ never waits on a thread that is changing them.
  */
 
 @interface JLRoutes : NSObject
@@ -48,6 +67,38 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Called any time routeURL returns NO. Respects shouldFallbackToGlobalRoutes.
 @property (nonatomic, copy, nullable) void (^unmatchedURLHandler)(JLRoutes *routes, NSURL *__nullable URL, NSDictionary<NSString *, id> *__nullable parameters);
 
+/// Called after this router tries its own routes for a URL passed to routeURL:, with how long parsing, matching and handling it took.
+/// A URL that falls back to global routes is reported to the global routes' handler as well. Routing doesn't measure anything while this is nil.
+@property (nonatomic, copy, nullable) void (^routingMetricsHandler)(JLRoutes *routes, JLRRoutingMetrics *metrics);
+
+/// Controls whether this router looks up candidate routes in a compiled trie of pattern path components instead of trying every route in turn.
+/// Lookup cost then depends on the depth of the URL path rather than the number of registered routes. Matching results are the same either way. Default is NO.
+@property (nonatomic, assign) BOOL usesCompiledMatcher;
+
+/// The number of routed URLs to remember the matching routes and parameters for, least recently routed URLs being forgotten first.
+/// Routing a remembered URL calls the handlers of its matching routes without parsing the URL or trying any other routes. Changing the
+/// routes or the global options forgets every URL. Default is 0, which doesn't remember any. Changing it also forgets every URL.
+@property (nonatomic, assign) NSUInteger resultCacheCapacity;
+
+/// The number of routed URLs whose matching routes were remembered, since resultCacheCapacity was last changed.
+@property (nonatomic, assign, readonly) NSUInteger resultCacheHitCount;
+
+/// The number of routed URLs whose matching routes weren't remembered, since resultCacheCapacity was last changed.
+@property (nonatomic, assign, readonly) NSUInteger resultCacheMissCount;
+
+/// The number of URLs to remember canRouteURL: finding no matching route for, so that asking again about one of them returns NO straight away.
+/// Like the result cache, changing the routes or the global options forgets every URL. Default is 0, which doesn't remember any.
+/// Independently of this, URLs whose first path component can't start any route's pattern are always rejected without trying the routes.
+@property (nonatomic, assign) NSUInteger rejectedURLCacheCapacity;
+
+/// Controls whether routes of equal priority get reordered now and then so that the ones handling the most URLs are tried first. Only routes
+/// that can't match the same URL trade places, routes that could both match one keep the order they were registered in, so which route
+/// handles a URL never changes. The new order is worked out in the background and dropped if the routes change before it's ready. Default is NO.
+@property (nonatomic, assign) BOOL adaptsRouteOrder;
+
+/// The number of URLs handled between reorderings when adaptsRouteOrder is YES. Default is 1000.
+@property (nonatomic, assign) NSUInteger routeOrderAdaptationInterval;
+
 
 ///-------------------------------
 /// @name Routing Schemes
@@ -57,10 +108,10 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Returns the global routing scheme
 + (instancetype)globalRoutes;
 
-/// Returns a routing namespace for the given scheme
+/// Returns a routing namespace for the given scheme. Schemes are case-insensitive (RFC 3986), so "App" and "app" share a namespace.
 + (instancetype)routesForScheme:(NSString *)scheme;
 
-/// Unregister and delete an entire scheme namespace
+/// Unregister and delete an entire scheme namespace. The scheme is matched case-insensitively.
 + (void)unregisterRouteScheme:(NSString *)scheme;
 
 /// Unregister all routes
@@ -75,6 +126,9 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Add a route by directly inserted the route definition. This may be a subclass of JLRRouteDefinition to provide customized routing logic.
 - (void)addRoute:(JLRRouteDefinition *)routeDefinition;
 
+/// Adds multiple route definitions at once. They are sorted and indexed in a single pass, rather than once per route.
+- (void)addRouteDefinitions:(NSArray <JLRRouteDefinition *> *)routeDefinitions;
+
 /// Registers a routePattern with default priority (0) in the receiving scheme namespace.
 - (void)addRoute:(NSString *)routePattern handler:(BOOL (^__nullable)(NSDictionary<NSString *, id> *parameters))handlerBlock;
 
@@ -83,9 +137,21 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// a block returns NO, JLRoutes will continue trying to find a matching route.
 - (void)addRoute:(NSString *)routePattern priority:(NSUInteger)priority handler:(BOOL (^__nullable)(NSDictionary<NSString *, id> *parameters))handlerBlock;
 
+/// Registers a routePattern with default priority (0) and an asynchronous handler in the receiving scheme namespace.
+- (void)addRoute:(NSString *)routePattern asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))handlerBlock;
+
+/// Registers a routePattern with a handlerBlock that reports whether it actually handled the route by calling completion exactly once,
+/// possibly later and on any thread. When routing asynchronously, JLRoutes waits for the report before trying the next matching route.
+/// When routing synchronously there is no waiting for it, so the route is considered handled.
+- (void)addRoute:(NSString *)routePattern priority:(NSUInteger)priority asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))handlerBlock;
+
 /// Registers multiple routePatterns for one handler with default priority (0) in the receiving scheme namespace.
 - (void)addRoutes:(NSArray<NSString *> *)routePatterns handler:(BOOL (^__nullable)(NSDictionary<NSString *, id> *parameters))handlerBlock;
 
+/// Calls the updates block, deferring the routes it registers until it returns and then adding them together, like addRouteDefinitions:.
+/// Routes added inside the block can't be matched until the block returns. Calls may be nested, in which case the outermost call adds the routes.
+- (void)performBatchUpdates:(void (NS_NOESCAPE ^)(void))updates;
+
 /// Removes a routePattern from the receiving scheme namespace.
 - (void)removeRoute:(NSString *)routePattern;
 
@@ -104,6 +170,44 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 + (NSDictionary <NSString *, NSArray <JLRRouteDefinition *> *> *)allRoutes;
 
 
+///-------------------------------
+/// @name Analyzing Routes
+///-------------------------------
+
+
+/// Returns every pair of routes in the receiving scheme namespace that can match the same URL, in routing order, judging by their
+/// compiled segments alone. Routes of JLRRouteDefinition subclasses that don't support segment indexing aren't analyzed. When verbose
+/// logging is enabled, routes that are shadowed by one registered before them are also logged as they're added.
+- (NSArray <JLRRouteConflict *> *)routeConflicts;
+
+/// Removes the routes that routeConflicts reports as shadowed and returns them. A shadowed route is still reached when the handler of
+/// every route shadowing it returns NO, so only use this when those handlers always handle the URLs they're given.
+- (NSArray <JLRRouteDefinition *> *)removeShadowedRoutes;
+
+
+///-------------------------------
+/// @name Compiled Route Tables
+///-------------------------------
+
+
+/// A hash of the registered routes in the receiving scheme namespace: their patterns, the patterns they were registered with,
+/// their priorities and their order. Registering the same routes the same way always gives the same hash, on any device.
+@property (nonatomic, assign, readonly) uint64_t routeSetHash;
+
+/// Returns the registered routes in the receiving scheme namespace compiled into a compact binary table, already expanded, split
+/// into their compiled segments and sorted, along with their routeSetHash. Write it out at build time and memory-map it on launch with NSDataReadingMappedIfSafe.
+/// Returns nil, and logs a warning, if any route is an instance of a JLRRouteDefinition subclass, since custom matching logic can't
+/// be serialized, or has an asynchronous handler, since addRoutesFromCompiledRouteTable: only binds synchronous ones.
+- (nullable NSData *)compiledRouteTable;
+
+/// Adds the routes of a table returned by compiledRouteTable without parsing, expanding or sorting their patterns again: each
+/// route is created from its stored segments and merged in, in the table's order. Variable constraints are still compiled, once
+/// per distinct constraint in the table. Handlers are bound by the pattern each route was registered with, so all the routes expanded from one pattern with optional
+/// groups share the handler for that pattern. Nothing is added, and the failure is logged, if the table is invalid, if its route
+/// set hash isn't routeSetHash because the routes changed since the table was built, or if handlers is missing a pattern.
+- (BOOL)addRoutesFromCompiledRouteTable:(NSData *)routeTable routeSetHash:(uint64_t)routeSetHash handlers:(NSDictionary <NSString *, BOOL (^)(NSDictionary<NSString *, id> *parameters)> *)handlers error:(NSError **)error;
+
+
 ///-------------------------------
 /// @name Routing URLs
 ///-------------------------------
@@ -115,6 +219,23 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Returns YES if the provided URL will successfully match against any registered route for the current scheme, NO if not.
 - (BOOL)canRouteURL:(nullable NSURL *)URL;
 
+/// Returns the first route the provided URL matches in the current scheme, or nil if it doesn't match any. No handler block is called and
+/// no parameters are built, so a route is returned even if its handler block would turn the URL down. Respects shouldFallbackToGlobalRoutes.
+- (nullable JLRRouteDefinition *)routeDefinitionMatchingURL:(nullable NSURL *)URL;
+
+/// Returns the first route the provided URL matches in the current scheme like routeDefinitionMatchingURL:, along with the ranges of the
+/// path components each of its variables captured, keyed by variable name and by JLRouteWildcardComponentsKey for the wildcard. The path
+/// components are the ones a JLRRouteRequest for the URL splits it into, and are left percent encoded.
+- (nullable JLRRouteDefinition *)routeDefinitionMatchingURL:(nullable NSURL *)URL variableRanges:(NSDictionary <NSString *, NSValue *> *__nullable *__nullable)variableRanges;
+
+/// Returns, for each URL, the first route it matches in any routes scheme, or NSNull if it doesn't match any. No handler blocks are called,
+/// so a route is returned even if its handler block would turn the URL down. The URLs are matched in parallel. Respects shouldFallbackToGlobalRoutes.
++ (NSArray *)routeDefinitionsMatchingURLs:(NSArray <NSURL *> *)URLs;
+
+/// Returns, for each URL, the first route it matches in the current scheme, or NSNull if it doesn't match any. No handler blocks are called,
+/// so a route is returned even if its handler block would turn the URL down. The URLs are matched in parallel. Respects shouldFallbackToGlobalRoutes.
+- (NSArray *)routeDefinitionsMatchingURLs:(NSArray <NSURL *> *)URLs;
+
 /// Routes a URL, calling handler blocks for patterns that match the URL until one returns YES.
 /// If no matching route is found, the unmatchedURLHandler will be called (if set).
 + (BOOL)routeURL:(nullable NSURL *)URL;
@@ -131,6 +252,14 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Additional parameters get passed through to the matched route block.
 - (BOOL)routeURL:(nullable NSURL *)URL withParameters:(nullable NSDictionary<NSString *, id> *)parameters;
 
+/// Routes a URL in any routes scheme without blocking the calling thread. Matching happens on a background queue, while the matched route
+/// blocks, the unmatchedURLHandler and completion are called on queue. Completion is passed YES if a route block handled the URL.
++ (void)routeURL:(nullable NSURL *)URL withParameters:(nullable NSDictionary<NSString *, id> *)parameters queue:(dispatch_queue_t)queue completion:(nullable void (^)(BOOL didRoute))completion;
+
+/// Routes a URL in a specific scheme without blocking the calling thread. Matching happens on a background queue, while the matched route
+/// blocks, the unmatchedURLHandler and completion are called on queue. Completion is passed YES if a route block handled the URL.
+- (void)routeURL:(nullable NSURL *)URL withParameters:(nullable NSDictionary<NSString *, id> *)parameters queue:(dispatch_queue_t)queue completion:(nullable void (^)(BOOL didRoute))completion;
+
 @end
 
 
@@ -142,12 +271,24 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// @name Configuring Global Options
 ///----------------------------------
 
-/// Configures verbose logging. Defaults to NO.
+/// Configures verbose logging, which sets the log level to JLRLogLevelDebug when enabled and back to JLRLogLevelError when not. Defaults to NO.
 + (void)setVerboseLoggingEnabled:(BOOL)loggingEnabled;
 
-/// Returns current verbose logging enabled state. Defaults to NO.
+/// Returns YES if the log level is JLRLogLevelDebug. Defaults to NO.
 + (BOOL)isVerboseLoggingEnabled;
 
+/// Configures the most verbose level of messages that are logged. Messages of other levels aren't formatted at all. Defaults to JLRLogLevelError.
++ (void)setLogLevel:(JLRLogLevel)logLevel;
+
+/// Returns the most verbose level of messages that are logged. Defaults to JLRLogLevelError.
++ (JLRLogLevel)logLevel;
+
+/// Configures the logger that messages are passed to. Passing nil restores the default, a JLROSLogger.
++ (void)setLogger:(nullable id <JLRLogger>)logger;
+
+/// Returns the logger that messages are passed to. Defaults to a JLROSLogger.
++ (id <JLRLogger>)logger;
+
 /// Configures if '+' should be replaced with spaces in parsed values. Defaults to YES.
 + (void)setShouldDecodePlusSymbols:(BOOL)shouldDecode;
 
@@ -160,6 +301,13 @@ extern NSString *const JLRoutesGlobalRoutesScheme;
 /// Returns if URL host is always considered to be a path component. Defaults to NO.
 + (BOOL)alwaysTreatsHostAsPathComponent;
 
+/// Configures counting attempts and matches on each route definition, and emitting os_signpost intervals for parsing, matching and handling
+/// URLs where the OS supports them. Routing does none of this work while disabled. Defaults to NO.
++ (void)setInstrumentationEnabled:(BOOL)instrumentationEnabled;
+
+/// Returns if route counters and signposts are enabled. Defaults to NO.
++ (BOOL)isInstrumentationEnabled;
+
 @end
 
 
@@ -10,9 +10,24 @@
  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <pthread.h>
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+#if __has_include(<os/signpost.h>)
+#import <os/signpost.h>
+#endif
 #import "JLRoutes.h"
 #import "JLRRouteDefinition.h"
 #import "JLRParsingUtilities.h"
+#import "JLRRouteTrie.h"
+#import "JLRRouteResultCache.h"
+#import "JLRBloomFilter.h"
+#import "JLRParameterDictionary.h"
+#import "JLRRouteTable.h"
+#import "JLRSchemeTable.h"
+#import "JLRRoutingMetrics.h"
+#import "JLRRouteConflict.h"
+#import "JLRLogging.h"
 
 
 NSString *const JLRoutePatternKey = @"JLRoutePattern";
@@ -20,20 +35,378 @@ NSString *const JLRouteURLKey = @"JLRouteURL";
 NSString *const JLRouteSchemeKey = @"JLRouteScheme";
 NSString *const JLRouteWildcardComponentsKey = @"JLRouteWildcardComponents";
 NSString *const JLRoutesGlobalRoutesScheme = @"JLRoutesGlobalRoutesScheme";
+NSString *const JLRoutesErrorDomain = @"JLRoutesErrorDomain";
 
 
-static NSMutableDictionary *routeControllersMap = nil;
+// guards replacing the published route controllers map, reading it needs no lock
+static pthread_mutex_t routeControllersLock = PTHREAD_MUTEX_INITIALIZER;
 
 // global options
-static BOOL verboseLoggingEnabled = NO;
 static BOOL shouldDecodePlusSymbols = YES;
 static BOOL alwaysTreatsHostAsPathComponent = NO;
+static BOOL instrumentationEnabled = NO;
 
+// asynchronous routing matches URLs here, off the queue its handlers are called on
+static dispatch_queue_t JLRRoutingQueue(void)
+{
+    return dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+}
+
+// adaptsRouteOrder works out new route orders here, off the routing threads and without holding any routes lock
+static dispatch_queue_t JLRRouteOrderAdaptationQueue(void)
+{
+    return dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+}
+
+
+#pragma mark - Instrumentation
+
+
+typedef NS_ENUM(NSUInteger, JLRRoutingPhase) {
+    JLRRoutingPhaseParse,
+    JLRRoutingPhaseMatch,
+    JLRRoutingPhaseHandler,
+};
+
+// what routing one URL has cost so far, only kept while something is measuring routing
+typedef struct {
+    uint64_t parseTime;
+    uint64_t matchTime;
+    uint64_t handlerTime;
+    NSUInteger attemptCount;
+    __unsafe_unretained JLRRouteDefinition *matchedRoute;
+} JLRRoutingMeasurement;
+
+static NSTimeInterval JLRTimeIntervalFromMachTime(uint64_t machTime)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return (NSTimeInterval)machTime * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+static void JLRSignpostRoutingPhase(JLRRoutingPhase phase, const void *identity, BOOL begin)
+{
+#if __has_include(<os/signpost.h>)
+    if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, watchOS 5.0, *)) {
+        static os_log_t log = NULL;
+        static dispatch_once_t onceToken;
+        dispatch_once(&onceToken, ^{
+            log = os_log_create("com.joeldev.JLRoutes", "Routing");
+        });
+        
+        // os_signpost needs the interval names as literals
+        os_signpost_id_t signpostID = os_signpost_id_make_with_pointer(log, identity);
+        switch (phase) {
+            case JLRRoutingPhaseParse:
+                if (begin) {
+                    os_signpost_interval_begin(log, signpostID, "Parse");
+                } else {
+                    os_signpost_interval_end(log, signpostID, "Parse");
+                }
+                break;
+            case JLRRoutingPhaseMatch:
+                if (begin) {
+                    os_signpost_interval_begin(log, signpostID, "Match");
+                } else {
+                    os_signpost_interval_end(log, signpostID, "Match");
+                }
+                break;
+            case JLRRoutingPhaseHandler:
+                if (begin) {
+                    os_signpost_interval_begin(log, signpostID, "Handler");
+                } else {
+                    os_signpost_interval_end(log, signpostID, "Handler");
+                }
+                break;
+        }
+    }
+#endif
+}
+
+// the measurement functions do nothing when passed NULL, which is what routing passes them unless something is measuring
+static uint64_t JLRBeginRoutingPhase(JLRRoutingMeasurement *measurement, JLRRoutingPhase phase)
+{
+    if (measurement == NULL) {
+        return 0;
+    }
+    
+    if (instrumentationEnabled) {
+        JLRSignpostRoutingPhase(phase, measurement, YES);
+    }
+    return mach_absolute_time();
+}
+
+static void JLREndRoutingPhase(JLRRoutingMeasurement *measurement, JLRRoutingPhase phase, uint64_t startTime)
+{
+    if (measurement == NULL) {
+        return;
+    }
+    
+    uint64_t elapsedTime = mach_absolute_time() - startTime;
+    switch (phase) {
+        case JLRRoutingPhaseParse:
+            measurement->parseTime += elapsedTime;
+            break;
+        case JLRRoutingPhaseMatch:
+            measurement->matchTime += elapsedTime;
+            break;
+        case JLRRoutingPhaseHandler:
+            measurement->handlerTime += elapsedTime;
+            break;
+    }
+    
+    if (instrumentationEnabled) {
+        JLRSignpostRoutingPhase(phase, measurement, NO);
+    }
+}
+
+
+/**
+ An immutable copy of a JLRoutes instance's routes, path component count index and compiled trie, along with a filter
+ over the literal first path components of the routes.
+ 
+ Routing iterates a snapshot, so it never has to copy the route lists to protect itself from handlers that add or remove
+ routes, and it can run on any thread while another thread changes the routes. Snapshots are taken lazily: changing the
+ routes only discards the current one, and the next lookup takes a new one.
+ */
+
+@interface JLRRoutesSnapshot : NSObject
+
+@property (nonatomic, copy, readonly) NSArray <JLRRouteDefinition *> *routes;
+@property (nonatomic, copy, readonly) NSDictionary <NSNumber *, NSArray <JLRRouteDefinition *> *> *routesByPathComponentCount;
+@property (nonatomic, copy, readonly) NSArray <JLRRouteDefinition *> *variableLengthRoutes;
+@property (nonatomic, copy, readonly) JLRRouteTrie *routeTrie;
+
+// nil if any route can match any first path component
+@property (nonatomic, strong, readonly) JLRBloomFilter *firstPathComponentFilter;
+
+- (instancetype)initWithRoutes:(NSArray <JLRRouteDefinition *> *)routes routesByPathComponentCount:(NSDictionary <NSNumber *, NSArray <JLRRouteDefinition *> *> *)routesByPathComponentCount variableLengthRoutes:(NSArray <JLRRouteDefinition *> *)variableLengthRoutes routeTrie:(JLRRouteTrie *)routeTrie;
+
+/// Returns NO if no route can match a URL whose first path component has the given hashForPathComponent: hash. YES means it's worth trying the routes.
+- (BOOL)mayMatchFirstPathComponentHash:(NSUInteger)hash;
+
+/// Like mayMatchFirstPathComponentHash:, for a request that's already been built.
+- (BOOL)mayMatchRequest:(JLRRouteRequest *)request;
+
+@end
+
+
+@implementation JLRRoutesSnapshot
+
+- (instancetype)initWithRoutes:(NSArray <JLRRouteDefinition *> *)routes routesByPathComponentCount:(NSDictionary <NSNumber *, NSArray <JLRRouteDefinition *> *> *)routesByPathComponentCount variableLengthRoutes:(NSArray <JLRRouteDefinition *> *)variableLengthRoutes routeTrie:(JLRRouteTrie *)routeTrie
+{
+    if ((self = [super init])) {
+        _routes = [routes copy];
+        _variableLengthRoutes = [variableLengthRoutes copy];
+        
+        // the copy shares the trie's nodes until the routes controller changes them
+        _routeTrie = [routeTrie copy];
+        
+        // the buckets themselves are mutable, so they need copying too
+        NSMutableDictionary <NSNumber *, NSArray <JLRRouteDefinition *> *> *buckets = [NSMutableDictionary dictionaryWithCapacity:routesByPathComponentCount.count];
+        [routesByPathComponentCount enumerateKeysAndObjectsUsingBlock:^(NSNumber *pathComponentCount, NSArray <JLRRouteDefinition *> *bucket, BOOL *stop) {
+            buckets[pathComponentCount] = [bucket copy];
+        }];
+        _routesByPathComponentCount = [buckets copy];
+        
+        _firstPathComponentFilter = [[self class] _firstPathComponentFilterForRoutes:_routes];
+    }
+    return self;
+}
+
++ (JLRBloomFilter *)_firstPathComponentFilterForRoutes:(NSArray <JLRRouteDefinition *> *)routes
+{
+    JLRBloomFilter *filter = [[JLRBloomFilter alloc] initWithExpectedCount:routes.count];
+    
+    for (JLRRouteDefinition *route in routes) {
+        JLRRouteSegment firstSegment = route.segments[0];
+        
+        if (![[route class] supportsSegmentIndexing] || firstSegment.type != JLRRouteSegmentTypeLiteral) {
+            // this route may match any first path component, which leaves nothing to rule out
+            return nil;
+        }
+        
+        [filter addHash:[JLRRouteRequest hashForPathComponent:firstSegment.value]];
+    }
+    
+    return filter;
+}
+
+- (BOOL)mayMatchFirstPathComponentHash:(NSUInteger)hash
+{
+    return self.firstPathComponentFilter == nil || [self.firstPathComponentFilter mayContainHash:hash];
+}
+
+- (BOOL)mayMatchRequest:(JLRRouteRequest *)request
+{
+    NSUInteger hash = 0;
+    
+    if (self.firstPathComponentFilter == nil || ![request getFirstPathComponentHash:&hash]) {
+        return YES;
+    }
+    
+    return [self.firstPathComponentFilter mayContainHash:hash];
+}
+
+@end
+
+
+#pragma mark -
+
+/**
+ The published table of scheme to routes controller. The table itself is immutable and gets replaced wholesale under
+ routeControllersLock, and the property is atomic, so a reader on any thread always gets a complete table without locking.
+ */
+
+@interface JLRRouteControllers : NSObject
+
+@property (atomic, strong) JLRSchemeTable *table;
+
++ (instancetype)sharedControllers;
+
+@end
+
+
+@implementation JLRRouteControllers
+
++ (instancetype)sharedControllers
+{
+    static JLRRouteControllers *sharedControllers = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedControllers = [[JLRRouteControllers alloc] init];
+        sharedControllers.table = [[JLRSchemeTable alloc] init];
+    });
+    return sharedControllers;
+}
+
+@end
+
+
+/**
+ What routing a URL found last time: every matching route up to the one whose handler took the URL, in order, with
+ the parameters of each match. Only valid for the snapshot and global options it was recorded with.
+ */
+
+@interface JLRRouteResultCacheEntry : NSObject
+
+@property (nonatomic, weak, readonly) JLRRoutesSnapshot *snapshot;
+@property (nonatomic, assign, readonly) BOOL decodesPlusSymbols;
+@property (nonatomic, assign, readonly) BOOL treatsHostAsPathComponent;
+
+@property (nonatomic, strong, readonly) NSMutableArray <JLRRouteDefinition *> *matchedRoutes;
+@property (nonatomic, strong, readonly) NSMutableArray <NSDictionary *> *matchedParameters;
+
+// index into the snapshot's candidate routes for the URL to carry on from after the last match, or NSNotFound if
+// there are no matches left to find
+@property (nonatomic, assign) NSUInteger resumeIndex;
+
+- (instancetype)initWithSnapshot:(JLRRoutesSnapshot *)snapshot;
+- (BOOL)isValidForSnapshot:(JLRRoutesSnapshot *)snapshot;
+
+@end
+
+
+@implementation JLRRouteResultCacheEntry
+
+- (instancetype)initWithSnapshot:(JLRRoutesSnapshot *)snapshot
+{
+    if ((self = [super init])) {
+        _snapshot = snapshot;
+        _decodesPlusSymbols = shouldDecodePlusSymbols;
+        _treatsHostAsPathComponent = alwaysTreatsHostAsPathComponent;
+        _matchedRoutes = [NSMutableArray array];
+        _matchedParameters = [NSMutableArray array];
+        _resumeIndex = NSNotFound;
+    }
+    return self;
+}
+
+- (BOOL)isValidForSnapshot:(JLRRoutesSnapshot *)snapshot
+{
+    return self.snapshot == snapshot && self.decodesPlusSymbols == shouldDecodePlusSymbols && self.treatsHostAsPathComponent == alwaysTreatsHostAsPathComponent;
+}
+
+@end
+
+
+#pragma mark -
+
+@interface JLRRouteDefinition (JLRoutesInstrumentation)
+
+// counts an attempt to match the route, implemented by JLRRouteDefinition itself
+- (void)recordAttemptDidMatch:(BOOL)didMatch;
+
+// the URLs the route handled while adaptsRouteOrder was on, halved every time the routes are reordered so old hits fade out
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+- (void)recordHit;
+- (void)halveHitCount;
+
+@end
+
+
+static void JLRRecordRouteAttempt(JLRRoutingMeasurement *measurement, JLRRouteDefinition *route, BOOL didMatch)
+{
+    if (measurement == NULL) {
+        return;
+    }
+    
+    measurement->attemptCount++;
+    if (instrumentationEnabled) {
+        [route recordAttemptDidMatch:didMatch];
+    }
+}
+
+
+@interface JLRRouteDefinition (JLRoutesRegistration)
+
+// the pattern passed to JLRoutes when this route was expanded from one with optional groups, nil otherwise
+@property (nonatomic, copy) NSString *registeredPattern;
+
+@end
+
+
+#pragma mark -
 
-@interface JLRoutes ()
+@interface JLRoutes () {
+    // serializes changes to this instance's routes. routing itself only reads snapshots and doesn't take it.
+    pthread_mutex_t _routesLock;
+    
+    // URLs handled since the routes were last reordered, counted by routing threads while adaptsRouteOrder is on
+    _Atomic(NSUInteger) _handledURLCount;
+    
+    // bumped by every change to the routes, so a reorder worked out from older routes is thrown away instead of published
+    _Atomic(NSUInteger) _routesGeneration;
+    
+    // set while a reorder is being worked out, so there's only ever one
+    _Atomic(BOOL) _isAdaptingRouteOrder;
+}
 
 @property (nonatomic, strong) NSMutableArray *mutableRoutes;
 @property (nonatomic, strong) NSString *scheme;
+@property (nonatomic, strong) JLRRouteTrie *routeTrie;
+
+// routes registered inside -performBatchUpdates:, added to mutableRoutes when the outermost batch ends
+@property (nonatomic, strong) NSMutableArray <JLRRouteDefinition *> *pendingRoutes;
+@property (nonatomic, assign) NSUInteger batchUpdateDepth;
+
+// secondary index of mutableRoutes. each bucket holds, in priority order, the routes that match exactly that many
+// path components along with every variable length route that can match that many.
+@property (nonatomic, strong) NSMutableDictionary <NSNumber *, NSMutableArray <JLRRouteDefinition *> *> *routesByPathComponentCount;
+@property (nonatomic, strong) NSMutableArray <JLRRouteDefinition *> *variableLengthRoutes;
+
+// discarded whenever the routes change, see -_currentSnapshot. atomic because routing threads read it without _routesLock.
+@property (atomic, strong) JLRRoutesSnapshot *snapshot;
+
+// nil unless resultCacheCapacity is set
+@property (atomic, strong) JLRRouteResultCache *resultCache;
+
+// nil unless rejectedURLCacheCapacity is set
+@property (atomic, strong) JLRRouteResultCache *rejectedURLCache;
 
 @end
 
@@ -46,22 +419,33 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 {
     if ((self = [super init])) {
         self.mutableRoutes = [NSMutableArray array];
+        self.routesByPathComponentCount = [NSMutableDictionary dictionary];
+        self.variableLengthRoutes = [NSMutableArray array];
+        self.pendingRoutes = [NSMutableArray array];
+        self.routeOrderAdaptationInterval = 1000;
+        pthread_mutex_init(&_routesLock, NULL);
     }
     return self;
 }
 
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_routesLock);
+}
+
 - (NSString *)description
 {
-    return [self.mutableRoutes description];
+    return [[self _currentSnapshot].routes description];
 }
 
 + (NSDictionary <NSString *, NSArray <JLRRouteDefinition *> *> *)allRoutes;
 {
     NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+    NSDictionary <NSString *, JLRoutes *> *routeControllersMap = [JLRRouteControllers sharedControllers].table.objectsByScheme;
     
-    for (NSString *namespace in [routeControllersMap copy]) {
+    for (NSString *namespace in routeControllersMap) {
         JLRoutes *routesController = routeControllersMap[namespace];
-        dictionary[namespace] = [routesController.mutableRoutes copy];
+        dictionary[namespace] = [routesController routes];
     }
     
     return [dictionary copy];
@@ -77,32 +461,47 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 
 + (instancetype)routesForScheme:(NSString *)scheme
 {
-    JLRoutes *routesController = nil;
+    JLRRouteControllers *routeControllers = [JLRRouteControllers sharedControllers];
+    JLRoutes *routesController = [routeControllers.table objectForScheme:scheme];
     
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        routeControllersMap = [[NSMutableDictionary alloc] init];
-    });
+    if (routesController != nil) {
+        return routesController;
+    }
+    
+    pthread_mutex_lock(&routeControllersLock);
     
-    if (!routeControllersMap[scheme]) {
+    // another thread may have created it in the meantime
+    routesController = [routeControllers.table objectForScheme:scheme];
+    
+    if (routesController == nil) {
+        // schemes are interned here, the global one as JLRoutesGlobalRoutesScheme itself so it can be told apart by identity
+        BOOL isGlobalScheme = [scheme caseInsensitiveCompare:JLRoutesGlobalRoutesScheme] == NSOrderedSame;
+        NSString *internedScheme = isGlobalScheme ? JLRoutesGlobalRoutesScheme : [scheme copy];
+        
         routesController = [[self alloc] init];
-        routesController.scheme = scheme;
-        routeControllersMap[scheme] = routesController;
+        routesController.scheme = internedScheme;
+        routeControllers.table = [routeControllers.table tableBySettingObject:routesController forScheme:internedScheme];
     }
     
-    routesController = routeControllersMap[scheme];
+    pthread_mutex_unlock(&routeControllersLock);
     
     return routesController;
 }
 
 + (void)unregisterRouteScheme:(NSString *)scheme
 {
-    [routeControllersMap removeObjectForKey:scheme];
+    JLRRouteControllers *routeControllers = [JLRRouteControllers sharedControllers];
+    
+    pthread_mutex_lock(&routeControllersLock);
+    routeControllers.table = [routeControllers.table tableByRemovingScheme:scheme];
+    pthread_mutex_unlock(&routeControllersLock);
 }
 
 + (void)unregisterAllRouteSchemes
 {
-    [routeControllersMap removeAllObjects];
+    pthread_mutex_lock(&routeControllersLock);
+    [JLRRouteControllers sharedControllers].table = [[JLRSchemeTable alloc] init];
+    pthread_mutex_unlock(&routeControllersLock);
 }
 
 
@@ -110,7 +509,12 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 
 - (void)addRoute:(JLRRouteDefinition *)routeDefinition
 {
-    [self _registerRoute:routeDefinition];
+    [self _registerRoutes:@[routeDefinition]];
+}
+
+- (void)addRouteDefinitions:(NSArray <JLRRouteDefinition *> *)routeDefinitions
+{
+    [self _registerRoutes:routeDefinitions];
 }
 
 - (void)addRoute:(NSString *)routePattern handler:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock
@@ -120,27 +524,46 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 
 - (void)addRoutes:(NSArray<NSString *> *)routePatterns handler:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock
 {
+    NSMutableArray <JLRRouteDefinition *> *routes = [NSMutableArray array];
+    
     for (NSString *routePattern in routePatterns) {
-        [self addRoute:routePattern handler:handlerBlock];
+        [routes addObjectsFromArray:[self _routeDefinitionsForPattern:routePattern priority:0 handler:handlerBlock asyncHandler:nil]];
     }
+    
+    [self _registerRoutes:routes];
 }
 
 - (void)addRoute:(NSString *)routePattern priority:(NSUInteger)priority handler:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock
 {
-    NSArray <NSString *> *optionalRoutePatterns = [JLRParsingUtilities expandOptionalRoutePatternsForPattern:routePattern];
-    JLRRouteDefinition *route = [[JLRRouteDefinition alloc] initWithScheme:self.scheme pattern:routePattern priority:priority handlerBlock:handlerBlock];
+    [self _registerRoutes:[self _routeDefinitionsForPattern:routePattern priority:priority handler:handlerBlock asyncHandler:nil]];
+}
+
+- (void)addRoute:(NSString *)routePattern asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))handlerBlock
+{
+    [self addRoute:routePattern priority:0 asyncHandler:handlerBlock];
+}
+
+- (void)addRoute:(NSString *)routePattern priority:(NSUInteger)priority asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))handlerBlock
+{
+    [self _registerRoutes:[self _routeDefinitionsForPattern:routePattern priority:priority handler:nil asyncHandler:handlerBlock]];
+}
+
+- (void)performBatchUpdates:(void (NS_NOESCAPE ^)(void))updates
+{
+    pthread_mutex_lock(&_routesLock);
+    self.batchUpdateDepth++;
+    pthread_mutex_unlock(&_routesLock);
     
-    if (optionalRoutePatterns.count > 0) {
-        // there are optional params, parse and add them
-        for (NSString *pattern in optionalRoutePatterns) {
-            [self _verboseLog:@"Automatically created optional route: %@", route];
-            JLRRouteDefinition *optionalRoute = [[JLRRouteDefinition alloc] initWithScheme:self.scheme pattern:pattern priority:priority handlerBlock:handlerBlock];
-            [self _registerRoute:optionalRoute];
-        }
-        return;
-    }
+    updates();
     
-    [self _registerRoute:route];
+    pthread_mutex_lock(&_routesLock);
+    self.batchUpdateDepth--;
+    if (self.batchUpdateDepth == 0 && self.pendingRoutes.count > 0) {
+        NSArray <JLRRouteDefinition *> *pendingRoutes = [self.pendingRoutes copy];
+        [self.pendingRoutes removeAllObjects];
+        [self _addRoutesLocked:pendingRoutes];
+    }
+    pthread_mutex_unlock(&_routesLock);
 }
 
 - (void)removeRoute:(NSString *)routePattern
@@ -149,10 +572,12 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
         routePattern = [NSString stringWithFormat:@"/%@", routePattern];
     }
     
+    pthread_mutex_lock(&_routesLock);
+    
     NSInteger routeIndex = NSNotFound;
     NSInteger index = 0;
     
-    for (JLRRouteDefinition *route in [self.mutableRoutes copy]) {
+    for (JLRRouteDefinition *route in self.mutableRoutes) {
         if ([route.pattern isEqualToString:routePattern]) {
             routeIndex = index;
             break;
@@ -161,13 +586,34 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
     }
     
     if (routeIndex != NSNotFound) {
+        JLRRouteDefinition *route = self.mutableRoutes[(NSUInteger)routeIndex];
         [self.mutableRoutes removeObjectAtIndex:(NSUInteger)routeIndex];
+        [self _unindexRoute:route];
+        [self.routeTrie removeRoute:route];
+        [self _routesDidChange];
+    } else {
+        // it may not have been added yet
+        for (JLRRouteDefinition *route in self.pendingRoutes) {
+            if ([route.pattern isEqualToString:routePattern]) {
+                [self.pendingRoutes removeObjectIdenticalTo:route];
+                break;
+            }
+        }
     }
+    
+    pthread_mutex_unlock(&_routesLock);
 }
 
 - (void)removeAllRoutes
 {
+    pthread_mutex_lock(&_routesLock);
     [self.mutableRoutes removeAllObjects];
+    [self.pendingRoutes removeAllObjects];
+    [self.routesByPathComponentCount removeAllObjects];
+    [self.variableLengthRoutes removeAllObjects];
+    [self.routeTrie removeAllRoutes];
+    [self _routesDidChange];
+    pthread_mutex_unlock(&_routesLock);
 }
 
 - (void)setObject:(id)handlerBlock forKeyedSubscript:(NSString *)routePatten
@@ -177,157 +623,1239 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 
 - (NSArray <JLRRouteDefinition *> *)routes;
 {
-    return [self.mutableRoutes copy];
+    return [self _currentSnapshot].routes;
 }
 
-#pragma mark - Routing URLs
-
-+ (BOOL)canRouteURL:(NSURL *)URL
+- (void)setUsesCompiledMatcher:(BOOL)usesCompiledMatcher
 {
-    return [[self _routesControllerForURL:URL] canRouteURL:URL];
+    pthread_mutex_lock(&_routesLock);
+    
+    if (usesCompiledMatcher != _usesCompiledMatcher) {
+        _usesCompiledMatcher = usesCompiledMatcher;
+        
+        if (usesCompiledMatcher) {
+            // compile the routes registered so far, in order, so the trie agrees with mutableRoutes
+            self.routeTrie = [[JLRRouteTrie alloc] init];
+            for (JLRRouteDefinition *route in self.mutableRoutes) {
+                [self.routeTrie addRoute:route];
+            }
+        } else {
+            self.routeTrie = nil;
+        }
+        
+        [self _routesDidChange];
+    }
+    
+    pthread_mutex_unlock(&_routesLock);
 }
 
-- (BOOL)canRouteURL:(NSURL *)URL
+- (void)setResultCacheCapacity:(NSUInteger)resultCacheCapacity
 {
-    return [self _routeURL:URL withParameters:nil executeRouteBlock:NO];
+    pthread_mutex_lock(&_routesLock);
+    
+    if (resultCacheCapacity != _resultCacheCapacity) {
+        _resultCacheCapacity = resultCacheCapacity;
+        self.resultCache = resultCacheCapacity > 0 ? [[JLRRouteResultCache alloc] initWithCapacity:resultCacheCapacity] : nil;
+    }
+    
+    pthread_mutex_unlock(&_routesLock);
 }
 
-+ (BOOL)routeURL:(NSURL *)URL
+- (void)setRejectedURLCacheCapacity:(NSUInteger)rejectedURLCacheCapacity
 {
-    return [[self _routesControllerForURL:URL] routeURL:URL];
+    pthread_mutex_lock(&_routesLock);
+    
+    if (rejectedURLCacheCapacity != _rejectedURLCacheCapacity) {
+        _rejectedURLCacheCapacity = rejectedURLCacheCapacity;
+        self.rejectedURLCache = rejectedURLCacheCapacity > 0 ? [[JLRRouteResultCache alloc] initWithCapacity:rejectedURLCacheCapacity] : nil;
+    }
+    
+    pthread_mutex_unlock(&_routesLock);
 }
 
-- (BOOL)routeURL:(NSURL *)URL
+- (NSUInteger)resultCacheHitCount
 {
-    return [self _routeURL:URL withParameters:nil executeRouteBlock:YES];
+    return self.resultCache.hitCount;
 }
 
-+ (BOOL)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters
+- (NSUInteger)resultCacheMissCount
 {
-    return [[self _routesControllerForURL:URL] routeURL:URL withParameters:parameters];
+    return self.resultCache.missCount;
 }
 
-- (BOOL)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters
-{
-    return [self _routeURL:URL withParameters:parameters executeRouteBlock:YES];
-}
 
+#pragma mark - Compiled Route Tables
 
-#pragma mark - Private
+- (uint64_t)routeSetHash
+{
+    return [self _routeTableForRoutes:[self _currentSnapshot].routes].routeSetHash;
+}
 
-+ (instancetype)_routesControllerForURL:(NSURL *)URL
+- (NSData *)compiledRouteTable
 {
-    if (URL == nil) {
-        return nil;
+    NSArray <JLRRouteDefinition *> *routes = [self _currentSnapshot].routes;
+    
+    for (JLRRouteDefinition *route in routes) {
+        // custom matching can't be serialized, and only synchronous handlers can be bound when the table is loaded
+        if ([route class] != [JLRRouteDefinition class] || route.asyncHandlerBlock != nil) {
+            JLRLog(JLRLogLevelWarning, @"Can't compile a route table including %@", route);
+            return nil;
+        }
     }
     
-    return routeControllersMap[URL.scheme] ?: [JLRoutes globalRoutes];
+    return [[self _routeTableForRoutes:routes] data];
 }
 
-- (void)_registerRoute:(JLRRouteDefinition *)route
+- (BOOL)addRoutesFromCompiledRouteTable:(NSData *)routeTable routeSetHash:(uint64_t)routeSetHash handlers:(NSDictionary <NSString *, BOOL (^)(NSDictionary<NSString *, id> *parameters)> *)handlers error:(NSError **)error
 {
-    if (route.priority == 0 || self.mutableRoutes.count == 0) {
-        [self.mutableRoutes addObject:route];
-    } else {
-        NSUInteger index = 0;
-        BOOL addedRoute = NO;
-        
-        // search through existing routes looking for a lower priority route than this one
-        for (JLRRouteDefinition *existingRoute in [self.mutableRoutes copy]) {
-            if (existingRoute.priority < route.priority) {
-                // if found, add the route after it
-                [self.mutableRoutes insertObject:route atIndex:index];
-                addedRoute = YES;
-                break;
-            }
-            index++;
-        }
-        
-        // if we weren't able to find a lower priority route, this is the new lowest priority route (or same priority as self.routes.lastObject) and should just be added
-        if (!addedRoute) {
-            [self.mutableRoutes addObject:route];
+    NSError *routeTableError = nil;
+    NSArray <JLRRouteDefinition *> *routes = [self _routeDefinitionsFromCompiledRouteTable:routeTable routeSetHash:routeSetHash handlers:handlers error:&routeTableError];
+    
+    if (routes == nil) {
+        // logged regardless of verbose logging, a stale table would otherwise quietly leave the app without routes
+        JLRLog(JLRLogLevelError, @"Failed to add routes from compiled route table: %@", routeTableError.localizedFailureReason);
+        if (error != NULL) {
+            *error = routeTableError;
         }
+        return NO;
     }
+    
+    // already expanded and in routing order, so this is a single merge
+    [self _registerRoutes:routes];
+    
+    return YES;
 }
 
-- (BOOL)_routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters executeRouteBlock:(BOOL)executeRouteBlock
+#pragma mark - Analyzing Routes
+
+- (NSArray <JLRRouteConflict *> *)routeConflicts
 {
-    if (!URL) {
-        return NO;
+    return [self _conflictsInRoutes:[self _currentSnapshot].routes];
+}
+
+- (NSArray <JLRRouteDefinition *> *)removeShadowedRoutes
+{
+    pthread_mutex_lock(&_routesLock);
+    
+    NSMutableArray <JLRRouteDefinition *> *shadowedRoutes = [NSMutableArray array];
+    for (JLRRouteConflict *conflict in [self _conflictsInRoutes:[self.mutableRoutes copy]]) {
+        // a route shadowed by several earlier routes is reported once for each
+        if (conflict.type == JLRRouteConflictTypeShadowed && [shadowedRoutes indexOfObjectIdenticalTo:conflict.route] == NSNotFound) {
+            [shadowedRoutes addObject:conflict.route];
+        }
     }
     
-    [self _verboseLog:@"Trying to route URL %@", URL];
+    if (shadowedRoutes.count > 0) {
+        for (JLRRouteDefinition *route in shadowedRoutes) {
+            [self.mutableRoutes removeObjectIdenticalTo:route];
+        }
+        [self _rebuildIndexes];
+        [self _routesDidChange];
+    }
     
-    BOOL didRoute = NO;
-    JLRRouteRequest *request = [[JLRRouteRequest alloc] initWithURL:URL alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent];
+    pthread_mutex_unlock(&_routesLock);
     
-    for (JLRRouteDefinition *route in [self.mutableRoutes copy]) {
-        // check each route for a matching response
-        JLRRouteResponse *response = [route routeResponseForRequest:request decodePlusSymbols:shouldDecodePlusSymbols];
-        if (!response.isMatch) {
-            continue;
+    return [shadowedRoutes copy];
+}
+
+#pragma mark - Routing URLs
+
++ (BOOL)canRouteURL:(NSURL *)URL
+{
+    return [[self _routesControllerForURL:URL] canRouteURL:URL];
+}
+
+- (BOOL)canRouteURL:(NSURL *)URL
+{
+    return [self _routeURL:URL withParameters:nil executeRouteBlock:NO];
+}
+
++ (BOOL)routeURL:(NSURL *)URL
+{
+    return [[self _routesControllerForURL:URL] routeURL:URL];
+}
+
+- (BOOL)routeURL:(NSURL *)URL
+{
+    return [self _routeURL:URL withParameters:nil executeRouteBlock:YES];
+}
+
++ (BOOL)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters
+{
+    return [[self _routesControllerForURL:URL] routeURL:URL withParameters:parameters];
+}
+
+- (BOOL)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters
+{
+    return [self _routeURL:URL withParameters:parameters executeRouteBlock:YES];
+}
+
+- (JLRRouteDefinition *)routeDefinitionMatchingURL:(NSURL *)URL
+{
+    return [self _routeDefinitionMatchingURL:URL request:NULL];
+}
+
+- (JLRRouteDefinition *)routeDefinitionMatchingURL:(NSURL *)URL variableRanges:(NSDictionary <NSString *, NSValue *> *__autoreleasing *)variableRanges
+{
+    JLRRouteRequest *request = nil;
+    JLRRouteDefinition *route = [self _routeDefinitionMatchingURL:URL request:&request];
+    
+    if (variableRanges != NULL) {
+        *variableRanges = route != nil ? [route capturedPathComponentRangesForRequest:request] : nil;
+    }
+    
+    return route;
+}
+
++ (NSArray *)routeDefinitionsMatchingURLs:(NSArray <NSURL *> *)URLs
+{
+    // the controllers table is read once for all the URLs instead of once per URL
+    JLRSchemeTable *routeControllersTable = [JLRRouteControllers sharedControllers].table;
+    JLRoutes *globalRoutes = [JLRoutes globalRoutes];
+    
+    return [self _routeDefinitionsMatchingURLs:URLs usingBlock:^JLRRouteDefinition *(NSURL *URL) {
+        JLRoutes *routesController = [routeControllersTable objectForScheme:URL.scheme] ?: globalRoutes;
+        return [routesController _routeDefinitionMatchingURL:URL request:NULL];
+    }];
+}
+
+- (NSArray *)routeDefinitionsMatchingURLs:(NSArray <NSURL *> *)URLs
+{
+    return [JLRoutes _routeDefinitionsMatchingURLs:URLs usingBlock:^JLRRouteDefinition *(NSURL *URL) {
+        return [self _routeDefinitionMatchingURL:URL request:NULL];
+    }];
+}
+
++ (void)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters queue:(dispatch_queue_t)queue completion:(void (^)(BOOL didRoute))completion
+{
+    JLRoutes *routesController = [self _routesControllerForURL:URL] ?: [JLRoutes globalRoutes];
+    [routesController routeURL:URL withParameters:parameters queue:queue completion:completion];
+}
+
+- (void)routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters queue:(dispatch_queue_t)queue completion:(void (^)(BOOL didRoute))completion
+{
+    [self _routeURL:URL request:nil withParameters:parameters queue:queue completion:^(BOOL didRoute) {
+        if (completion != nil) {
+            completion(didRoute);
+        }
+    }];
+}
+
+
+#pragma mark - Private
+
++ (instancetype)_routesControllerForURL:(NSURL *)URL
+{
+    if (URL == nil) {
+        return nil;
+    }
+    
+    return [[JLRRouteControllers sharedControllers].table objectForScheme:URL.scheme] ?: [JLRoutes globalRoutes];
+}
+
++ (NSArray *)_routeDefinitionsMatchingURLs:(NSArray <NSURL *> *)URLs usingBlock:(JLRRouteDefinition *(^)(NSURL *URL))routeDefinitionMatchingURL
+{
+    URLs = [URLs copy];
+    NSUInteger URLCount = URLs.count;
+    
+    if (URLCount == 0) {
+        return @[];
+    }
+    
+    // a few chunks per core keeps the cores busy without paying for a dispatch per URL
+    NSUInteger chunkLength = MAX(URLCount / ([NSProcessInfo processInfo].activeProcessorCount * 4), (NSUInteger)1);
+    NSUInteger chunkCount = (URLCount + chunkLength - 1) / chunkLength;
+    __strong id *results = (__strong id *)calloc(URLCount, sizeof(id));
+    
+    dispatch_apply(chunkCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t chunk) {
+        @autoreleasepool {
+            NSUInteger end = MIN(((NSUInteger)chunk + 1) * chunkLength, URLCount);
+            for (NSUInteger index = (NSUInteger)chunk * chunkLength; index < end; index++) {
+                results[index] = routeDefinitionMatchingURL(URLs[index]) ?: [NSNull null];
+            }
         }
+    });
+    
+    NSArray *routeDefinitions = [NSArray arrayWithObjects:results count:URLCount];
+    
+    for (NSUInteger index = 0; index < URLCount; index++) {
+        results[index] = nil;
+    }
+    free(results);
+    
+    return routeDefinitions;
+}
+
+- (JLRRouteDefinition *)_routeDefinitionMatchingURL:(NSURL *)URL request:(JLRRouteRequest *__autoreleasing *)request
+{
+    // like -canRouteURL:, but returning the route and without logging matches, since it may be called for many URLs at once.
+    // request is reused if it's already parsed, and is left holding the request for URL once one has been parsed.
+    if (URL == nil) {
+        return nil;
+    }
+    
+    __autoreleasing JLRRouteRequest *localRequest = nil;
+    if (request == NULL) {
+        request = &localRequest;
+    }
+    
+    JLRRoutesSnapshot *snapshot = [self _currentSnapshot];
+    JLRRouteDefinition *matchingRoute = nil;
+    
+    JLRRouteRequest *parsedRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:request measurement:NULL];
+    
+    if (parsedRequest != nil) {
+        for (JLRRouteDefinition *route in [self _candidateRoutesForRequest:parsedRequest inSnapshot:snapshot]) {
+            if ([route matchesRequest:parsedRequest decodePlusSymbols:shouldDecodePlusSymbols]) {
+                matchingRoute = route;
+                break;
+            }
+        }
+    }
+    
+    if (matchingRoute == nil && self.shouldFallbackToGlobalRoutes && ![self _isGlobalRoutesController]) {
+        // the global routes match the request already parsed here rather than parsing the URL again
+        matchingRoute = [[JLRoutes globalRoutes] _routeDefinitionMatchingURL:URL request:request];
+    }
+    
+    return matchingRoute;
+}
+
+- (NSArray <JLRRouteDefinition *> *)_routeDefinitionsForPattern:(NSString *)routePattern priority:(NSUInteger)priority handler:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))asyncHandlerBlock
+{
+    NSArray <NSString *> *optionalRoutePatterns = [JLRParsingUtilities expandOptionalRoutePatternsForPattern:routePattern];
+    
+    if (optionalRoutePatterns.count == 0) {
+        return @[[self _routeDefinitionForPattern:routePattern priority:priority handler:handlerBlock asyncHandler:asyncHandlerBlock]];
+    }
+    
+    // there are optional params, parse and add them
+    NSMutableArray <JLRRouteDefinition *> *routes = [NSMutableArray arrayWithCapacity:optionalRoutePatterns.count];
+    for (NSString *pattern in optionalRoutePatterns) {
+        JLRRouteDefinition *optionalRoute = [self _routeDefinitionForPattern:pattern priority:priority handler:handlerBlock asyncHandler:asyncHandlerBlock];
+        optionalRoute.registeredPattern = routePattern;
+        JLRLog(JLRLogLevelDebug, @"Automatically created optional route: %@", optionalRoute);
+        [routes addObject:optionalRoute];
+    }
+    
+    return routes;
+}
+
+- (JLRRouteDefinition *)_routeDefinitionForPattern:(NSString *)pattern priority:(NSUInteger)priority handler:(BOOL (^)(NSDictionary<NSString *, id> *parameters))handlerBlock asyncHandler:(void (^)(NSDictionary<NSString *, id> *parameters, void (^completion)(BOOL didRoute)))asyncHandlerBlock
+{
+    if (asyncHandlerBlock != nil) {
+        return [[JLRRouteDefinition alloc] initWithScheme:self.scheme pattern:pattern priority:priority asyncHandlerBlock:asyncHandlerBlock];
+    }
+    
+    return [[JLRRouteDefinition alloc] initWithScheme:self.scheme pattern:pattern priority:priority handlerBlock:handlerBlock];
+}
+
+- (JLRRouteTable *)_routeTableForRoutes:(NSArray <JLRRouteDefinition *> *)routes
+{
+    NSMutableArray <NSString *> *registeredPatterns = [NSMutableArray arrayWithCapacity:routes.count];
+    
+    for (JLRRouteDefinition *route in routes) {
+        [registeredPatterns addObject:route.registeredPattern ?: route.pattern];
+    }
+    
+    return [[JLRRouteTable alloc] initWithScheme:self.scheme ?: @"" routes:routes registeredPatterns:registeredPatterns];
+}
+
+- (NSArray <JLRRouteDefinition *> *)_routeDefinitionsFromCompiledRouteTable:(NSData *)data routeSetHash:(uint64_t)routeSetHash handlers:(NSDictionary <NSString *, BOOL (^)(NSDictionary<NSString *, id> *parameters)> *)handlers error:(NSError **)error
+{
+    JLRRouteTable *routeTable = [[JLRRouteTable alloc] initWithData:data error:error];
+    
+    if (routeTable == nil) {
+        return nil;
+    }
+    
+    if (![routeTable.scheme isEqualToString:self.scheme ?: @""] || routeTable.routeSetHash != routeSetHash) {
+        NSString *failureReason = [NSString stringWithFormat:@"The table was compiled for scheme %@ with route set hash %016llx, expected scheme %@ with route set hash %016llx.", routeTable.scheme, routeTable.routeSetHash, self.scheme, routeSetHash];
+        *error = [NSError errorWithDomain:JLRoutesErrorDomain code:JLRoutesErrorRouteSetHashMismatch userInfo:@{NSLocalizedDescriptionKey: @"Stale compiled route table.", NSLocalizedFailureReasonErrorKey: failureReason}];
+        return nil;
+    }
+    
+    NSUInteger routeCount = routeTable.patterns.count;
+    NSMutableArray <JLRRouteDefinition *> *routes = [NSMutableArray arrayWithCapacity:routeCount];
+    NSString *scheme = [JLRParsingUtilities internedString:self.scheme];
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        NSString *pattern = routeTable.patterns[index];
+        NSString *registeredPattern = routeTable.registeredPatterns[index];
+        BOOL (^handlerBlock)(NSDictionary<NSString *, id> *parameters) = handlers[registeredPattern];
         
-        [self _verboseLog:@"Successfully matched %@", route];
+        if (handlerBlock == nil) {
+            NSString *failureReason = [NSString stringWithFormat:@"No handler was given for %@.", registeredPattern];
+            *error = [NSError errorWithDomain:JLRoutesErrorDomain code:JLRoutesErrorMissingHandler userInfo:@{NSLocalizedDescriptionKey: @"Missing compiled route table handler.", NSLocalizedFailureReasonErrorKey: failureReason}];
+            return nil;
+        }
         
-        if (!executeRouteBlock) {
-            // if we shouldn't execute but it was a match, we're done now
-            return YES;
+        JLRRouteDefinition *route = [routeTable routeDefinitionAtIndex:index scheme:scheme handlerBlock:handlerBlock];
+        if (![registeredPattern isEqualToString:pattern]) {
+            route.registeredPattern = registeredPattern;
+        }
+        [routes addObject:route];
+    }
+    
+    return routes;
+}
+
+- (void)_registerRoutes:(NSArray <JLRRouteDefinition *> *)routes
+{
+    if (routes.count == 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&_routesLock);
+    
+    if (self.batchUpdateDepth > 0) {
+        [self.pendingRoutes addObjectsFromArray:routes];
+    } else {
+        [self _addRoutesLocked:routes];
+    }
+    
+    pthread_mutex_unlock(&_routesLock);
+}
+
+- (void)_addRoutesLocked:(NSArray <JLRRouteDefinition *> *)routes
+{
+    if (routes.count == 1) {
+        [self _insertRoute:routes.firstObject intoRoutes:self.mutableRoutes];
+        [self _indexRoute:routes.firstObject];
+        [self.routeTrie addRoute:routes.firstObject];
+    } else {
+        // sort the batch once (stable, so equal priorities keep the order they were given in) and merge it in with a single pass.
+        // a batch that's already in routing order, like the routes of a compiled route table, is merged in as it is.
+        NSArray <JLRRouteDefinition *> *sortedRoutes = routes;
+        if (![self _areRoutesInPriorityOrder:routes]) {
+            sortedRoutes = [routes sortedArrayWithOptions:NSSortStable usingComparator:^NSComparisonResult(JLRRouteDefinition *route1, JLRRouteDefinition *route2) {
+                if (route1.priority == route2.priority) {
+                    return NSOrderedSame;
+                }
+                return route1.priority > route2.priority ? NSOrderedAscending : NSOrderedDescending;
+            }];
         }
         
-        // configure the final parameters
-        NSMutableDictionary *finalParameters = [NSMutableDictionary dictionary];
-        [finalParameters addEntriesFromDictionary:response.parameters];
-        [finalParameters addEntriesFromDictionary:parameters];
-        [self _verboseLog:@"Final parameters are %@", finalParameters];
+        [self _mergeSortedRoutes:sortedRoutes intoRoutes:self.mutableRoutes];
+        [self _rebuildIndexes];
+    }
+    
+    // only with verbose logging, since it compares each added route with the routes before it
+    if (JLRShouldLog(JLRLogLevelDebug)) {
+        [self _logShadowedRoutes:routes];
+    }
+    
+    [self _routesDidChange];
+}
+
+- (void)_logShadowedRoutes:(NSArray <JLRRouteDefinition *> *)addedRoutes
+{
+    // a route can only be shadowed by an earlier one starting with the same literal or with a variable or wildcard, so each added
+    // route is only compared with those, not with every route before it
+    NSHashTable <JLRRouteDefinition *> *routesToCheck = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+    for (JLRRouteDefinition *route in addedRoutes) {
+        if ([[route class] supportsSegmentIndexing]) {
+            [routesToCheck addObject:route];
+        }
+    }
+    
+    NSMutableDictionary <NSString *, NSMutableArray <JLRRouteDefinition *> *> *earlierRoutesByFirstLiteral = [NSMutableDictionary dictionary];
+    NSMutableArray <JLRRouteDefinition *> *earlierUnkeyedRoutes = [NSMutableArray array];
+    
+    for (JLRRouteDefinition *route in self.mutableRoutes) {
+        if (routesToCheck.count == 0) {
+            break;
+        }
         
-        didRoute = [route callHandlerBlockWithParameters:finalParameters];
+        NSString *firstLiteral = [self _firstLiteralOfRoute:route];
         
-        if (didRoute) {
-            // if it was routed successfully, we're done
-            break;
+        if ([routesToCheck containsObject:route]) {
+            [routesToCheck removeObject:route];
+            
+            JLRRouteDefinition *shadowingRoute = [self _firstRouteIn:earlierUnkeyedRoutes matchingEveryURLMatchedByRoute:route];
+            if (shadowingRoute == nil && firstLiteral != nil) {
+                shadowingRoute = [self _firstRouteIn:earlierRoutesByFirstLiteral[firstLiteral] matchingEveryURLMatchedByRoute:route];
+            }
+            
+            if (shadowingRoute != nil) {
+                JLRLog(JLRLogLevelDebug, @"Route %@ is shadowed by %@ and can only be reached if its handler returns NO", route, shadowingRoute);
+            }
+        }
+        
+        if (firstLiteral == nil) {
+            [earlierUnkeyedRoutes addObject:route];
+        } else {
+            if (earlierRoutesByFirstLiteral[firstLiteral] == nil) {
+                earlierRoutesByFirstLiteral[firstLiteral] = [NSMutableArray array];
+            }
+            [earlierRoutesByFirstLiteral[firstLiteral] addObject:route];
+        }
+    }
+}
+
+- (JLRRouteDefinition *)_firstRouteIn:(NSArray <JLRRouteDefinition *> *)routes matchingEveryURLMatchedByRoute:(JLRRouteDefinition *)route
+{
+    for (JLRRouteDefinition *earlierRoute in routes) {
+        if ([earlierRoute matchesEveryURLMatchedByRouteDefinition:route]) {
+            return earlierRoute;
+        }
+    }
+    return nil;
+}
+
+- (NSArray <JLRRouteConflict *> *)_conflictsInRoutes:(NSArray <JLRRouteDefinition *> *)routes
+{
+    // unlike reordering, routes with custom matching can't be analyzed, so leave them out rather than calling everything ambiguous
+    NSMutableArray <JLRRouteDefinition *> *analyzedRoutes = [NSMutableArray arrayWithCapacity:routes.count];
+    for (JLRRouteDefinition *route in routes) {
+        if ([[route class] supportsSegmentIndexing]) {
+            [analyzedRoutes addObject:route];
+        }
+    }
+    
+    NSMutableArray <JLRRouteConflict *> *conflicts = [NSMutableArray array];
+    [self _enumerateRoutePairsThatCanMatchSameURLInRoutes:analyzedRoutes usingBlock:^(NSUInteger earlierIndex, NSUInteger laterIndex) {
+        JLRRouteDefinition *precedingRoute = analyzedRoutes[earlierIndex];
+        JLRRouteDefinition *route = analyzedRoutes[laterIndex];
+        JLRRouteConflictType type = [precedingRoute matchesEveryURLMatchedByRouteDefinition:route] ? JLRRouteConflictTypeShadowed : JLRRouteConflictTypeAmbiguous;
+        [conflicts addObject:[[JLRRouteConflict alloc] initWithType:type route:route precedingRoute:precedingRoute]];
+    }];
+    
+    return [conflicts copy];
+}
+
+- (void)_insertRoute:(JLRRouteDefinition *)route intoRoutes:(NSMutableArray <JLRRouteDefinition *> *)routes
+{
+    // route is always the most recently registered one, so this keeps any list that is in priority order in priority order
+    if (route.priority == 0 || routes.count == 0) {
+        [routes addObject:route];
+        return;
+    }
+    
+    // binary search for the first route with a lower priority than this one, and add the route before it. that's after every
+    // route with the same priority, which keeps routes of equal priority in the order they were added. if there isn't a lower
+    // priority route, this is the new lowest priority route (or same priority as routes.lastObject) and ends up last.
+    NSUInteger lowerBound = 0;
+    NSUInteger upperBound = routes.count;
+    
+    while (lowerBound < upperBound) {
+        NSUInteger middle = lowerBound + (upperBound - lowerBound) / 2;
+        if (routes[middle].priority >= route.priority) {
+            lowerBound = middle + 1;
+        } else {
+            upperBound = middle;
+        }
+    }
+    
+    [routes insertObject:route atIndex:lowerBound];
+}
+
+- (BOOL)_areRoutesInPriorityOrder:(NSArray <JLRRouteDefinition *> *)routes
+{
+    NSUInteger previousPriority = NSUIntegerMax;
+    
+    for (JLRRouteDefinition *route in routes) {
+        if (route.priority > previousPriority) {
+            return NO;
+        }
+        previousPriority = route.priority;
+    }
+    
+    return YES;
+}
+
+- (void)_mergeSortedRoutes:(NSArray <JLRRouteDefinition *> *)sortedRoutes intoRoutes:(NSMutableArray <JLRRouteDefinition *> *)routes
+{
+    // both lists are in priority order. on equal priority the existing route goes first, since it was added earlier.
+    NSMutableArray <JLRRouteDefinition *> *mergedRoutes = [NSMutableArray arrayWithCapacity:routes.count + sortedRoutes.count];
+    NSUInteger existingIndex = 0;
+    NSUInteger sortedIndex = 0;
+    
+    while (existingIndex < routes.count && sortedIndex < sortedRoutes.count) {
+        if (routes[existingIndex].priority >= sortedRoutes[sortedIndex].priority) {
+            [mergedRoutes addObject:routes[existingIndex++]];
+        } else {
+            [mergedRoutes addObject:sortedRoutes[sortedIndex++]];
+        }
+    }
+    
+    [mergedRoutes addObjectsFromArray:[routes subarrayWithRange:NSMakeRange(existingIndex, routes.count - existingIndex)]];
+    [mergedRoutes addObjectsFromArray:[sortedRoutes subarrayWithRange:NSMakeRange(sortedIndex, sortedRoutes.count - sortedIndex)]];
+    
+    [routes setArray:mergedRoutes];
+}
+
+- (BOOL)_isFixedLengthRoute:(JLRRouteDefinition *)route
+{
+    return !route.containsWildcard && [[route class] supportsSegmentIndexing];
+}
+
+- (NSUInteger)_minimumPathComponentCountForRoute:(JLRRouteDefinition *)route
+{
+    // routes with custom matching could match anything
+    return [[route class] supportsSegmentIndexing] ? route.minimumPathComponentCount : 0;
+}
+
+- (void)_indexRoute:(JLRRouteDefinition *)route
+{
+    if ([self _isFixedLengthRoute:route]) {
+        NSNumber *pathComponentCount = @(route.minimumPathComponentCount);
+        NSMutableArray <JLRRouteDefinition *> *bucket = self.routesByPathComponentCount[pathComponentCount];
+        
+        if (bucket == nil) {
+            // a new bucket starts out with the variable length routes that can match this many components, already in order
+            bucket = [NSMutableArray array];
+            for (JLRRouteDefinition *variableLengthRoute in self.variableLengthRoutes) {
+                if ([self _minimumPathComponentCountForRoute:variableLengthRoute] <= route.minimumPathComponentCount) {
+                    [bucket addObject:variableLengthRoute];
+                }
+            }
+            self.routesByPathComponentCount[pathComponentCount] = bucket;
+        }
+        
+        [self _insertRoute:route intoRoutes:bucket];
+    } else {
+        NSUInteger minimumPathComponentCount = [self _minimumPathComponentCountForRoute:route];
+        
+        [self _insertRoute:route intoRoutes:self.variableLengthRoutes];
+        
+        [self.routesByPathComponentCount enumerateKeysAndObjectsUsingBlock:^(NSNumber *pathComponentCount, NSMutableArray <JLRRouteDefinition *> *bucket, BOOL *stop) {
+            if (pathComponentCount.unsignedIntegerValue >= minimumPathComponentCount) {
+                [self _insertRoute:route intoRoutes:bucket];
+            }
+        }];
+    }
+}
+
+- (void)_rebuildIndexes
+{
+    // mutableRoutes is already in order, so appending to each bucket in that order keeps the buckets in order
+    // without any searching. all the buckets have to exist up front for the variable length routes to land in.
+    NSMutableDictionary <NSNumber *, NSMutableArray <JLRRouteDefinition *> *> *routesByPathComponentCount = [NSMutableDictionary dictionary];
+    NSMutableArray <JLRRouteDefinition *> *variableLengthRoutes = [NSMutableArray array];
+    
+    for (JLRRouteDefinition *route in self.mutableRoutes) {
+        if ([self _isFixedLengthRoute:route] && routesByPathComponentCount[@(route.minimumPathComponentCount)] == nil) {
+            routesByPathComponentCount[@(route.minimumPathComponentCount)] = [NSMutableArray array];
+        }
+    }
+    
+    for (JLRRouteDefinition *route in self.mutableRoutes) {
+        if ([self _isFixedLengthRoute:route]) {
+            [routesByPathComponentCount[@(route.minimumPathComponentCount)] addObject:route];
+        } else {
+            NSUInteger minimumPathComponentCount = [self _minimumPathComponentCountForRoute:route];
+            [variableLengthRoutes addObject:route];
+            [routesByPathComponentCount enumerateKeysAndObjectsUsingBlock:^(NSNumber *pathComponentCount, NSMutableArray <JLRRouteDefinition *> *bucket, BOOL *stop) {
+                if (pathComponentCount.unsignedIntegerValue >= minimumPathComponentCount) {
+                    [bucket addObject:route];
+                }
+            }];
+        }
+    }
+    
+    self.routesByPathComponentCount = routesByPathComponentCount;
+    self.variableLengthRoutes = variableLengthRoutes;
+    
+    if (self.routeTrie != nil) {
+        [self.routeTrie removeAllRoutes];
+        for (JLRRouteDefinition *route in self.mutableRoutes) {
+            [self.routeTrie addRoute:route];
+        }
+    }
+}
+
+- (void)_unindexRoute:(JLRRouteDefinition *)route
+{
+    // buckets left holding only variable length routes are kept, they still list the right candidates for their length
+    if ([self _isFixedLengthRoute:route]) {
+        [self _removeRoute:route fromRoutes:self.routesByPathComponentCount[@(route.minimumPathComponentCount)]];
+    } else {
+        [self _removeRoute:route fromRoutes:self.variableLengthRoutes];
+        for (NSMutableArray <JLRRouteDefinition *> *bucket in [self.routesByPathComponentCount objectEnumerator]) {
+            [self _removeRoute:route fromRoutes:bucket];
+        }
+    }
+}
+
+- (void)_removeRoute:(JLRRouteDefinition *)route fromRoutes:(NSMutableArray <JLRRouteDefinition *> *)routes
+{
+    NSUInteger index = [routes indexOfObjectIdenticalTo:route];
+    if (index != NSNotFound) {
+        [routes removeObjectAtIndex:index];
+    }
+}
+
+- (void)_noteHandledURL
+{
+    NSUInteger handledURLCount = atomic_fetch_add_explicit(&_handledURLCount, 1, memory_order_relaxed) + 1;
+    
+    // only the thread that reaches the interval starts a reorder, everyone else carries on routing
+    if (handledURLCount < MAX(self.routeOrderAdaptationInterval, 1UL) || atomic_exchange_explicit(&_handledURLCount, 0, memory_order_relaxed) == 0) {
+        return;
+    }
+    
+    if (atomic_exchange_explicit(&_isAdaptingRouteOrder, YES, memory_order_acquire)) {
+        return;
+    }
+    
+    pthread_mutex_lock(&_routesLock);
+    NSArray <JLRRouteDefinition *> *routes = [self.mutableRoutes copy];
+    NSUInteger routesGeneration = atomic_load_explicit(&_routesGeneration, memory_order_relaxed);
+    pthread_mutex_unlock(&_routesLock);
+    
+    dispatch_async(JLRRouteOrderAdaptationQueue(), ^{
+        NSArray <JLRRouteDefinition *> *reorderedRoutes = [self _routesOrderedByHitCountWithinPriorities:routes];
+        
+        for (JLRRouteDefinition *route in routes) {
+            [route halveHitCount];
+        }
+        
+        if (reorderedRoutes != nil) {
+            pthread_mutex_lock(&self->_routesLock);
+            
+            // routes added or removed in the meantime would be lost, the next interval tries again
+            if (atomic_load_explicit(&self->_routesGeneration, memory_order_relaxed) == routesGeneration) {
+                JLRLog(JLRLogLevelInfo, @"Reordered routes by hit count");
+                [self.mutableRoutes setArray:reorderedRoutes];
+                [self _rebuildIndexes];
+                [self _routesDidChange];
+            }
+            
+            pthread_mutex_unlock(&self->_routesLock);
+        }
+        
+        atomic_store_explicit(&self->_isAdaptingRouteOrder, NO, memory_order_release);
+    });
+}
+
+- (NSArray <JLRRouteDefinition *> *)_routesOrderedByHitCountWithinPriorities:(NSArray <JLRRouteDefinition *> *)routes
+{
+    // returns nil if no route can move. routes is in priority order, so every priority band is a contiguous range of it.
+    NSMutableArray <JLRRouteDefinition *> *reorderedRoutes = nil;
+    NSUInteger bandStart = 0;
+    
+    while (bandStart < routes.count) {
+        NSUInteger bandEnd = bandStart + 1;
+        while (bandEnd < routes.count && routes[bandEnd].priority == routes[bandStart].priority) {
+            bandEnd++;
+        }
+        
+        // a route alone in its band has nowhere to go
+        NSRange bandRange = NSMakeRange(bandStart, bandEnd - bandStart);
+        NSArray <JLRRouteDefinition *> *reorderedBand = bandRange.length > 1 ? [self _routesOrderedByHitCount:[routes subarrayWithRange:bandRange]] : nil;
+        
+        if (reorderedBand != nil) {
+            if (reorderedRoutes == nil) {
+                reorderedRoutes = [routes mutableCopy];
+            }
+            [reorderedRoutes replaceObjectsInRange:bandRange withObjectsFromArray:reorderedBand];
+        }
+        
+        bandStart = bandEnd;
+    }
+    
+    return reorderedRoutes;
+}
+
+- (NSArray <JLRRouteDefinition *> *)_routesOrderedByHitCount:(NSArray <JLRRouteDefinition *> *)routes
+{
+    // returns nil if routes (all of the same priority) are already in the best order they can be in
+    NSUInteger routeCount = routes.count;
+    NSUInteger *hitCounts = calloc(routeCount, sizeof(NSUInteger));
+    BOOL isSorted = YES;
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        hitCounts[index] = routes[index].hitCount;
+        if (index > 0 && hitCounts[index] > hitCounts[index - 1]) {
+            isSorted = NO;
+        }
+    }
+    
+    if (isSorted) {
+        free(hitCounts);
+        return nil;
+    }
+    
+    // a route can't move ahead of an earlier route it could share a URL with
+    NSMutableArray <NSMutableArray <NSNumber *> *> *laterAmbiguousIndexes = [NSMutableArray arrayWithCapacity:routeCount];
+    NSUInteger *earlierAmbiguousCounts = calloc(routeCount, sizeof(NSUInteger));
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        [laterAmbiguousIndexes addObject:[NSMutableArray array]];
+    }
+    
+    [self _enumerateRoutePairsThatCanMatchSameURLInRoutes:routes usingBlock:^(NSUInteger earlierIndex, NSUInteger laterIndex) {
+        [laterAmbiguousIndexes[earlierIndex] addObject:@(laterIndex)];
+        earlierAmbiguousCounts[laterIndex]++;
+    }];
+    
+    // repeatedly take the most hit route that no earlier ambiguous route is still waiting in front of, the earliest one on a tie
+    NSMutableArray <JLRRouteDefinition *> *orderedRoutes = [NSMutableArray arrayWithCapacity:routeCount];
+    BOOL *isPlaced = calloc(routeCount, sizeof(BOOL));
+    
+    while (orderedRoutes.count < routeCount) {
+        NSUInteger bestIndex = NSNotFound;
+        for (NSUInteger index = 0; index < routeCount; index++) {
+            if (!isPlaced[index] && earlierAmbiguousCounts[index] == 0 && (bestIndex == NSNotFound || hitCounts[index] > hitCounts[bestIndex])) {
+                bestIndex = index;
+            }
+        }
+        
+        isPlaced[bestIndex] = YES;
+        [orderedRoutes addObject:routes[bestIndex]];
+        
+        for (NSNumber *laterIndex in laterAmbiguousIndexes[bestIndex]) {
+            earlierAmbiguousCounts[laterIndex.unsignedIntegerValue]--;
+        }
+    }
+    
+    free(hitCounts);
+    free(earlierAmbiguousCounts);
+    free(isPlaced);
+    
+    return [orderedRoutes isEqualToArray:routes] ? nil : orderedRoutes;
+}
+
+- (void)_enumerateRoutePairsThatCanMatchSameURLInRoutes:(NSArray <JLRRouteDefinition *> *)routes usingBlock:(void (NS_NOESCAPE ^)(NSUInteger earlierIndex, NSUInteger laterIndex))block
+{
+    // only routes starting with the same literal, or with a variable or wildcard or custom matching, can share a URL, which saves
+    // comparing most pairs of routes
+    NSMutableDictionary <NSString *, NSMutableArray <NSNumber *> *> *indexesByFirstLiteral = [NSMutableDictionary dictionary];
+    NSMutableArray <NSNumber *> *unkeyedIndexes = [NSMutableArray array];
+    
+    for (NSUInteger index = 0; index < routes.count; index++) {
+        JLRRouteDefinition *route = routes[index];
+        NSString *firstLiteral = [self _firstLiteralOfRoute:route];
+        NSMutableArray <NSNumber *> *earlierIndexes = [unkeyedIndexes mutableCopy];
+        
+        if (firstLiteral == nil) {
+            for (NSArray <NSNumber *> *keyedIndexes in [indexesByFirstLiteral objectEnumerator]) {
+                [earlierIndexes addObjectsFromArray:keyedIndexes];
+            }
+            [unkeyedIndexes addObject:@(index)];
+        } else {
+            [earlierIndexes addObjectsFromArray:indexesByFirstLiteral[firstLiteral]];
+            if (indexesByFirstLiteral[firstLiteral] == nil) {
+                indexesByFirstLiteral[firstLiteral] = [NSMutableArray array];
+            }
+            [indexesByFirstLiteral[firstLiteral] addObject:@(index)];
+        }
+        
+        // in order, so each later route sees its earlier routes in the order they're tried
+        [earlierIndexes sortUsingSelector:@selector(compare:)];
+        
+        for (NSNumber *earlierIndex in earlierIndexes) {
+            if ([routes[earlierIndex.unsignedIntegerValue] canMatchSameURLAsRouteDefinition:route]) {
+                block(earlierIndex.unsignedIntegerValue, index);
+            }
+        }
+    }
+}
+
+- (NSString *)_firstLiteralOfRoute:(JLRRouteDefinition *)route
+{
+    if (![[route class] supportsSegmentIndexing] || route.minimumPathComponentCount == 0 || route.segments[0].type != JLRRouteSegmentTypeLiteral) {
+        return nil;
+    }
+    return route.segments[0].value;
+}
+
+- (NSArray <JLRRouteDefinition *> *)_candidateRoutesForRequest:(JLRRouteRequest *)request inSnapshot:(JLRRoutesSnapshot *)snapshot
+{
+    if (snapshot.routeTrie != nil) {
+        // with the compiled matcher, only the routes whose pattern can fit the request's path components need to be tried
+        return [snapshot.routeTrie candidateRoutesForPathComponents:request.pathComponents];
+    }
+    
+    // otherwise skip every route that can't match this many path components
+    return snapshot.routesByPathComponentCount[@(request.pathComponents.count)] ?: snapshot.variableLengthRoutes;
+}
+
+- (JLRRoutesSnapshot *)_currentSnapshot
+{
+    JLRRoutesSnapshot *snapshot = self.snapshot;
+    
+    if (snapshot == nil) {
+        // the routes changed since the last snapshot, take a new one. it's published for every later reader, so this only
+        // happens once per change no matter how many threads are routing.
+        pthread_mutex_lock(&_routesLock);
+        snapshot = self.snapshot;
+        if (snapshot == nil) {
+            snapshot = [[JLRRoutesSnapshot alloc] initWithRoutes:self.mutableRoutes routesByPathComponentCount:self.routesByPathComponentCount variableLengthRoutes:self.variableLengthRoutes routeTrie:self.routeTrie];
+            self.snapshot = snapshot;
+        }
+        pthread_mutex_unlock(&_routesLock);
+    }
+    
+    return snapshot;
+}
+
+- (void)_routesDidChange
+{
+    atomic_fetch_add_explicit(&_routesGeneration, 1, memory_order_relaxed);
+    self.snapshot = nil;
+    [self.resultCache removeAllObjects];
+    [self.rejectedURLCache removeAllObjects];
+}
+
+- (BOOL)_routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters executeRouteBlock:(BOOL)executeRouteBlock
+{
+    JLRRouteRequest *request = nil;
+    return [self _routeURL:URL withParameters:parameters executeRouteBlock:executeRouteBlock request:&request];
+}
+
+- (BOOL)_routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters executeRouteBlock:(BOOL)executeRouteBlock request:(JLRRouteRequest *__autoreleasing *)request
+{
+    // the URL is only parsed once, by whichever controller needs it first, and request hands it on to the global routes
+    if (!URL) {
+        return NO;
+    }
+    
+    JLRLog(JLRLogLevelDebug, @"Trying to route URL %@", URL);
+    
+    BOOL didRoute = NO;
+    JLRRoutesSnapshot *snapshot = [self _currentSnapshot];
+    JLRRouteResultCache *resultCache = self.resultCache;
+    
+    // nothing gets measured unless instrumentation is on or someone wants the metrics
+    void (^routingMetricsHandler)(JLRoutes *, JLRRoutingMetrics *) = executeRouteBlock ? self.routingMetricsHandler : nil;
+    JLRRoutingMeasurement measurementStorage = {0};
+    JLRRoutingMeasurement *measurement = (instrumentationEnabled || routingMetricsHandler != nil) ? &measurementStorage : NULL;
+    
+    // the caches are checked before anything is parsed, and the request is only built if they can't answer
+    if (!executeRouteBlock) {
+        didRoute = [self _canRouteURL:URL inSnapshot:snapshot request:request measurement:measurement];
+    } else if (resultCache != nil) {
+        didRoute = [self _routeURL:URL withParameters:parameters inSnapshot:snapshot resultCache:resultCache request:request measurement:measurement];
+    } else {
+        JLRRouteRequest *parsedRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:request measurement:measurement];
+        if (parsedRequest != nil) {
+            NSArray <JLRRouteDefinition *> *candidateRoutes = [self _candidateRoutesForRequest:parsedRequest inSnapshot:snapshot];
+            didRoute = [self _routeRequest:parsedRequest withParameters:parameters candidateRoutes:candidateRoutes fromIndex:0 executeRouteBlock:executeRouteBlock resultCacheEntry:nil measurement:measurement];
         }
     }
     
     if (!didRoute) {
-        [self _verboseLog:@"Could not find a matching route"];
+        JLRLog(JLRLogLevelInfo, @"Could not find a matching route");
+    } else if (executeRouteBlock && self.adaptsRouteOrder) {
+        [self _noteHandledURL];
+    }
+    
+    if (routingMetricsHandler != nil) {
+        JLRRoutingMetrics *metrics = [[JLRRoutingMetrics alloc] initWithURL:URL didRoute:didRoute matchedRoute:measurement->matchedRoute attemptCount:measurement->attemptCount parseDuration:JLRTimeIntervalFromMachTime(measurement->parseTime) matchDuration:JLRTimeIntervalFromMachTime(measurement->matchTime) handlerDuration:JLRTimeIntervalFromMachTime(measurement->handlerTime)];
+        routingMetricsHandler(self, metrics);
     }
     
     // if we couldn't find a match and this routes controller specifies to fallback and its also not the global routes controller, then...
     if (!didRoute && self.shouldFallbackToGlobalRoutes && ![self _isGlobalRoutesController]) {
-        [self _verboseLog:@"Falling back to global routes..."];
-        didRoute = [[JLRoutes globalRoutes] _routeURL:URL withParameters:parameters executeRouteBlock:executeRouteBlock];
+        JLRLog(JLRLogLevelDebug, @"Falling back to global routes...");
+        didRoute = [[JLRoutes globalRoutes] _routeURL:URL withParameters:parameters executeRouteBlock:executeRouteBlock request:request];
     }
     
     // if, after everything, we did not route anything and we have an unmatched URL handler, then call it
     if (!didRoute && executeRouteBlock && self.unmatchedURLHandler) {
-        [self _verboseLog:@"Falling back to the unmatched URL handler"];
+        JLRLog(JLRLogLevelDebug, @"Falling back to the unmatched URL handler");
         self.unmatchedURLHandler(self, URL, parameters);
     }
     
     return didRoute;
 }
 
-- (BOOL)_isGlobalRoutesController
+- (BOOL)_canRouteURL:(NSURL *)URL inSnapshot:(JLRRoutesSnapshot *)snapshot request:(JLRRouteRequest *__autoreleasing *)request measurement:(JLRRoutingMeasurement *)measurement
 {
-    return [self.scheme isEqualToString:JLRoutesGlobalRoutesScheme];
+    JLRRouteResultCache *rejectedURLCache = self.rejectedURLCache;
+    NSString *cacheKey = [URL absoluteString];
+    
+    if (rejectedURLCache != nil) {
+        JLRRouteResultCacheEntry *entry = [rejectedURLCache objectForKey:cacheKey passingTest:^BOOL(JLRRouteResultCacheEntry *cachedEntry) {
+            return [cachedEntry isValidForSnapshot:snapshot];
+        }];
+        
+        if (entry != nil) {
+            JLRLog(JLRLogLevelDebug, @"Recently found that no route matches %@", URL);
+            return NO;
+        }
+    }
+    
+    JLRRouteRequest *parsedRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:request measurement:measurement];
+    if (parsedRequest == nil) {
+        // ruled out without parsing anything, which is cheaper than remembering it
+        return NO;
+    }
+    
+    NSArray <JLRRouteDefinition *> *candidateRoutes = [self _candidateRoutesForRequest:parsedRequest inSnapshot:snapshot];
+    BOOL canRoute = [self _routeRequest:parsedRequest withParameters:nil candidateRoutes:candidateRoutes fromIndex:0 executeRouteBlock:NO resultCacheEntry:nil measurement:measurement];
+    
+    if (!canRoute && rejectedURLCache != nil) {
+        // an entry without any matches
+        [rejectedURLCache setObject:[[JLRRouteResultCacheEntry alloc] initWithSnapshot:snapshot] forKey:cacheKey];
+    }
+    
+    return canRoute;
+}
+
+- (BOOL)_routeURL:(NSURL *)URL withParameters:(NSDictionary *)parameters inSnapshot:(JLRRoutesSnapshot *)snapshot resultCache:(JLRRouteResultCache *)resultCache request:(JLRRouteRequest *__autoreleasing *)request measurement:(JLRRoutingMeasurement *)measurement
+{
+    NSString *cacheKey = [URL absoluteString];
+    JLRRouteResultCacheEntry *entry = [resultCache objectForKey:cacheKey passingTest:^BOOL(JLRRouteResultCacheEntry *cachedEntry) {
+        return [cachedEntry isValidForSnapshot:snapshot];
+    }];
+    
+    if (entry == nil) {
+        // route it the long way, recording every match along the way
+        JLRRouteRequest *parsedRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:request measurement:measurement];
+        if (parsedRequest == nil) {
+            return NO;
+        }
+        
+        entry = [[JLRRouteResultCacheEntry alloc] initWithSnapshot:snapshot];
+        NSArray <JLRRouteDefinition *> *candidateRoutes = [self _candidateRoutesForRequest:parsedRequest inSnapshot:snapshot];
+        BOOL didRoute = [self _routeRequest:parsedRequest withParameters:parameters candidateRoutes:candidateRoutes fromIndex:0 executeRouteBlock:YES resultCacheEntry:entry measurement:measurement];
+        [resultCache setObject:entry forKey:cacheKey];
+        return didRoute;
+    }
+    
+    JLRLog(JLRLogLevelDebug, @"Found cached matches for %@", URL);
+    
+    // the matches are already known, so there's no request to parse and no routes to try until they run out
+    for (NSUInteger index = 0; index < entry.matchedRoutes.count; index++) {
+        JLRRouteDefinition *route = entry.matchedRoutes[index];
+        NSDictionary *matchParameters = [JLRParameterDictionary dictionaryByLayeringDictionaries:@[@{JLRouteURLKey: URL}, entry.matchedParameters[index]]];
+        
+        JLRLog(JLRLogLevelInfo, @"Successfully matched %@", route);
+        
+        if (instrumentationEnabled) {
+            // remembered matches still count, or the hottest routes would look unused
+            [route recordAttemptDidMatch:YES];
+        }
+        
+        if ([self _callHandlerForRoute:route withMatchParameters:matchParameters parameters:parameters measurement:measurement]) {
+            return YES;
+        }
+    }
+    
+    if (entry.resumeIndex == NSNotFound) {
+        return NO;
+    }
+    
+    // every handler that took the URL last time turned it down now, carry on where that routing stopped
+    JLRRouteRequest *parsedRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:request measurement:measurement];
+    NSArray <JLRRouteDefinition *> *candidateRoutes = [self _candidateRoutesForRequest:parsedRequest inSnapshot:snapshot];
+    return [self _routeRequest:parsedRequest withParameters:parameters candidateRoutes:candidateRoutes fromIndex:entry.resumeIndex executeRouteBlock:YES resultCacheEntry:nil measurement:measurement];
+}
+
+- (BOOL)_routeRequest:(JLRRouteRequest *)request withParameters:(NSDictionary *)parameters candidateRoutes:(NSArray <JLRRouteDefinition *> *)candidateRoutes fromIndex:(NSUInteger)startIndex executeRouteBlock:(BOOL)executeRouteBlock resultCacheEntry:(JLRRouteResultCacheEntry *)resultCacheEntry measurement:(JLRRoutingMeasurement *)measurement
+{
+    uint64_t matchStartTime = JLRBeginRoutingPhase(measurement, JLRRoutingPhaseMatch);
+    
+    for (NSUInteger index = startIndex; index < candidateRoutes.count; index++) {
+        JLRRouteDefinition *route = candidateRoutes[index];
+        
+        if (!executeRouteBlock) {
+            // nothing is going to use the parameters, so just check for a match and leave the query alone
+            BOOL matches = [route matchesRequest:request decodePlusSymbols:shouldDecodePlusSymbols];
+            JLRRecordRouteAttempt(measurement, route, matches);
+            
+            if (matches) {
+                JLRLog(JLRLogLevelInfo, @"Successfully matched %@", route);
+                JLREndRoutingPhase(measurement, JLRRoutingPhaseMatch, matchStartTime);
+                return YES;
+            }
+            continue;
+        }
+        
+        // check each route for a matching response
+        JLRRouteResponse *response = [route routeResponseForRequest:request decodePlusSymbols:shouldDecodePlusSymbols];
+        JLRRecordRouteAttempt(measurement, route, response.isMatch);
+        
+        if (!response.isMatch) {
+            continue;
+        }
+        
+        JLRLog(JLRLogLevelInfo, @"Successfully matched %@", route);
+        
+        [resultCacheEntry.matchedRoutes addObject:route];
+        [resultCacheEntry.matchedParameters addObject:response.parameters ?: @{}];
+        resultCacheEntry.resumeIndex = index + 1;
+        
+        // the handler's time isn't matching time
+        JLREndRoutingPhase(measurement, JLRRoutingPhaseMatch, matchStartTime);
+        
+        if ([self _callHandlerForRoute:route withMatchParameters:response.parameters parameters:parameters measurement:measurement]) {
+            // if it was routed successfully, we're done
+            return YES;
+        }
+        
+        matchStartTime = JLRBeginRoutingPhase(measurement, JLRRoutingPhaseMatch);
+    }
+    
+    JLREndRoutingPhase(measurement, JLRRoutingPhaseMatch, matchStartTime);
+    
+    // every match has been found now
+    resultCacheEntry.resumeIndex = NSNotFound;
+    
+    return NO;
+}
+
+- (BOOL)_callHandlerForRoute:(JLRRouteDefinition *)route withMatchParameters:(NSDictionary *)matchParameters parameters:(NSDictionary *)parameters measurement:(JLRRoutingMeasurement *)measurement
+{
+    NSDictionary *finalParameters = [self _finalParametersForMatchParameters:matchParameters parameters:parameters];
+    
+    uint64_t handlerStartTime = JLRBeginRoutingPhase(measurement, JLRRoutingPhaseHandler);
+    BOOL didRoute = [route callHandlerBlockWithParameters:finalParameters];
+    JLREndRoutingPhase(measurement, JLRRoutingPhaseHandler, handlerStartTime);
+    
+    if (didRoute && measurement != NULL) {
+        measurement->matchedRoute = route;
+    }
+    
+    if (didRoute && self.adaptsRouteOrder) {
+        [route recordHit];
+    }
+    
+    return didRoute;
 }
 
-- (void)_verboseLog:(NSString *)format, ...
+- (JLRRouteRequest *)_requestForURL:(NSURL *)URL inSnapshot:(JLRRoutesSnapshot *)snapshot parsedRequest:(JLRRouteRequest *__autoreleasing *)parsedRequest measurement:(JLRRoutingMeasurement *)measurement
 {
-    if (!verboseLoggingEnabled || format.length == 0) {
+    // nil if the snapshot's first path component filter rules the URL out. a request another controller already parsed
+    // for URL is good for this one too, the parsing options are global.
+    JLRRouteRequest *request = *parsedRequest;
+    
+    if (request != nil) {
+        // checked by the hash taken when the request was tokenized, so the URL isn't tokenized again. a request the
+        // scheme's routes turned down only splits up its path if this one gets to match it.
+        request = [snapshot mayMatchRequest:request] ? request : nil;
+    } else {
+        // the filter is checked while the URL is tokenized, so a URL that passes isn't tokenized again for the request.
+        // one that doesn't is still handed on to the global routes when they're next, with the hash they need to test it.
+        JLRRouteRequest *__autoreleasing rejectedRequest = nil;
+        BOOL fallsBackToGlobalRoutes = self.shouldFallbackToGlobalRoutes && ![self _isGlobalRoutesController];
+        
+        uint64_t parseStartTime = JLRBeginRoutingPhase(measurement, JLRRoutingPhaseParse);
+        request = [JLRRouteRequest requestWithURL:URL alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent passingFirstPathComponentTest:^BOOL(NSUInteger firstPathComponentHash) {
+            return [snapshot mayMatchFirstPathComponentHash:firstPathComponentHash];
+        } rejectedRequest:(fallsBackToGlobalRoutes ? &rejectedRequest : NULL)];
+        JLREndRoutingPhase(measurement, JLRRoutingPhaseParse, parseStartTime);
+        
+        *parsedRequest = request ?: rejectedRequest;
+    }
+    
+    if (request == nil) {
+        JLRLog(JLRLogLevelDebug, @"No route can match the first path component of %@", URL);
+    }
+    
+    return request;
+}
+
+- (NSDictionary *)_finalParametersForMatchParameters:(NSDictionary *)matchParameters parameters:(NSDictionary *)parameters
+{
+    // configure the final parameters, the ones passed in win over the matched ones
+    NSDictionary *finalParameters = [JLRParameterDictionary dictionaryByLayeringDictionaries:@[parameters ?: @{}, matchParameters ?: @{}]];
+    JLRLog(JLRLogLevelDebug, @"Final parameters are %@", finalParameters);
+    
+    return finalParameters;
+}
+
+- (void)_routeURL:(NSURL *)URL request:(JLRRouteRequest *)parsedRequest withParameters:(NSDictionary *)parameters queue:(dispatch_queue_t)queue completion:(void (^)(BOOL didRoute))completion
+{
+    // the asynchronous counterpart of -_routeURL:withParameters:executeRouteBlock:request:, completion is called on queue
+    if (!URL) {
+        dispatch_async(queue, ^{
+            completion(NO);
+        });
         return;
     }
     
-    va_list argsList;
-    va_start(argsList, format);
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
-    NSString *formattedLogMessage = [[NSString alloc] initWithFormat:format arguments:argsList];
-#pragma clang diagnostic pop
+    dispatch_async(JLRRoutingQueue(), ^{
+        JLRLog(JLRLogLevelDebug, @"Trying to route URL %@ asynchronously", URL);
+        
+        JLRRoutesSnapshot *snapshot = [self _currentSnapshot];
+        JLRRouteRequest *request = parsedRequest;
+        JLRRouteRequest *matchingRequest = [self _requestForURL:URL inSnapshot:snapshot parsedRequest:&request measurement:NULL];
+        NSArray <JLRRouteDefinition *> *candidateRoutes = matchingRequest != nil ? [self _candidateRoutesForRequest:matchingRequest inSnapshot:snapshot] : @[];
+        
+        [self _routeRequest:request withParameters:parameters candidateRoutes:candidateRoutes fromIndex:0 queue:queue completion:^(BOOL didRoute) {
+            if (didRoute) {
+                completion(YES);
+                return;
+            }
+            
+            JLRLog(JLRLogLevelInfo, @"Could not find a matching route");
+            
+            void (^finish)(BOOL) = ^(BOOL fallbackDidRoute) {
+                if (!fallbackDidRoute && self.unmatchedURLHandler) {
+                    JLRLog(JLRLogLevelDebug, @"Falling back to the unmatched URL handler");
+                    self.unmatchedURLHandler(self, URL, parameters);
+                }
+                completion(fallbackDidRoute);
+            };
+            
+            if (self.shouldFallbackToGlobalRoutes && ![self _isGlobalRoutesController]) {
+                JLRLog(JLRLogLevelDebug, @"Falling back to global routes...");
+                [[JLRoutes globalRoutes] _routeURL:URL request:request withParameters:parameters queue:queue completion:finish];
+            } else {
+                finish(NO);
+            }
+        }];
+    });
+}
+
+- (void)_routeRequest:(JLRRouteRequest *)request withParameters:(NSDictionary *)parameters candidateRoutes:(NSArray <JLRRouteDefinition *> *)candidateRoutes fromIndex:(NSUInteger)startIndex queue:(dispatch_queue_t)queue completion:(void (^)(BOOL didRoute))completion
+{
+    // matching runs on the routing queue, the handlers and completion are called on queue
+    for (NSUInteger index = startIndex; index < candidateRoutes.count; index++) {
+        JLRRouteDefinition *route = candidateRoutes[index];
+        JLRRouteResponse *response = [route routeResponseForRequest:request decodePlusSymbols:shouldDecodePlusSymbols];
+        
+        if (instrumentationEnabled) {
+            [route recordAttemptDidMatch:response.isMatch];
+        }
+        
+        if (!response.isMatch) {
+            continue;
+        }
+        
+        JLRLog(JLRLogLevelInfo, @"Successfully matched %@", route);
+        
+        NSDictionary *finalParameters = [self _finalParametersForMatchParameters:response.parameters parameters:parameters];
+        NSUInteger nextIndex = index + 1;
+        
+        dispatch_async(queue, ^{
+            [route callHandlerBlockWithParameters:finalParameters completion:^(BOOL didRoute) {
+                if (didRoute && self.adaptsRouteOrder) {
+                    [route recordHit];
+                    [self _noteHandledURL];
+                }
+                
+                if (didRoute) {
+                    // asynchronous handlers may report back from any thread
+                    dispatch_async(queue, ^{
+                        completion(YES);
+                    });
+                    return;
+                }
+                
+                // declined, so look for the next match without holding up queue
+                dispatch_async(JLRRoutingQueue(), ^{
+                    [self _routeRequest:request withParameters:parameters candidateRoutes:candidateRoutes fromIndex:nextIndex queue:queue completion:completion];
+                });
+            }];
+        });
+        
+        return;
+    }
     
-    va_end(argsList);
-    NSLog(@"[JLRoutes]: %@", formattedLogMessage);
+    dispatch_async(queue, ^{
+        completion(NO);
+    });
+}
+
+- (BOOL)_isGlobalRoutesController
+{
+    // +routesForScheme: interns the global scheme as the constant itself
+    return self.scheme == JLRoutesGlobalRoutesScheme;
 }
 
 @end
@@ -339,12 +1867,32 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
 
 + (void)setVerboseLoggingEnabled:(BOOL)loggingEnabled
 {
-    verboseLoggingEnabled = loggingEnabled;
+    atomic_store_explicit(&JLRLogLevelThreshold, loggingEnabled ? JLRLogLevelDebug : JLRLogLevelError, memory_order_relaxed);
 }
 
 + (BOOL)isVerboseLoggingEnabled
 {
-    return verboseLoggingEnabled;
+    return atomic_load_explicit(&JLRLogLevelThreshold, memory_order_relaxed) == JLRLogLevelDebug;
+}
+
++ (void)setLogLevel:(JLRLogLevel)logLevel
+{
+    atomic_store_explicit(&JLRLogLevelThreshold, logLevel, memory_order_relaxed);
+}
+
++ (JLRLogLevel)logLevel
+{
+    return atomic_load_explicit(&JLRLogLevelThreshold, memory_order_relaxed);
+}
+
++ (void)setLogger:(id <JLRLogger>)logger
+{
+    JLRSetCurrentLogger(logger);
+}
+
++ (id <JLRLogger>)logger
+{
+    return JLRCurrentLogger();
 }
 
 + (void)setShouldDecodePlusSymbols:(BOOL)shouldDecode
@@ -367,6 +1915,16 @@ static BOOL alwaysTreatsHostAsPathComponent = NO;
     return alwaysTreatsHostAsPathComponent;
 }
 
++ (void)setInstrumentationEnabled:(BOOL)enabled
+{
+    instrumentationEnabled = enabled;
+}
+
++ (BOOL)isInstrumentationEnabled
+{
+    return instrumentationEnabled;
+}
+
 @end
 
 
@@ -0,0 +1,439 @@
+/*
+ Copyright (c) 2017, Joel Levin
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ 
+ Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ Neither the name of JLRoutes nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <XCTest/XCTest.h>
+#import <objc/runtime.h>
+#import "JLRoutes.h"
+
+
+/*
+ Every benchmark registers routes of four shapes in turn, so a table of N routes holds N / 4 of each:
+ 
+   /sectionN/item/:itemID
+   /sectionN/:category/:itemID
+   /sectionN/files/*
+   /sectionN/list(/:page)
+ 
+ URLs are built to match the last route of a shape, which is the most expensive one to reach by trying routes in order.
+ Result and rejected URL caching stay off so that every iteration does the full matching work.
+ */
+
+static NSString *const JLRBenchmarkScheme = @"benchmarks";
+static const NSUInteger JLRBenchmarkShapeCount = 4;
+static const NSUInteger JLRBenchmarkIterations = 100;
+
+typedef NS_ENUM(NSUInteger, JLRBenchmarkShape) {
+    JLRBenchmarkShapeLiteral = 0,
+    JLRBenchmarkShapeVariables,
+    JLRBenchmarkShapeWildcard,
+    JLRBenchmarkShapeOptional,
+};
+
+static NSString *JLRBenchmarkPattern(NSUInteger index)
+{
+    switch ((JLRBenchmarkShape)(index % JLRBenchmarkShapeCount)) {
+        case JLRBenchmarkShapeLiteral:
+            return [NSString stringWithFormat:@"/section%@/item/:itemID", @(index)];
+        case JLRBenchmarkShapeVariables:
+            return [NSString stringWithFormat:@"/section%@/:category/:itemID", @(index)];
+        case JLRBenchmarkShapeWildcard:
+            return [NSString stringWithFormat:@"/section%@/files/*", @(index)];
+        case JLRBenchmarkShapeOptional:
+            return [NSString stringWithFormat:@"/section%@/list(/:page)", @(index)];
+    }
+}
+
+static NSUInteger JLRBenchmarkLastIndex(NSUInteger routeCount, JLRBenchmarkShape shape)
+{
+    NSUInteger index = ((routeCount - 1) / JLRBenchmarkShapeCount) * JLRBenchmarkShapeCount + shape;
+    return index < routeCount ? index : index - JLRBenchmarkShapeCount;
+}
+
+static void JLRRegisterBenchmarkRoutes(JLRoutes *routes, NSUInteger routeCount)
+{
+    BOOL (^handler)(NSDictionary *) = ^BOOL(NSDictionary *parameters) {
+        return YES;
+    };
+    
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        [routes addRoute:JLRBenchmarkPattern(index) handler:handler];
+    }
+}
+
+
+#pragma mark - Allocation Counting
+
+
+static BOOL JLRAllocationCountingEnabled = NO;
+static NSUInteger JLRObjectAllocationCount = 0;
+static IMP JLROriginalAllocWithZone = NULL;
+
+// returns void * so that ARC leaves the +1 reference returned by allocWithZone: alone
+static void *JLRCountingAllocWithZone(id self, SEL _cmd, NSZone *zone)
+{
+    if (JLRAllocationCountingEnabled) {
+        JLRObjectAllocationCount++;
+    }
+    return ((void *(*)(id, SEL, NSZone *))JLROriginalAllocWithZone)(self, _cmd, zone);
+}
+
+// counts the Objective-C objects allocated while the block runs, which covers everything but CF objects created directly
+static NSUInteger JLRCountObjectAllocations(void (^block)(void))
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        Class metaclass = object_getClass([NSObject class]);
+        Method method = class_getClassMethod([NSObject class], @selector(allocWithZone:));
+        JLROriginalAllocWithZone = class_replaceMethod(metaclass, @selector(allocWithZone:), (IMP)JLRCountingAllocWithZone, method_getTypeEncoding(method)) ?: method_getImplementation(method);
+    });
+    
+    JLRObjectAllocationCount = 0;
+    JLRAllocationCountingEnabled = YES;
+    @autoreleasepool {
+        block();
+    }
+    JLRAllocationCountingEnabled = NO;
+    
+    return JLRObjectAllocationCount;
+}
+
+
+#pragma mark -
+
+
+@interface JLRoutesBenchmarks : XCTestCase
+
+@end
+
+
+@implementation JLRoutesBenchmarks
+
+- (void)tearDown
+{
+    [super tearDown];
+    [JLRoutes unregisterAllRouteSchemes];
+}
+
+#pragma mark - Matching
+
+- (void)testHit10
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeLiteral routeCount:10];
+}
+
+- (void)testHit100
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeLiteral routeCount:100];
+}
+
+- (void)testHit1000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeLiteral routeCount:1000];
+}
+
+- (void)testHit10000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeLiteral routeCount:10000];
+}
+
+- (void)testMiss10
+{
+    [self _measureMissWithRouteCount:10];
+}
+
+- (void)testMiss100
+{
+    [self _measureMissWithRouteCount:100];
+}
+
+- (void)testMiss1000
+{
+    [self _measureMissWithRouteCount:1000];
+}
+
+- (void)testMiss10000
+{
+    [self _measureMissWithRouteCount:10000];
+}
+
+- (void)testWildcard10
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeWildcard routeCount:10];
+}
+
+- (void)testWildcard100
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeWildcard routeCount:100];
+}
+
+- (void)testWildcard1000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeWildcard routeCount:1000];
+}
+
+- (void)testWildcard10000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeWildcard routeCount:10000];
+}
+
+- (void)testOptional10
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeOptional routeCount:10];
+}
+
+- (void)testOptional100
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeOptional routeCount:100];
+}
+
+- (void)testOptional1000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeOptional routeCount:1000];
+}
+
+- (void)testOptional10000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeOptional routeCount:10000];
+}
+
+- (void)testPercentEncoded10
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeVariables routeCount:10];
+}
+
+- (void)testPercentEncoded100
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeVariables routeCount:100];
+}
+
+- (void)testPercentEncoded1000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeVariables routeCount:1000];
+}
+
+- (void)testPercentEncoded10000
+{
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeVariables routeCount:10000];
+}
+
+- (void)testFallbackToGlobal10
+{
+    [self _measureFallbackToGlobalWithRouteCount:10];
+}
+
+- (void)testFallbackToGlobal100
+{
+    [self _measureFallbackToGlobalWithRouteCount:100];
+}
+
+- (void)testFallbackToGlobal1000
+{
+    [self _measureFallbackToGlobalWithRouteCount:1000];
+}
+
+- (void)testFallbackToGlobal10000
+{
+    [self _measureFallbackToGlobalWithRouteCount:10000];
+}
+
+- (void)testCompiledMatcherHit10000
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    routes.usesCompiledMatcher = YES;
+    [self _measureRoutingURLForShape:JLRBenchmarkShapeLiteral routeCount:10000];
+}
+
+#pragma mark - Registration
+
+- (void)testRegistrationWithPriorities10
+{
+    [self _measureRegistrationWithRouteCount:10];
+}
+
+- (void)testRegistrationWithPriorities100
+{
+    [self _measureRegistrationWithRouteCount:100];
+}
+
+- (void)testRegistrationWithPriorities1000
+{
+    [self _measureRegistrationWithRouteCount:1000];
+}
+
+- (void)testRegistrationWithPriorities10000
+{
+    [self _measureRegistrationWithRouteCount:10000];
+}
+
+#pragma mark - Allocations
+
+- (void)testHitAllocations
+{
+    [self _assertAllocationsDontGrowForShape:JLRBenchmarkShapeLiteral];
+}
+
+- (void)testMissAllocations
+{
+    NSUInteger smallCount = [self _allocationCountForMissWithRouteCount:10];
+    [JLRoutes unregisterAllRouteSchemes];
+    NSUInteger largeCount = [self _allocationCountForMissWithRouteCount:10000];
+    
+    XCTAssertLessThanOrEqual(largeCount, smallCount + JLRBenchmarkShapeCount, @"A miss should not allocate per route tried, it allocated %@ objects with 10 routes and %@ objects with 10000 routes", @(smallCount), @(largeCount));
+}
+
+- (void)testWildcardAllocations
+{
+    [self _assertAllocationsDontGrowForShape:JLRBenchmarkShapeWildcard];
+}
+
+- (void)testOptionalAllocations
+{
+    [self _assertAllocationsDontGrowForShape:JLRBenchmarkShapeOptional];
+}
+
+- (void)testPercentEncodedAllocations
+{
+    [self _assertAllocationsDontGrowForShape:JLRBenchmarkShapeVariables];
+}
+
+#pragma mark - Private
+
+- (NSURL *)_URLForShape:(JLRBenchmarkShape)shape routeCount:(NSUInteger)routeCount
+{
+    NSNumber *section = @(JLRBenchmarkLastIndex(routeCount, shape));
+    NSString *URLString = nil;
+    
+    switch (shape) {
+        case JLRBenchmarkShapeLiteral:
+            URLString = [NSString stringWithFormat:@"%@://section%@/item/42", JLRBenchmarkScheme, section];
+            break;
+        case JLRBenchmarkShapeVariables:
+            URLString = [NSString stringWithFormat:@"%@://section%@/caf%%C3%%A9/na%%20me+plus?query=a%%20b&flag", JLRBenchmarkScheme, section];
+            break;
+        case JLRBenchmarkShapeWildcard:
+            URLString = [NSString stringWithFormat:@"%@://section%@/files/a/b/c/d", JLRBenchmarkScheme, section];
+            break;
+        case JLRBenchmarkShapeOptional:
+            URLString = [NSString stringWithFormat:@"%@://section%@/list/3", JLRBenchmarkScheme, section];
+            break;
+    }
+    
+    return [NSURL URLWithString:URLString];
+}
+
+- (NSURL *)_missURLWithRouteCount:(NSUInteger)routeCount
+{
+    // the first path component starts a route, so this isn't rejected before trying the routes
+    NSNumber *section = @(JLRBenchmarkLastIndex(routeCount, JLRBenchmarkShapeLiteral));
+    return [NSURL URLWithString:[NSString stringWithFormat:@"%@://section%@/missing/42", JLRBenchmarkScheme, section]];
+}
+
+- (void)_measureRoutingURL:(NSURL *)URL withRoutes:(JLRoutes *)routes expectedResult:(BOOL)expectedResult
+{
+    XCTAssertEqual([routes routeURL:URL], expectedResult);
+    
+    [self measureBlock:^{
+        for (NSUInteger iteration = 0; iteration < JLRBenchmarkIterations; iteration++) {
+            [routes routeURL:URL];
+        }
+    }];
+}
+
+- (void)_measureRoutingURLForShape:(JLRBenchmarkShape)shape routeCount:(NSUInteger)routeCount
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    JLRRegisterBenchmarkRoutes(routes, routeCount);
+    
+    [self _measureRoutingURL:[self _URLForShape:shape routeCount:routeCount] withRoutes:routes expectedResult:YES];
+}
+
+- (void)_measureMissWithRouteCount:(NSUInteger)routeCount
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    JLRRegisterBenchmarkRoutes(routes, routeCount);
+    
+    [self _measureRoutingURL:[self _missURLWithRouteCount:routeCount] withRoutes:routes expectedResult:NO];
+}
+
+- (void)_measureFallbackToGlobalWithRouteCount:(NSUInteger)routeCount
+{
+    // the scheme gets as many routes as the global namespace, none of which match
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    routes.shouldFallbackToGlobalRoutes = YES;
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        [routes addRoute:[NSString stringWithFormat:@"/scheme%@/:itemID", @(index)] handler:nil];
+    }
+    JLRRegisterBenchmarkRoutes([JLRoutes globalRoutes], routeCount);
+    
+    [self _measureRoutingURL:[self _URLForShape:JLRBenchmarkShapeLiteral routeCount:routeCount] withRoutes:routes expectedResult:YES];
+}
+
+- (void)_measureRegistrationWithRouteCount:(NSUInteger)routeCount
+{
+    NSMutableArray <NSString *> *patterns = [NSMutableArray array];
+    for (NSUInteger index = 0; index < routeCount; index++) {
+        [patterns addObject:JLRBenchmarkPattern(index)];
+    }
+    
+    BOOL (^handler)(NSDictionary *) = ^BOOL(NSDictionary *parameters) {
+        return YES;
+    };
+    
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        [routes removeAllRoutes];
+        
+        [self startMeasuring];
+        [patterns enumerateObjectsUsingBlock:^(NSString *pattern, NSUInteger index, BOOL *stop) {
+            // interleaved priorities so that most routes get inserted in the middle of the list rather than appended
+            [routes addRoute:pattern priority:(index * 7) % 16 handler:handler];
+        }];
+        [self stopMeasuring];
+    }];
+    
+    XCTAssertGreaterThanOrEqual(routes.routes.count, routeCount);
+}
+
+- (NSUInteger)_allocationCountForRoutingURL:(NSURL *)URL withRoutes:(JLRoutes *)routes
+{
+    // the first routing warms up anything that's created lazily
+    [routes routeURL:URL];
+    
+    return JLRCountObjectAllocations(^{
+        [routes routeURL:URL];
+    });
+}
+
+- (NSUInteger)_allocationCountForMissWithRouteCount:(NSUInteger)routeCount
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    JLRRegisterBenchmarkRoutes(routes, routeCount);
+    
+    return [self _allocationCountForRoutingURL:[self _missURLWithRouteCount:routeCount] withRoutes:routes];
+}
+
+- (void)_assertAllocationsDontGrowForShape:(JLRBenchmarkShape)shape
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:JLRBenchmarkScheme];
+    JLRRegisterBenchmarkRoutes(routes, 10);
+    NSUInteger smallCount = [self _allocationCountForRoutingURL:[self _URLForShape:shape routeCount:10] withRoutes:routes];
+    
+    [routes removeAllRoutes];
+    JLRRegisterBenchmarkRoutes(routes, 10000);
+    NSUInteger largeCount = [self _allocationCountForRoutingURL:[self _URLForShape:shape routeCount:10000] withRoutes:routes];
+    
+    // only the routes that get tried before the match may cost anything, and a miss should cost nothing
+    XCTAssertLessThanOrEqual(largeCount, smallCount + JLRBenchmarkShapeCount, @"Routing should not allocate per route tried, it allocated %@ objects with 10 routes and %@ objects with 10000 routes", @(smallCount), @(largeCount));
+}
+
+@end
@@ -11,8 +11,14 @@
  */
 
 #import <XCTest/XCTest.h>
+#import <objc/runtime.h>
 #import "JLRoutes.h"
 #import "JLRRouteDefinition.h"
+#import "JLRParsingUtilities.h"
+#import "JLRRoutingMetrics.h"
+#import "JLRRouteConflict.h"
+#import "JLRScratchStorage.h"
+#import "JLRRouteTrie.h"
 
 
 #define JLValidateParameterCount(expectedCount)\
@@ -41,6 +47,155 @@ XCTAssertEqualObjects(self.lastMatch[JLRoutePatternKey], pattern, @"Pattern did
 XCTAssertEqualObjects(self.lastMatch[JLRouteSchemeKey], scheme, @"Scheme did not match")
 
 
+#pragma mark - Allocation Counting
+
+
+static BOOL JLRAllocationCountingEnabled = NO;
+static NSUInteger JLRResponseAllocationCount = 0;
+static NSUInteger JLRMutableDictionaryAllocationCount = 0;
+static NSUInteger JLRRequestAllocationCount = 0;
+static NSUInteger JLRRequestTokenizationCount = 0;
+static IMP JLROriginalResponseAllocWithZone = NULL;
+static IMP JLROriginalRequestAllocWithZone = NULL;
+static IMP JLROriginalMutableDictionaryDictionary = NULL;
+static IMP JLROriginalRequestWithURL = NULL;
+
+// returns void * so that ARC leaves the +1 reference returned by allocWithZone: alone
+static void *JLRCountingResponseAllocWithZone(id self, SEL _cmd, NSZone *zone)
+{
+    if (JLRAllocationCountingEnabled) {
+        JLRResponseAllocationCount++;
+    }
+    return ((void *(*)(id, SEL, NSZone *))JLROriginalResponseAllocWithZone)(self, _cmd, zone);
+}
+
+static void *JLRCountingRequestAllocWithZone(id self, SEL _cmd, NSZone *zone)
+{
+    if (JLRAllocationCountingEnabled) {
+        JLRRequestAllocationCount++;
+    }
+    return ((void *(*)(id, SEL, NSZone *))JLROriginalRequestAllocWithZone)(self, _cmd, zone);
+}
+
+// the routes controllers tokenize every URL they route through here, so this counts how often a URL is tokenized
+static void *JLRCountingRequestWithURL(id self, SEL _cmd, NSURL *URL, BOOL alwaysTreatsHostAsPathComponent, id test, void *rejectedRequest)
+{
+    if (JLRAllocationCountingEnabled) {
+        JLRRequestTokenizationCount++;
+    }
+    return ((void *(*)(id, SEL, NSURL *, BOOL, id, void *))JLROriginalRequestWithURL)(self, _cmd, URL, alwaysTreatsHostAsPathComponent, test, rejectedRequest);
+}
+
+static id JLRCountingMutableDictionaryDictionary(id self, SEL _cmd)
+{
+    if (JLRAllocationCountingEnabled) {
+        JLRMutableDictionaryAllocationCount++;
+    }
+    return ((id (*)(id, SEL))JLROriginalMutableDictionaryDictionary)(self, _cmd);
+}
+
+static IMP JLRReplaceClassMethod(Class cls, SEL selector, IMP replacement)
+{
+    Class metaclass = object_getClass(cls);
+    IMP original = class_getMethodImplementation(metaclass, selector);
+    class_replaceMethod(metaclass, selector, replacement, method_getTypeEncoding(class_getClassMethod(cls, selector)));
+    return original;
+}
+
+static void JLRStartCountingAllocations(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        JLROriginalResponseAllocWithZone = JLRReplaceClassMethod([JLRRouteResponse class], @selector(allocWithZone:), (IMP)JLRCountingResponseAllocWithZone);
+        JLROriginalMutableDictionaryDictionary = JLRReplaceClassMethod([NSMutableDictionary class], @selector(dictionary), (IMP)JLRCountingMutableDictionaryDictionary);
+        JLROriginalRequestAllocWithZone = JLRReplaceClassMethod([JLRRouteRequest class], @selector(allocWithZone:), (IMP)JLRCountingRequestAllocWithZone);
+        JLROriginalRequestWithURL = JLRReplaceClassMethod([JLRRouteRequest class], @selector(requestWithURL:alwaysTreatsHostAsPathComponent:passingFirstPathComponentTest:rejectedRequest:), (IMP)JLRCountingRequestWithURL);
+    });
+    
+    JLRResponseAllocationCount = 0;
+    JLRMutableDictionaryAllocationCount = 0;
+    JLRRequestAllocationCount = 0;
+    JLRRequestTokenizationCount = 0;
+    JLRAllocationCountingEnabled = YES;
+}
+
+static void JLRStopCountingAllocations(void)
+{
+    JLRAllocationCountingEnabled = NO;
+}
+
+
+#pragma mark - Logging
+
+
+@interface JLRTestLogger : NSObject <JLRLogger>
+
+@property (nonatomic, strong) NSMutableArray <NSString *> *messages;
+@property (nonatomic, strong) NSMutableIndexSet *levels;
+
+@end
+
+
+@implementation JLRTestLogger
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        self.messages = [NSMutableArray array];
+        self.levels = [NSMutableIndexSet indexSet];
+    }
+    return self;
+}
+
+- (void)logMessage:(NSString *)message level:(JLRLogLevel)level
+{
+    @synchronized (self) {
+        [self.messages addObject:message];
+        [self.levels addIndex:level];
+    }
+}
+
+@end
+
+
+// counts how often it's formatted into a log message
+@interface JLRDescriptionCounter : NSObject
+
+@property (nonatomic, assign) NSUInteger descriptionCount;
+
+@end
+
+
+@implementation JLRDescriptionCounter
+
+- (NSString *)description
+{
+    self.descriptionCount++;
+    return @"counter";
+}
+
+@end
+
+
+// counts how often it decodes a variable value
+@interface JLRDecodeCountingRouteDefinition : JLRRouteDefinition
+
+@property (nonatomic, assign) NSUInteger decodeCount;
+
+@end
+
+
+@implementation JLRDecodeCountingRouteDefinition
+
+- (NSString *)variableValueForValue:(NSString *)value decodePlusSymbols:(BOOL)decodePlusSymbols
+{
+    self.decodeCount++;
+    return [super variableValueForValue:value decodePlusSymbols:decodePlusSymbols];
+}
+
+@end
+
+
 #pragma mark -
 
 
@@ -76,6 +231,7 @@ static JLRoutesTests *testsInstance = nil;
     // reset settings
     [JLRoutes setShouldDecodePlusSymbols:YES];
     [JLRoutes setAlwaysTreatsHostAsPathComponent:NO];
+    [JLRoutes setInstrumentationEnabled:NO];
 }
 
 - (void)tearDown
@@ -488,6 +644,115 @@ static JLRoutesTests *testsInstance = nil;
     JLValidateParameter(@{@"userID" : @"joeldev"});
 }
 
+- (void)testFallbackParsesURLOnce
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"fallbackParsing"];
+    routes.shouldFallbackToGlobalRoutes = YES;
+    [routes addRoute:@"/user/:action/:userID" handler:^BOOL (NSDictionary *parameters) {
+        return NO;
+    }];
+    [routes addRoute:@"/post/:postID" handler:[[self class] defaultRouteHandler]];
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/:userID" handler:[[self class] defaultRouteHandler]];
+    [[JLRoutes globalRoutes] addRoute:@"/settings" handler:[[self class] defaultRouteHandler]];
+    
+    // the scheme's routes parse the URL, then the global routes match the same request
+    JLRStartCountingAllocations();
+    [self route:@"fallbackParsing://user/view/joeldev?source=link"];
+    JLRStopCountingAllocations();
+    JLValidateAnyRouteMatched();
+    JLValidateScheme(JLRoutesGlobalRoutesScheme);
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    JLValidateParameter(@{@"source": @"link"});
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    
+    JLRStartCountingAllocations();
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"fallbackParsing://user/view/joeldev"]]);
+    JLRStopCountingAllocations();
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    
+    JLRStartCountingAllocations();
+    NSDictionary *variableRanges = nil;
+    JLRRouteDefinition *route = [routes routeDefinitionMatchingURL:[NSURL URLWithString:@"fallbackParsing://user/view/joeldev"] variableRanges:&variableRanges];
+    JLRStopCountingAllocations();
+    XCTAssertEqualObjects(route.pattern, @"/user/view/:userID");
+    XCTAssertEqualObjects(variableRanges[@"userID"], [NSValue valueWithRange:NSMakeRange(2, 1)]);
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    
+    // a URL none of the scheme's routes can match is handed on to the global routes with the hash of its first path
+    // component, and only has its path split up if they can match it
+    JLRStartCountingAllocations();
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"fallbackParsing://settings"]]);
+    JLRStopCountingAllocations();
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    XCTAssertEqual(JLRRequestTokenizationCount, 1UL);
+    
+    JLRStartCountingAllocations();
+    [self route:@"fallbackParsing://settings?tab=privacy"];
+    JLRStopCountingAllocations();
+    JLValidateAnyRouteMatched();
+    JLValidateScheme(JLRoutesGlobalRoutesScheme);
+    JLValidateParameter(@{@"tab": @"privacy"});
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    XCTAssertEqual(JLRRequestTokenizationCount, 1UL);
+    
+    JLRStartCountingAllocations();
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"fallbackParsing://user/view/joeldev/extra"]]);
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"fallbackParsing://nothing/here"]]);
+    JLRStopCountingAllocations();
+    XCTAssertEqual(JLRRequestAllocationCount, 2UL);
+    XCTAssertEqual(JLRRequestTokenizationCount, 2UL);
+    
+    JLRStartCountingAllocations();
+    XCTestExpectation *routedExpectation = [self expectationWithDescription:@"Routed"];
+    [routes routeURL:[NSURL URLWithString:@"fallbackParsing://user/view/joeldev"] withParameters:nil queue:dispatch_get_main_queue() completion:^(BOOL didRoute) {
+        XCTAssertTrue(didRoute);
+        [routedExpectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    JLRStopCountingAllocations();
+    XCTAssertEqual(JLRRequestAllocationCount, 1UL);
+    
+    // the global routes' filter checks the hash taken while the request was tokenized
+    NSUInteger hash = 0;
+    XCTAssertTrue([[[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:@"fallbackParsing://user/view/joeldev"] alwaysTreatsHostAsPathComponent:NO] getFirstPathComponentHash:&hash]);
+    XCTAssertEqual(hash, [JLRRouteRequest hashForPathComponent:@"user"]);
+    XCTAssertFalse([[[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:@"fallbackParsing://joel@user:8080/view"] alwaysTreatsHostAsPathComponent:NO] getFirstPathComponentHash:&hash]);
+}
+
+- (void)testSchemeCaseInsensitivity
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    JLRoutes *routes = [JLRoutes routesForScheme:@"MixedCase"];
+    XCTAssertTrue([JLRoutes routesForScheme:@"mixedcase"] == routes, @"Schemes differing only in case should share a namespace");
+    XCTAssertTrue([JLRoutes routesForScheme:@"jlroutesglobalroutesscheme"] == [JLRoutes globalRoutes]);
+    
+    [routes addRoute:@"/test" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/global" handler:defaultHandler];
+    
+    // the first spelling is the one that sticks
+    XCTAssertNotNil([JLRoutes allRoutes][@"MixedCase"]);
+    XCTAssertNil([JLRoutes allRoutes][@"mixedcase"]);
+    
+    [self route:@"MIXEDCASE://test"];
+    JLValidateAnyRouteMatched();
+    JLValidateScheme(@"MixedCase");
+    
+    [self route:@"mixedCase://global"];
+    JLValidateNoLastMatch();
+    
+    routes.shouldFallbackToGlobalRoutes = YES;
+    [self route:@"mixedCase://global"];
+    JLValidateAnyRouteMatched();
+    JLValidateScheme(JLRoutesGlobalRoutesScheme);
+    
+    [JLRoutes unregisterRouteScheme:@"MIXEDcase"];
+    XCTAssertNil([JLRoutes allRoutes][@"MixedCase"]);
+    
+    [self route:@"mixedcase://test"];
+    JLValidateNoLastMatch();
+}
+
 - (void)testForRouteExistence
 {
     // This should return yes and no for whether we have a matching route.
@@ -698,6 +963,34 @@ static JLRoutesTests *testsInstance = nil;
     JLValidateParameter((@{@"people": @[@"joel+levin", @"foo+bar"]}));
 }
 
+- (void)testVariableValueDecoding
+{
+    NSArray <NSString *> *pathComponents = @[@"joeldev", @"joel%20levin", @"joel+levin", @"joel%2Blevin", @"joeldev#", @"#", @"%23", @"joel%23", @"joel%23#", @"100%", @"%2", @"%zz", @"%FF", @"caf%C3%A9", @"caf\u00e9+levin#", @""];
+    
+    for (NSString *pathComponent in pathComponents) {
+        for (NSNumber *decodePlusSymbols in @[@NO, @YES]) {
+            // the value the multi-step decoding used to produce
+            NSString *expectedValue = [pathComponent stringByRemovingPercentEncoding];
+            if (expectedValue.length > 1 && [expectedValue characterAtIndex:expectedValue.length - 1] == '#') {
+                expectedValue = [expectedValue substringToIndex:expectedValue.length - 1];
+            }
+            if (expectedValue != nil) {
+                expectedValue = [JLRParsingUtilities variableValueFrom:expectedValue decodePlusSymbols:[decodePlusSymbols boolValue]];
+            }
+            
+            NSString *value = [JLRParsingUtilities variableValueByDecodingPathComponent:pathComponent decodePlusSymbols:[decodePlusSymbols boolValue]];
+            XCTAssertEqualObjects(value, expectedValue, @"Decoding %@", pathComponent);
+        }
+    }
+    
+    // nothing to decode, nothing to allocate
+    NSString *pathComponent = [@"joel" stringByAppendingString:@"dev"];
+    XCTAssertTrue([JLRParsingUtilities variableValueByDecodingPathComponent:pathComponent decodePlusSymbols:YES] == pathComponent);
+    
+    pathComponent = [@"joel+" stringByAppendingString:@"levin"];
+    XCTAssertTrue([JLRParsingUtilities variableValueByDecodingPathComponent:pathComponent decodePlusSymbols:NO] == pathComponent);
+}
+
 - (void)testVariableEmptyFollowedByWildcard
 {
     [[JLRoutes routesForScheme:@"wildcardTests"] addRoute:@"list/:variable/detail/:variable2/*" handler:nil];
@@ -709,6 +1002,119 @@ static JLRoutesTests *testsInstance = nil;
     JLValidateAnyRouteMatched();
 }
 
+- (void)testMidPatternWildcards
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    for (NSNumber *usesCompiledMatcher in @[@NO, @YES]) {
+        JLRoutes *routes = [JLRoutes routesForScheme:@"midWildcard"];
+        routes.usesCompiledMatcher = usesCompiledMatcher.boolValue;
+        
+        [routes addRoute:@"/files/*/edit" handler:defaultHandler];
+        [routes addRoute:@"/files/*/:name/:action" handler:defaultHandler];
+        [routes addRoute:@"/files/*" handler:defaultHandler];
+        
+        JLRRouteDefinition *editRoute = routes.routes[0];
+        XCTAssertEqual(editRoute.minimumPathComponentCount, 2UL);
+        XCTAssertEqual(editRoute.maximumPathComponentCount, NSUIntegerMax);
+        
+        [self route:@"midWildcard://files/edit"];
+        JLValidatePattern(@"/files/*/edit");
+        JLValidateParameter(@{JLRouteWildcardComponentsKey: @[]});
+        
+        [self route:@"midWildcard://files/docs/2017/edit"];
+        JLValidatePattern(@"/files/*/edit");
+        JLValidateParameter((@{JLRouteWildcardComponentsKey: @[@"docs", @"2017"]}));
+        XCTAssertEqualObjects([self.lastMatch[JLRouteWildcardComponentsKey] copy], (@[@"docs", @"2017"]));
+        
+        // the segments after the wildcard take the last components of the path
+        [self route:@"midWildcard://files/docs/2017/report/view"];
+        JLValidatePattern(@"/files/*/:name/:action");
+        JLValidateParameter(@{@"name": @"report"});
+        JLValidateParameter(@{@"action": @"view"});
+        JLValidateParameter((@{JLRouteWildcardComponentsKey: @[@"docs", @"2017"]}));
+        
+        NSDictionary *ranges = [routes.routes[1] capturedPathComponentRangesForRequest:[[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:@"midWildcard://files/docs/2017/report/view"] alwaysTreatsHostAsPathComponent:NO]];
+        XCTAssertEqualObjects(ranges, (@{JLRouteWildcardComponentsKey: [NSValue valueWithRange:NSMakeRange(1, 2)], @"name": [NSValue valueWithRange:NSMakeRange(3, 1)], @"action": [NSValue valueWithRange:NSMakeRange(4, 1)]}));
+        
+        [self route:@"midWildcard://files/docs"];
+        JLValidatePattern(@"/files/*");
+        
+        // @"/files/*" matches every URL the other two do, but not the other way around
+        XCTAssertTrue([routes.routes[2] matchesEveryURLMatchedByRouteDefinition:editRoute]);
+        XCTAssertFalse([editRoute matchesEveryURLMatchedByRouteDefinition:routes.routes[2]]);
+        XCTAssertTrue([editRoute canMatchSameURLAsRouteDefinition:routes.routes[1]]);
+        
+        [JLRoutes unregisterRouteScheme:@"midWildcard"];
+    }
+}
+
+- (void)testConstrainedVariables
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    JLRoutes *routes = [JLRoutes routesForScheme:@"constraints"];
+    
+    [routes addRoute:@"/user/:id<int>" handler:defaultHandler];
+    [routes addRoute:@"/user/:name" handler:defaultHandler];
+    [routes addRoute:@"/post/:slug<[a-z-]+>" handler:defaultHandler];
+    [routes addRoute:@"/item/:uuid<uuid>/:action" handler:defaultHandler];
+    [routes addRoute:@"/broken/:value<[a-z>" handler:defaultHandler];
+    
+    // integers are passed as numbers, anything else goes on to the next route
+    [self route:@"constraints://user/42"];
+    JLValidatePattern(@"/user/:id<int>");
+    JLValidateParameter(@{@"id": @42});
+    XCTAssertTrue([self.lastMatch[@"id"] isKindOfClass:[NSNumber class]]);
+    
+    [self route:@"constraints://user/-7"];
+    JLValidateParameter(@{@"id": @(-7)});
+    
+    [self route:@"constraints://user/bob"];
+    JLValidatePattern(@"/user/:name");
+    JLValidateParameter(@{@"name": @"bob"});
+    
+    [self route:@"constraints://user/99999999999999999999"];
+    JLValidatePattern(@"/user/:name");
+    
+    [self route:@"constraints://post/hello-world"];
+    JLValidatePattern(@"/post/:slug<[a-z-]+>");
+    JLValidateParameter(@{@"slug": @"hello-world"});
+    
+    [self route:@"constraints://post/Hello"];
+    JLValidateNoLastMatch();
+    
+    // checked against the decoded value
+    [self route:@"constraints://post/hello%2Dworld"];
+    JLValidateParameter(@{@"slug": @"hello-world"});
+    
+    [self route:@"constraints://item/e621e1f8-c36c-495a-93fc-0c247a3e6e5f/open"];
+    JLValidatePattern(@"/item/:uuid<uuid>/:action");
+    JLValidateParameter(@{@"uuid": @"e621e1f8-c36c-495a-93fc-0c247a3e6e5f"});
+    
+    [self route:@"constraints://item/e621e1f8c36c495a93fc0c247a3e6e5f/open"];
+    JLValidateNoLastMatch();
+    
+    [self route:@"constraints://broken/abc"];
+    JLValidateNoLastMatch();
+    
+    JLRRouteDefinition *integerRoute = routes.routes[0];
+    JLRRouteDefinition *literalRoute = [[JLRRouteDefinition alloc] initWithScheme:@"constraints" pattern:@"/user/view" priority:0 handlerBlock:nil];
+    XCTAssertEqual(integerRoute.segments[1].constraint.type, JLRRouteVariableConstraintTypeInteger);
+    XCTAssertFalse([integerRoute canMatchSameURLAsRouteDefinition:literalRoute]);
+    XCTAssertFalse([integerRoute matchesEveryURLMatchedByRouteDefinition:routes.routes[1]]);
+    XCTAssertTrue([routes.routes[1] matchesEveryURLMatchedByRouteDefinition:integerRoute]);
+    
+    // a constrained value is decoded and parsed once, while matching, and passed on to the handler as it is
+    JLRDecodeCountingRouteDefinition *countingRoute = [[JLRDecodeCountingRouteDefinition alloc] initWithScheme:@"constraints" pattern:@"/count/:id<int>/:name" priority:0 handlerBlock:[[self class] defaultRouteHandler]];
+    [routes addRoute:countingRoute];
+    
+    [self route:@"constraints://count/42/bob"];
+    JLValidatePattern(@"/count/:id<int>/:name");
+    JLValidateParameter(@{@"id": @42});
+    JLValidateParameter(@{@"name": @"bob"});
+    XCTAssertEqual(countingRoute.decodeCount, 2UL);
+}
+
 - (void)testMultipleOptionalRoutes
 {
     [[JLRoutes globalRoutes] addRoute:@"/path/:thing(/new)(/anotherpath/:anotherthing)" handler:[[self class] defaultRouteHandler]];
@@ -735,6 +1141,38 @@ static JLRoutesTests *testsInstance = nil;
     JLValidateNoLastMatch();
 }
 
+- (void)testOptionalRouteExpansion
+{
+    NSArray <NSString *> *expectedPatterns = @[@"/path/:thing/a/b/c", @"/path/:thing/a/b", @"/path/:thing/a/c", @"/path/:thing/b/c", @"/path/:thing/a", @"/path/:thing/b", @"/path/:thing/c", @"/path/:thing"];
+    XCTAssertEqualObjects([JLRParsingUtilities expandOptionalRoutePatternsForPattern:@"/path/:thing(/a)(/b)(/c)"], expectedPatterns);
+    
+    // longer components sort first, whatever their position
+    expectedPatterns = @[@"/path/new/anotherpath/:anotherthing", @"/path/anotherpath/:anotherthing", @"/path/new", @"/path"];
+    XCTAssertEqualObjects([JLRParsingUtilities expandOptionalRoutePatternsForPattern:@"/path(/new)(/anotherpath/:anotherthing)"], expectedPatterns);
+    
+    XCTAssertEqualObjects([JLRParsingUtilities expandOptionalRoutePatternsForPattern:@"/path/:thing"], @[]);
+    
+    NSMutableString *pattern = [NSMutableString stringWithString:@"/many"];
+    for (NSUInteger index = 0; index < 10; index++) {
+        [pattern appendFormat:@"(/:option%@)", @(index)];
+    }
+    
+    NSArray <NSString *> *patterns = [JLRParsingUtilities expandOptionalRoutePatternsForPattern:pattern];
+    XCTAssertEqual(patterns.count, 1024UL);
+    XCTAssertEqual([NSSet setWithArray:patterns].count, 1024UL);
+    XCTAssertEqualObjects([patterns lastObject], @"/many");
+    for (NSUInteger index = 1; index < patterns.count; index++) {
+        XCTAssertGreaterThanOrEqual(patterns[index - 1].length, patterns[index].length);
+    }
+    
+    // past 16 groups the pattern is refused straight away rather than expanded into millions of routes
+    NSMutableString *tooManyPattern = [NSMutableString stringWithString:@"/toomany"];
+    for (NSUInteger index = 0; index < 30; index++) {
+        [tooManyPattern appendFormat:@"(/:option%@)", @(index)];
+    }
+    XCTAssertEqualObjects([JLRParsingUtilities expandOptionalRoutePatternsForPattern:tooManyPattern], @[]);
+}
+
 - (void)testPassingURLStringsAsParams
 {
     [[JLRoutes globalRoutes] addRoute:@"/web/:URLString" handler:[[self class] defaultRouteHandler]];
@@ -811,6 +1249,1115 @@ static JLRoutesTests *testsInstance = nil;
     JLValidateParameter((@{@"pathid": @"3"}));
 }
 
+- (void)testModifyingRoutesFromHandler
+{
+    __block NSUInteger handlerCallCount = 0;
+    
+    [[JLRoutes globalRoutes] addRoute:@"/modify/:action" handler:^BOOL(NSDictionary *parameters) {
+        handlerCallCount++;
+        [[JLRoutes globalRoutes] addRoute:@"/modify/added" handler:[[self class] defaultRouteHandler]];
+        [[JLRoutes globalRoutes] removeRoute:@"/modify/:action"];
+        return NO;
+    }];
+    
+    // the route list being routed is a snapshot, so changing the routes from a handler is safe
+    [self route:@"tests://modify/added"];
+    JLValidateNoLastMatch();
+    XCTAssertEqual(handlerCallCount, 1UL);
+    XCTAssertEqual([JLRoutes globalRoutes].routes.count, 1UL);
+    
+    [self route:@"tests://modify/added"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/modify/added");
+    XCTAssertEqual(handlerCallCount, 1UL);
+}
+
+- (void)testRouteOrderAcrossPathLengths
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    // the wildcard route is registered before any two component route exists, and must still be tried first
+    [[JLRoutes globalRoutes] addRoute:@"/catalog/*" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/catalog/:item" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/catalog/featured" priority:5 handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/catalog/:item/reviews" handler:defaultHandler];
+    
+    [self route:@"tests://catalog/shoes"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/catalog/*");
+    
+    [self route:@"tests://catalog/featured"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/catalog/featured");
+    
+    [self route:@"tests://catalog"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/catalog/*");
+    
+    [[JLRoutes globalRoutes] removeRoute:@"/catalog/*"];
+    
+    [self route:@"tests://catalog/shoes"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/catalog/:item");
+    
+    [self route:@"tests://catalog/shoes/reviews"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/catalog/:item/reviews");
+    
+    [self route:@"tests://catalog"];
+    JLValidateNoLastMatch();
+}
+
+- (void)testRouteRequestParsing
+{
+    JLRRouteRequest *(^request)(NSString *, BOOL) = ^JLRRouteRequest *(NSString *URLString, BOOL alwaysTreatsHostAsPathComponent) {
+        return [[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:URLString] alwaysTreatsHostAsPathComponent:alwaysTreatsHostAsPathComponent];
+    };
+    
+    XCTAssertEqualObjects(request(@"tests://user/view/joeldev/", NO).pathComponents, (@[@"user", @"view", @"joeldev"]));
+    XCTAssertEqualObjects(request(@"tests://user//view", NO).pathComponents, (@[@"user", @"view"]));
+    XCTAssertEqualObjects(request(@"tests://localhost/a//b", NO).pathComponents, (@[@"a", @"", @"b"]));
+    XCTAssertEqualObjects(request(@"https://www.mydomain.com/sign_in", NO).pathComponents, (@[@"sign_in"]));
+    XCTAssertEqualObjects(request(@"https://www.mydomain.com/sign_in", YES).pathComponents, (@[@"www.mydomain.com", @"sign_in"]));
+    XCTAssertEqualObjects(request(@"tests://", NO).pathComponents, (@[@""]));
+    XCTAssertEqualObjects(request(@"tests://user/view/joel%20levin", NO).pathComponents, (@[@"user", @"view", @"joel%20levin"]));
+    
+    XCTAssertEqualObjects(request(@"tests://xyz/wildcard#", NO).pathComponents, (@[@"xyz", @"wildcard#"]));
+    XCTAssertEqualObjects(request(@"tests://route#/matches/wildcard/", NO).pathComponents, (@[@"route#", @"matches", @"wildcard"]));
+    XCTAssertEqualObjects(request(@"tests://user#/view/joel%20levin", NO).pathComponents, (@[@"user#", @"view", @"joel%20levin"]));
+    
+    XCTAssertEqualObjects(request(@"tests://search?q=nice%20search&q=a%2Bb", NO).queryParams, (@{@"q": @[@"nice search", @"a+b"]}));
+    
+    JLRRouteRequest *queryRequest = request(@"tests://user?search=nice&go=home&go=away&empty=&novalue#/view/joeldev?userID=evilPerson&&go=back", NO);
+    XCTAssertEqualObjects(queryRequest.pathComponents, (@[@"user#", @"view", @"joeldev"]));
+    XCTAssertEqualObjects(queryRequest.queryParams, (@{@"search": @"nice", @"go": @[@"home", @"away", @"back"], @"empty": @"", @"userID": @"evilPerson"}));
+    
+    JLRRouteRequest *fragmentQueryRequest = request(@"tests://user/view/joeldev?userID=evilPerson#userID=otherEvilPerson&thing=stuff", NO);
+    XCTAssertEqualObjects(fragmentQueryRequest.pathComponents, (@[@"user", @"view", @"joeldev"]));
+    XCTAssertEqualObjects(fragmentQueryRequest.queryParams, (@{@"userID": @[@"evilPerson", @"otherEvilPerson"], @"thing": @"stuff"}));
+    
+    // parsed by NSURLComponents instead
+    XCTAssertEqualObjects(request(@"tests://joel@user:8080/view?id=1", NO).pathComponents, (@[@"user", @"view"]));
+    XCTAssertEqualObjects(request(@"tests://joel@user:8080/view?id=1", NO).queryParams, (@{@"id": @"1"}));
+}
+
+- (void)testLazyQueryParsing
+{
+    __block NSUInteger parseCount = 0;
+    Method parseMethod = class_getInstanceMethod([JLRRouteRequest class], NSSelectorFromString(@"_parseQueryParams"));
+    IMP originalParse = method_getImplementation(parseMethod);
+    method_setImplementation(parseMethod, imp_implementationWithBlock(^NSDictionary *(JLRRouteRequest *request) {
+        parseCount++;
+        return ((NSDictionary *(*)(id, SEL))originalParse)(request, NSSelectorFromString(@"_parseQueryParams"));
+    }));
+    
+    __block NSUInteger handlerCallCount = 0;
+    BOOL (^decliningHandler)(NSDictionary *) = ^BOOL (NSDictionary *parameters) {
+        handlerCallCount++;
+        return NO;
+    };
+    
+    [[JLRoutes globalRoutes] addRoute:@"/search/:term" priority:2 handler:decliningHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/search/*" priority:1 handler:decliningHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/search/:term" handler:[[self class] defaultRouteHandler]];
+    
+    XCTAssertTrue([JLRoutes canRouteURL:[NSURL URLWithString:@"tests://search/shoes?color=red+blue"]]);
+    XCTAssertEqual(parseCount, 0UL);
+    
+    [self route:@"tests://search/shoes?color=red+blue"];
+    JLValidateAnyRouteMatched();
+    JLValidateParameter(@{@"color": @"red blue"});
+    XCTAssertEqual(handlerCallCount, 2UL);
+    XCTAssertEqual(parseCount, 1UL);
+    
+    method_setImplementation(parseMethod, originalParse);
+}
+
+- (void)testResultCache
+{
+    __block BOOL declines = NO;
+    BOOL (^sometimesDecliningHandler)(NSDictionary *) = ^BOOL (NSDictionary *parameters) {
+        testsInstance.lastMatch = parameters;
+        return !declines;
+    };
+    
+    JLRoutes *routes = [JLRoutes globalRoutes];
+    routes.resultCacheCapacity = 2;
+    
+    [routes addRoute:@"/user/view/:userID" priority:1 handler:sometimesDecliningHandler];
+    [routes addRoute:@"/user/view/*" handler:[[self class] defaultRouteHandler]];
+    
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/:userID");
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    JLValidateParameter(@{@"tab": @"posts"});
+    XCTAssertEqualObjects(self.lastMatch[JLRouteURLKey], [NSURL URLWithString:@"tests://user/view/joeldev?tab=posts"]);
+    XCTAssertEqual(routes.resultCacheMissCount, 1UL);
+    XCTAssertEqual(routes.resultCacheHitCount, 1UL);
+    
+    // a cached URL whose handler declines carries on to the routes after it
+    declines = YES;
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/*");
+    XCTAssertEqual(routes.resultCacheHitCount, 2UL);
+    declines = NO;
+    
+    // changing the global options forgets the URL
+    [JLRoutes setShouldDecodePlusSymbols:NO];
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    JLValidatePattern(@"/user/view/:userID");
+    XCTAssertEqual(routes.resultCacheMissCount, 2UL);
+    [JLRoutes setShouldDecodePlusSymbols:YES];
+    
+    // so does changing the routes
+    [routes addRoute:@"/user/view/joeldev" priority:2 handler:[[self class] defaultRouteHandler]];
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    JLValidatePattern(@"/user/view/joeldev");
+    XCTAssertEqual(routes.resultCacheMissCount, 3UL);
+    
+    [routes removeRoute:@"/user/view/joeldev"];
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    JLValidatePattern(@"/user/view/:userID");
+    XCTAssertEqual(routes.resultCacheMissCount, 4UL);
+    
+    // the least recently routed URL is forgotten first
+    [self route:@"tests://user/view/one"];
+    [self route:@"tests://user/view/two"];
+    [self route:@"tests://user/view/one"];
+    XCTAssertEqual(routes.resultCacheHitCount, 3UL);
+    [self route:@"tests://user/view/joeldev?tab=posts"];
+    XCTAssertEqual(routes.resultCacheMissCount, 7UL);
+    
+    routes.resultCacheCapacity = 0;
+    XCTAssertEqual(routes.resultCacheHitCount, 0UL);
+}
+
+- (void)testFirstPathComponentFilter
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    JLRoutes *routes = [JLRoutes routesForScheme:@"filter"];
+    routes.rejectedURLCacheCapacity = 4;
+    
+    [routes addRoute:@"/user/view/:userID" handler:defaultHandler];
+    [routes addRoute:@"/user#/view/:userID" handler:defaultHandler];
+    [routes addRoute:@"/www.mydomain.com/sign_in" handler:defaultHandler];
+    
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"filter://user/view/joeldev"]]);
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"filter://user#/view/joeldev"]]);
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"filter://users/view/joeldev"]]);
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"filter://user/edit/joeldev"]]);
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"filter://user/edit/joeldev"]]);
+    
+    [self route:@"filter://users/view/joeldev"];
+    JLValidateNoLastMatch();
+    
+    [JLRoutes setAlwaysTreatsHostAsPathComponent:YES];
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"filter://www.mydomain.com/sign_in"]]);
+    [JLRoutes setAlwaysTreatsHostAsPathComponent:NO];
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"filter://www.mydomain.com/sign_in"]]);
+    
+    // recently rejected URLs are forgotten when the routes change
+    [routes addRoute:@"/user/edit/:userID" handler:defaultHandler];
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"filter://user/edit/joeldev"]]);
+    
+    // a route starting with a variable can match any first path component
+    [routes addRoute:@"/:object/list" handler:defaultHandler];
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"filter://users/list"]]);
+    XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"filter://users/view/joeldev"]]);
+    
+    [routes removeRoute:@"/:object/list"];
+    [routes addRoute:@"/*" priority:-1 handler:defaultHandler];
+    
+    [self route:@"filter://users/view/joeldev"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/*");
+}
+
+- (void)testLayeredParameters
+{
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/:userID" handler:[[self class] defaultRouteHandler]];
+    
+    [self route:@"tests://user/view/joeldev?userID=query&tab=posts&JLRoutePattern=query" withParameters:@{@"tab": @"passed", @"extra": @"value"}];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/:userID");
+    JLValidateParameterCount(3);
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    JLValidateParameter(@{@"tab": @"passed"});
+    JLValidateParameter(@{@"extra": @"value"});
+    
+    NSDictionary *expectedParameters = @{@"userID": @"joeldev", @"tab": @"passed", @"extra": @"value", JLRoutePatternKey: @"/user/view/:userID", JLRouteURLKey: [NSURL URLWithString:@"tests://user/view/joeldev?userID=query&tab=posts&JLRoutePattern=query"], JLRouteSchemeKey: JLRoutesGlobalRoutesScheme};
+    XCTAssertEqualObjects(self.lastMatch, expectedParameters);
+    XCTAssertEqualObjects([NSSet setWithArray:self.lastMatch.allKeys], [NSSet setWithArray:expectedParameters.allKeys]);
+    XCTAssertEqualObjects([self.lastMatch copy], expectedParameters);
+    
+    NSMutableDictionary *mutableParameters = [self.lastMatch mutableCopy];
+    mutableParameters[@"tab"] = @"changed";
+    XCTAssertEqualObjects(self.lastMatch[@"tab"], @"passed");
+    
+    NSUInteger enumeratedCount = 0;
+    for (NSString *key in self.lastMatch) {
+        XCTAssertNotNil(expectedParameters[key]);
+        enumeratedCount++;
+    }
+    XCTAssertEqual(enumeratedCount, expectedParameters.count);
+}
+
+- (void)testBatchRegistrationOrder
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    JLRoutes *routes = [JLRoutes routesForScheme:@"batch"];
+    
+    [routes addRoute:@"/existing/high" priority:10 handler:defaultHandler];
+    [routes addRoute:@"/existing/low" priority:1 handler:defaultHandler];
+    [routes addRoute:@"/existing/default" handler:defaultHandler];
+    [routes addRoute:@"/single/high" priority:10 handler:defaultHandler];
+    
+    [routes addRoutes:@[@"/batch/one", @"/batch/two"] handler:defaultHandler];
+    [routes addRoute:@"/single/low" priority:1 handler:defaultHandler];
+    
+    NSArray *expectedPatterns = @[@"/existing/high", @"/single/high", @"/existing/low", @"/single/low", @"/existing/default", @"/batch/one", @"/batch/two"];
+    XCTAssertEqualObjects([routes.routes valueForKey:@"pattern"], expectedPatterns);
+    
+    // optional patterns expand into the same batch
+    [routes addRoutes:@[@"/batch/three(/:option)"] handler:defaultHandler];
+    
+    [self route:@"batch://batch/three/value"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/batch/three/:option");
+    JLValidateParameterCount(1);
+    JLValidateParameter(@{@"option": @"value"});
+}
+
+- (void)testBatchUpdates
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    JLRoutes *routes = [JLRoutes globalRoutes];
+    
+    [routes addRoute:@"/inbox/:message" handler:defaultHandler];
+    
+    [routes performBatchUpdates:^{
+        [routes addRoute:@"/inbox/*" priority:1 handler:defaultHandler];
+        [routes addRoute:@"/inbox/archive" priority:5 handler:defaultHandler];
+        
+        [routes performBatchUpdates:^{
+            [routes addRoute:@"/settings(/:section)" handler:defaultHandler];
+            [routes addRoute:@"/discarded" handler:defaultHandler];
+        }];
+        
+        // nothing is added until the outermost batch ends
+        XCTAssertEqual(routes.routes.count, 1UL);
+        XCTAssertFalse([routes canRouteURL:[NSURL URLWithString:@"tests://settings"]]);
+        
+        [routes removeRoute:@"/discarded"];
+    }];
+    
+    XCTAssertEqual(routes.routes.count, 5UL);
+    XCTAssertEqualObjects(routes.routes[0].pattern, @"/inbox/archive");
+    XCTAssertEqualObjects(routes.routes[1].pattern, @"/inbox/*");
+    XCTAssertEqualObjects(routes.routes[2].pattern, @"/inbox/:message");
+    
+    [self route:@"tests://inbox/archive"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/inbox/archive");
+    
+    [self route:@"tests://inbox/123"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/inbox/*");
+    
+    [self route:@"tests://settings/privacy"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/settings/:section");
+    
+    [self route:@"tests://discarded"];
+    JLValidateNoLastMatch();
+    
+    [routes addRouteDefinitions:@[[[JLRRouteDefinition alloc] initWithScheme:JLRoutesGlobalRoutesScheme pattern:@"/inbox/:message/reply" priority:0 handlerBlock:defaultHandler],
+                                  [[JLRRouteDefinition alloc] initWithScheme:JLRoutesGlobalRoutesScheme pattern:@"/inbox/:message" priority:2 handlerBlock:defaultHandler]]];
+    
+    [self route:@"tests://inbox/123"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/inbox/:message");
+    JLValidateParameter(@{@"message": @"123"});
+    
+    [self route:@"tests://inbox/123/reply"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/inbox/*");
+}
+
+- (void)testCompiledRouteTable
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    JLRoutes *routes = [JLRoutes routesForScheme:@"compiled"];
+    
+    [routes addRoute:@"/user/view/:userID" handler:defaultHandler];
+    [routes addRoute:@"/path/:thing(/new)(/anotherpath/:anotherthing)" priority:5 handler:defaultHandler];
+    [routes addRoute:@"/item/:itemID<int>" handler:defaultHandler];
+    [routes addRoute:@"/broken/:value<[a-z>" handler:defaultHandler];
+    [routes addRoute:@"/files/*/:name" handler:defaultHandler];
+    
+    NSData *routeTable = [routes compiledRouteTable];
+    uint64_t routeSetHash = routes.routeSetHash;
+    NSArray <NSString *> *expectedPatterns = [routes.routes valueForKey:@"pattern"];
+    NSArray *expectedPatternComponents = [routes.routes valueForKey:@"patternComponents"];
+    XCTAssertNotNil(routeTable);
+    
+    NSDictionary *handlers = @{@"/user/view/:userID": defaultHandler, @"/path/:thing(/new)(/anotherpath/:anotherthing)": defaultHandler, @"/item/:itemID<int>": defaultHandler, @"/broken/:value<[a-z>": defaultHandler, @"/files/*/:name": defaultHandler};
+    
+    [JLRoutes unregisterRouteScheme:@"compiled"];
+    routes = [JLRoutes routesForScheme:@"compiled"];
+    
+    NSError *error = nil;
+    XCTAssertTrue([routes addRoutesFromCompiledRouteTable:routeTable routeSetHash:routeSetHash handlers:handlers error:&error]);
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([routes.routes valueForKey:@"pattern"], expectedPatterns);
+    XCTAssertEqualObjects([routes.routes valueForKey:@"priority"], (@[@5, @5, @5, @5, @0, @0, @0, @0]));
+    XCTAssertEqualObjects([routes.routes valueForKey:@"patternComponents"], expectedPatternComponents);
+    XCTAssertEqual(routes.routeSetHash, routeSetHash);
+    XCTAssertEqualObjects([routes compiledRouteTable], routeTable);
+    
+    // the routes are created from their stored segments
+    JLRRouteDefinition *wildcardRoute = routes.routes.lastObject;
+    XCTAssertEqual(wildcardRoute.segmentCount, 3UL);
+    XCTAssertEqual(wildcardRoute.segments[1].type, JLRRouteSegmentTypeWildcard);
+    XCTAssertEqualObjects(wildcardRoute.segments[2].value, @"name");
+    XCTAssertEqual(wildcardRoute.minimumPathComponentCount, 2UL);
+    XCTAssertEqual(wildcardRoute.maximumPathComponentCount, NSUIntegerMax);
+    XCTAssertEqualObjects(routes.routes[5].segments[1].constraint.pattern, @"int");
+    
+    [self route:@"compiled://item/42"];
+    JLValidatePattern(@"/item/:itemID<int>");
+    JLValidateParameter(@{@"itemID": @42});
+    
+    [self route:@"compiled://item/abc"];
+    JLValidateNoLastMatch();
+    
+    [self route:@"compiled://broken/abc"];
+    JLValidateNoLastMatch();
+    
+    [self route:@"compiled://files/a/b/report"];
+    JLValidatePattern(@"/files/*/:name");
+    JLValidateParameter(@{@"name": @"report"});
+    JLValidateParameter((@{JLRouteWildcardComponentsKey: @[@"a", @"b"]}));
+    
+    [self route:@"compiled://path/abc/new"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/path/:thing/new");
+    JLValidateParameter(@{@"thing": @"abc"});
+    
+    [self route:@"compiled://user/view/joeldev"];
+    JLValidateAnyRouteMatched();
+    JLValidateScheme(@"compiled");
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    
+    // changing the routes changes the hash
+    [routes addRoute:@"/user/edit/:userID" handler:defaultHandler];
+    XCTAssertNotEqual(routes.routeSetHash, routeSetHash);
+    
+    // nothing is added from a table that doesn't match
+    JLRoutes *otherRoutes = [JLRoutes routesForScheme:@"other"];
+    XCTAssertFalse([otherRoutes addRoutesFromCompiledRouteTable:routeTable routeSetHash:routeSetHash handlers:handlers error:&error]);
+    XCTAssertEqualObjects(error.domain, JLRoutesErrorDomain);
+    XCTAssertEqual(error.code, JLRoutesErrorRouteSetHashMismatch);
+    
+    [JLRoutes unregisterRouteScheme:@"compiled"];
+    routes = [JLRoutes routesForScheme:@"compiled"];
+    
+    XCTAssertFalse([routes addRoutesFromCompiledRouteTable:routeTable routeSetHash:routeSetHash + 1 handlers:handlers error:&error]);
+    XCTAssertEqual(error.code, JLRoutesErrorRouteSetHashMismatch);
+    
+    XCTAssertFalse([routes addRoutesFromCompiledRouteTable:routeTable routeSetHash:routeSetHash handlers:@{@"/user/view/:userID": defaultHandler} error:&error]);
+    XCTAssertEqual(error.code, JLRoutesErrorMissingHandler);
+    
+    XCTAssertFalse([routes addRoutesFromCompiledRouteTable:[routeTable subdataWithRange:NSMakeRange(0, routeTable.length - 1)] routeSetHash:routeSetHash handlers:handlers error:&error]);
+    XCTAssertEqual(error.code, JLRoutesErrorInvalidRouteTable);
+    
+    NSMutableData *corruptedRouteTable = [routeTable mutableCopy];
+    ((uint8_t *)corruptedRouteTable.mutableBytes)[corruptedRouteTable.length - 1] ^= 0x01;
+    XCTAssertFalse([routes addRoutesFromCompiledRouteTable:corruptedRouteTable routeSetHash:routeSetHash handlers:handlers error:&error]);
+    XCTAssertEqual(error.code, JLRoutesErrorInvalidRouteTable);
+    
+    // the segments aren't covered by the route set hash, but they can't be corrupted unnoticed either. they follow the 44 byte
+    // header, the string records and the route records.
+    uint32_t stringCount = 0;
+    [routeTable getBytes:&stringCount range:NSMakeRange(36, sizeof(stringCount))];
+    NSUInteger segmentRecordsOffset = 44 + CFSwapInt32LittleToHost(stringCount) * 8 + expectedPatterns.count * 40;
+    corruptedRouteTable = [routeTable mutableCopy];
+    ((uint8_t *)corruptedRouteTable.mutableBytes)[segmentRecordsOffset] ^= 0x01;
+    XCTAssertFalse([routes addRoutesFromCompiledRouteTable:corruptedRouteTable routeSetHash:routeSetHash handlers:handlers error:&error]);
+    XCTAssertEqual(error.code, JLRoutesErrorInvalidRouteTable);
+    
+    XCTAssertEqual(routes.routes.count, 0UL);
+    
+    // a table can't be compiled with an asynchronous route, since it would come back as a synchronous one or not at all
+    [routes addRoute:@"/user/view/:userID" handler:defaultHandler];
+    XCTAssertNotNil([routes compiledRouteTable]);
+    [routes addRoute:@"/user/edit/:userID" priority:0 asyncHandler:^(NSDictionary *parameters, void (^completion)(BOOL didRoute)) {
+        completion(YES);
+    }];
+    XCTAssertNil([routes compiledRouteTable]);
+}
+
+- (void)testAsynchronousRouting
+{
+    NSMutableArray <NSString *> *calls = [NSMutableArray array];
+    JLRoutes *routes = [JLRoutes routesForScheme:@"async"];
+    
+    [routes addRoute:@"/user/view/:userID" priority:2 asyncHandler:^(NSDictionary *parameters, void (^completion)(BOOL didRoute)) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [calls addObject:@"declining"];
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+            completion(NO);
+        });
+    }];
+    
+    [routes addRoute:@"/user/view/:userID" priority:1 handler:^BOOL (NSDictionary *parameters) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [calls addObject:@"handling"];
+        testsInstance.lastMatch = parameters;
+        return YES;
+    }];
+    
+    XCTestExpectation *routedExpectation = [self expectationWithDescription:@"Routed"];
+    [routes routeURL:[NSURL URLWithString:@"async://user/view/joeldev"] withParameters:@{@"extra": @"value"} queue:dispatch_get_main_queue() completion:^(BOOL didRoute) {
+        XCTAssertTrue(didRoute);
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqualObjects(calls, (@[@"declining", @"handling"]));
+        [routedExpectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    JLValidateParameter(@{@"extra": @"value"});
+    
+    __block BOOL calledUnmatchedURLHandler = NO;
+    routes.unmatchedURLHandler = ^(JLRoutes *unmatchedRoutes, NSURL *URL, NSDictionary *parameters) {
+        XCTAssertTrue([NSThread isMainThread]);
+        calledUnmatchedURLHandler = YES;
+    };
+    
+    XCTestExpectation *unmatchedExpectation = [self expectationWithDescription:@"Not routed"];
+    [JLRoutes routeURL:[NSURL URLWithString:@"async://nothing/here"] withParameters:nil queue:dispatch_get_main_queue() completion:^(BOOL didRoute) {
+        XCTAssertFalse(didRoute);
+        XCTAssertTrue(calledUnmatchedURLHandler);
+        [unmatchedExpectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    // there's no waiting for an asynchronous handler when routing synchronously
+    [calls removeAllObjects];
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"async://user/view/joeldev"]]);
+    XCTAssertEqualObjects(calls, @[@"declining"]);
+}
+
+- (void)testRouteDefinitionMatchingURL
+{
+    __block NSUInteger handlerCallCount = 0;
+    BOOL (^countingHandler)(NSDictionary *) = ^BOOL (NSDictionary *parameters) {
+        handlerCallCount++;
+        return NO;
+    };
+    
+    JLRoutes *routes = [JLRoutes globalRoutes];
+    [routes addRoute:@"/user/view/:userID" priority:1 handler:countingHandler];
+    [routes addRoute:@"/user/:action/*" handler:countingHandler];
+    
+    NSDictionary <NSString *, NSValue *> *variableRanges = nil;
+    JLRRouteDefinition *route = [routes routeDefinitionMatchingURL:[NSURL URLWithString:@"tests://user/view/joel%20levin?tab=posts"] variableRanges:&variableRanges];
+    XCTAssertEqualObjects(route.pattern, @"/user/view/:userID");
+    XCTAssertEqualObjects(variableRanges, @{@"userID": [NSValue valueWithRange:NSMakeRange(2, 1)]});
+    
+    route = [routes routeDefinitionMatchingURL:[NSURL URLWithString:@"tests://user/edit/joeldev/posts"] variableRanges:&variableRanges];
+    XCTAssertEqualObjects(route.pattern, @"/user/:action/*");
+    XCTAssertEqualObjects(variableRanges, (@{@"action": [NSValue valueWithRange:NSMakeRange(1, 1)], JLRouteWildcardComponentsKey: [NSValue valueWithRange:NSMakeRange(2, 2)]}));
+    
+    route = [routes routeDefinitionMatchingURL:[NSURL URLWithString:@"tests://user/edit"] variableRanges:&variableRanges];
+    XCTAssertEqualObjects(variableRanges[JLRouteWildcardComponentsKey], [NSValue valueWithRange:NSMakeRange(2, 0)]);
+    
+    XCTAssertNil([routes routeDefinitionMatchingURL:[NSURL URLWithString:@"tests://post/joeldev"] variableRanges:&variableRanges]);
+    XCTAssertNil(variableRanges);
+    XCTAssertNil([routes routeDefinitionMatchingURL:nil]);
+    XCTAssertEqualObjects([routes routeDefinitionMatchingURL:[NSURL URLWithString:@"tests://user/view/joeldev"]].pattern, @"/user/view/:userID");
+    
+    XCTAssertEqual(handlerCallCount, 0UL);
+}
+
+- (void)testRouteDefinitionsMatchingURLs
+{
+    __block NSUInteger handlerCallCount = 0;
+    BOOL (^countingHandler)(NSDictionary *) = ^BOOL (NSDictionary *parameters) {
+        handlerCallCount++;
+        return YES;
+    };
+    
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/:userID" handler:countingHandler];
+    [[JLRoutes routesForScheme:@"classify"] addRoute:@"/user/view/:userID" priority:1 handler:countingHandler];
+    [[JLRoutes routesForScheme:@"classify"] addRoute:@"/user/*" handler:countingHandler];
+    
+    NSMutableArray <NSURL *> *URLs = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 1000; index++) {
+        [URLs addObject:[NSURL URLWithString:[NSString stringWithFormat:@"classify://user/view/%@", @(index)]]];
+        [URLs addObject:[NSURL URLWithString:[NSString stringWithFormat:@"classify://user/edit/%@", @(index)]]];
+        [URLs addObject:[NSURL URLWithString:[NSString stringWithFormat:@"tests://user/view/%@", @(index)]]];
+        [URLs addObject:[NSURL URLWithString:[NSString stringWithFormat:@"classify://post/%@", @(index)]]];
+    }
+    
+    NSArray *routeDefinitions = [JLRoutes routeDefinitionsMatchingURLs:URLs];
+    XCTAssertEqual(routeDefinitions.count, URLs.count);
+    
+    for (NSUInteger index = 0; index < URLs.count; index += 4) {
+        XCTAssertEqualObjects([routeDefinitions[index] pattern], @"/user/view/:userID");
+        XCTAssertEqualObjects([routeDefinitions[index] scheme], @"classify");
+        XCTAssertEqualObjects([routeDefinitions[index + 1] pattern], @"/user/*");
+        XCTAssertEqualObjects([routeDefinitions[index + 2] scheme], JLRoutesGlobalRoutesScheme);
+        XCTAssertEqualObjects(routeDefinitions[index + 3], [NSNull null]);
+    }
+    
+    XCTAssertEqual(handlerCallCount, 0UL);
+    
+    // the instance method only looks in its own scheme, unless it falls back
+    JLRoutes *routes = [JLRoutes routesForScheme:@"classify"];
+    NSArray <NSURL *> *schemeURLs = @[[NSURL URLWithString:@"classify://user/edit/joeldev"], [NSURL URLWithString:@"classify://account"]];
+    routeDefinitions = [routes routeDefinitionsMatchingURLs:schemeURLs];
+    XCTAssertEqualObjects([routeDefinitions[0] pattern], @"/user/*");
+    XCTAssertEqualObjects(routeDefinitions[1], [NSNull null]);
+    
+    [[JLRoutes globalRoutes] addRoute:@"/account" handler:countingHandler];
+    routes.shouldFallbackToGlobalRoutes = YES;
+    routeDefinitions = [routes routeDefinitionsMatchingURLs:schemeURLs];
+    XCTAssertEqualObjects([routeDefinitions[0] pattern], @"/user/*");
+    XCTAssertEqualObjects([routeDefinitions[1] pattern], @"/account");
+    
+    XCTAssertEqualObjects([JLRoutes routeDefinitionsMatchingURLs:@[]], @[]);
+}
+
+- (void)testInstrumentation
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"instrumentation"];
+    [routes addRoute:@"/user/:userID" handler:[[self class] defaultRouteHandler]];
+    [routes addRoute:@"/post/:postID" handler:[[self class] defaultRouteHandler]];
+    
+    JLRRouteDefinition *userRoute = routes.routes[0];
+    JLRRouteDefinition *postRoute = routes.routes[1];
+    
+    // nothing is counted or measured by default
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"instrumentation://post/5"]]);
+    XCTAssertEqual(userRoute.attemptCount, 0UL);
+    XCTAssertEqual(postRoute.matchCount, 0UL);
+    
+    __block JLRRoutingMetrics *lastMetrics = nil;
+    routes.routingMetricsHandler = ^(JLRoutes *metricsRoutes, JLRRoutingMetrics *metrics) {
+        lastMetrics = metrics;
+    };
+    
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"instrumentation://post/5"]]);
+    XCTAssertEqualObjects(lastMetrics.URL, [NSURL URLWithString:@"instrumentation://post/5"]);
+    XCTAssertTrue(lastMetrics.didRoute);
+    XCTAssertEqual(lastMetrics.matchedRoute, postRoute);
+    XCTAssertEqual(lastMetrics.attemptCount, 2UL);
+    XCTAssertGreaterThan(lastMetrics.parseDuration + lastMetrics.matchDuration + lastMetrics.handlerDuration, 0.0);
+    
+    // the metrics handler alone doesn't turn on the counters
+    XCTAssertEqual(userRoute.attemptCount, 0UL);
+    
+    [JLRoutes setInstrumentationEnabled:YES];
+    
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"instrumentation://post/6"]]);
+    XCTAssertEqual(userRoute.attemptCount, 1UL);
+    XCTAssertEqual(userRoute.matchCount, 0UL);
+    XCTAssertEqual(postRoute.attemptCount, 1UL);
+    XCTAssertEqual(postRoute.matchCount, 1UL);
+    
+    // asking counts too, but only routing is reported to the metrics handler
+    lastMetrics = nil;
+    XCTAssertTrue([routes canRouteURL:[NSURL URLWithString:@"instrumentation://user/2"]]);
+    XCTAssertEqual(userRoute.attemptCount, 2UL);
+    XCTAssertEqual(userRoute.matchCount, 1UL);
+    XCTAssertNil(lastMetrics);
+    
+    // no route starts with 'missing', so none are tried
+    XCTAssertFalse([routes routeURL:[NSURL URLWithString:@"instrumentation://missing/1"]]);
+    XCTAssertNotNil(lastMetrics);
+    XCTAssertFalse(lastMetrics.didRoute);
+    XCTAssertNil(lastMetrics.matchedRoute);
+    XCTAssertEqual(lastMetrics.attemptCount, 0UL);
+    XCTAssertEqual(userRoute.attemptCount, 2UL);
+    
+    // remembered matches are counted as well
+    routes.resultCacheCapacity = 4;
+    [routes routeURL:[NSURL URLWithString:@"instrumentation://post/7"]];
+    [routes routeURL:[NSURL URLWithString:@"instrumentation://post/7"]];
+    XCTAssertEqual(postRoute.matchCount, 3UL);
+    XCTAssertEqual(lastMetrics.attemptCount, 0UL);
+    XCTAssertEqual(lastMetrics.matchedRoute, postRoute);
+}
+
+- (void)testAdaptiveRouteOrder
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"adaptive"];
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    [routes addRoute:@"/pinned/:id" priority:1 handler:defaultHandler];
+    [routes addRoute:@"/rare/:id" handler:defaultHandler];
+    [routes addRoute:@"/other/:id" handler:defaultHandler];
+    [routes addRoute:@"/hot/:id" handler:defaultHandler];
+    [routes addRoute:@"/hot/special" handler:defaultHandler];
+    [routes addRoute:@"/:kind/:id" handler:defaultHandler];
+    
+    NSArray *registeredOrder = @[@"/pinned/:id", @"/rare/:id", @"/other/:id", @"/hot/:id", @"/hot/special", @"/:kind/:id"];
+    
+    JLRRouteDefinition *hotRoute = routes.routes[3];
+    XCTAssertTrue([hotRoute canMatchSameURLAsRouteDefinition:routes.routes[4]]);
+    XCTAssertTrue([hotRoute canMatchSameURLAsRouteDefinition:routes.routes[5]]);
+    XCTAssertFalse([hotRoute canMatchSameURLAsRouteDefinition:routes.routes[1]]);
+    
+    // nothing moves unless asked to
+    for (NSUInteger index = 0; index < 20; index++) {
+        [self route:@"adaptive://hot/1"];
+    }
+    XCTAssertEqualObjects([routes.routes valueForKey:@"pattern"], registeredOrder);
+    
+    routes.adaptsRouteOrder = YES;
+    routes.routeOrderAdaptationInterval = 10;
+    
+    for (NSUInteger index = 0; index < 9; index++) {
+        [self route:@"adaptive://hot/1"];
+    }
+    XCTAssertEqualObjects([routes.routes valueForKey:@"pattern"], registeredOrder);
+    
+    // the tenth handled URL reorders, in the background. the hot route passes the routes it can't share a URL with, but not the catch all
+    // registered after it, and the routes it could share a URL with stay behind it.
+    [self route:@"adaptive://hot/1"];
+    NSArray *adaptedOrder = @[@"/pinned/:id", @"/hot/:id", @"/rare/:id", @"/other/:id", @"/hot/special", @"/:kind/:id"];
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL (JLRoutes *evaluatedRoutes, NSDictionary *bindings) {
+        return [[evaluatedRoutes.routes valueForKey:@"pattern"] isEqualToArray:adaptedOrder];
+    }] evaluatedWithObject:routes handler:nil];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    // which route handles a URL doesn't change
+    [self route:@"adaptive://hot/special"];
+    JLValidatePattern(@"/hot/:id");
+    [self route:@"adaptive://rare/2"];
+    JLValidatePattern(@"/rare/:id");
+    [self route:@"adaptive://pinned/2"];
+    JLValidatePattern(@"/pinned/:id");
+    [self route:@"adaptive://misc/2"];
+    JLValidatePattern(@"/:kind/:id");
+    
+    // and routes registered later still go after the routes of the same priority
+    [routes addRoute:@"/late/:id" handler:defaultHandler];
+    XCTAssertEqualObjects(routes.routes.lastObject.pattern, @"/late/:id");
+}
+
+- (void)testRouteConflicts
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"conflicts"];
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    [routes addRoute:@"/user/:id" handler:defaultHandler];
+    [routes addRoute:@"/user/view" handler:defaultHandler];
+    [routes addRoute:@"/:kind/:id" handler:defaultHandler];
+    [routes addRoute:@"/pages/*" handler:defaultHandler];
+    [routes addRoute:@"/pages/about" handler:defaultHandler];
+    
+    XCTAssertTrue([routes.routes[0] matchesEveryURLMatchedByRouteDefinition:routes.routes[1]]);
+    XCTAssertFalse([routes.routes[1] matchesEveryURLMatchedByRouteDefinition:routes.routes[0]]);
+    XCTAssertFalse([routes.routes[3] matchesEveryURLMatchedByRouteDefinition:routes.routes[2]]);
+    
+    NSMutableArray *conflictDescriptions = [NSMutableArray array];
+    for (JLRRouteConflict *conflict in [routes routeConflicts]) {
+        NSString *type = conflict.type == JLRRouteConflictTypeShadowed ? @"shadowed by" : @"ambiguous with";
+        [conflictDescriptions addObject:[NSString stringWithFormat:@"%@ %@ %@", conflict.route.pattern, type, conflict.precedingRoute.pattern]];
+    }
+    
+    NSArray *expectedConflicts = @[@"/user/view shadowed by /user/:id",
+                                   @"/:kind/:id ambiguous with /user/:id",
+                                   @"/:kind/:id ambiguous with /user/view",
+                                   @"/pages/* ambiguous with /:kind/:id",
+                                   @"/pages/about shadowed by /:kind/:id",
+                                   @"/pages/about shadowed by /pages/*"];
+    XCTAssertEqualObjects(conflictDescriptions, expectedConflicts);
+    
+    NSArray *removedRoutes = [routes removeShadowedRoutes];
+    XCTAssertEqualObjects([removedRoutes valueForKey:@"pattern"], (@[@"/user/view", @"/pages/about"]));
+    XCTAssertEqualObjects([routes.routes valueForKey:@"pattern"], (@[@"/user/:id", @"/:kind/:id", @"/pages/*"]));
+    XCTAssertEqual([routes routeConflicts].count, 2UL);
+    XCTAssertEqual([routes removeShadowedRoutes].count, 0UL);
+    
+    // the URLs the removed routes could have matched still go where they went before
+    [self route:@"conflicts://user/view"];
+    JLValidatePattern(@"/user/:id");
+    [self route:@"conflicts://pages/about"];
+    JLValidatePattern(@"/:kind/:id");
+    [self route:@"conflicts://pages/about/team"];
+    JLValidatePattern(@"/pages/*");
+}
+
+- (void)testLogging
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"logging"];
+    JLRTestLogger *logger = [[JLRTestLogger alloc] init];
+    JLRDescriptionCounter *counter = [[JLRDescriptionCounter alloc] init];
+    
+    [routes addRoute:@"/item/:id" handler:[[self class] defaultRouteHandler]];
+    
+    [JLRoutes setLogger:logger];
+    [JLRoutes setLogLevel:JLRLogLevelInfo];
+    XCTAssertFalse([JLRoutes isVerboseLoggingEnabled]);
+    XCTAssertEqual([JLRoutes logger], logger);
+    
+    // debug messages, like the final parameters, aren't formatted
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"logging://item/1"] withParameters:@{@"counter": counter}]);
+    XCTAssertEqual(counter.descriptionCount, 0UL);
+    XCTAssertTrue([logger.messages.lastObject hasPrefix:@"Successfully matched"]);
+    XCTAssertFalse([logger.levels containsIndex:JLRLogLevelDebug]);
+    
+    [JLRoutes setVerboseLoggingEnabled:YES];
+    XCTAssertEqual([JLRoutes logLevel], JLRLogLevelDebug);
+    
+    XCTAssertTrue([routes routeURL:[NSURL URLWithString:@"logging://item/1"] withParameters:@{@"counter": counter}]);
+    XCTAssertGreaterThan(counter.descriptionCount, 0UL);
+    XCTAssertTrue([logger.levels containsIndex:JLRLogLevelDebug]);
+    
+    // with verbose logging, shadowed routes are reported as they're added
+    [routes addRoute:@"/item/latest" handler:[[self class] defaultRouteHandler]];
+    XCTAssertTrue([logger.messages.lastObject containsString:@"shadowed"]);
+    
+    // but not below it, since checking makes registering slower
+    [JLRoutes setLogLevel:JLRLogLevelWarning];
+    NSUInteger shadowedMessageCount = logger.messages.count;
+    [routes addRoute:@"/item/newest" handler:[[self class] defaultRouteHandler]];
+    XCTAssertEqual(logger.messages.count, shadowedMessageCount);
+    
+    [JLRoutes setLogLevel:JLRLogLevelOff];
+    NSUInteger messageCount = logger.messages.count;
+    [self route:@"logging://nothing/here"];
+    XCTAssertEqual(logger.messages.count, messageCount);
+    
+    [JLRoutes setLogger:nil];
+    XCTAssertTrue([[JLRoutes logger] isKindOfClass:[JLROSLogger class]]);
+    [JLRoutes setVerboseLoggingEnabled:YES];
+}
+
+- (void)testInternedRouteStrings
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    NSString *scheme = [NSMutableString stringWithString:@"interned"];
+    
+    [[JLRoutes routesForScheme:scheme] addRoute:@"/user/:id" handler:defaultHandler];
+    [[JLRoutes routesForScheme:scheme] addRoute:@"/post/:id/:action" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:[NSMutableString stringWithString:@"/user/:id"] handler:defaultHandler];
+    
+    JLRRouteDefinition *userRoute = [JLRoutes routesForScheme:scheme].routes[0];
+    JLRRouteDefinition *postRoute = [JLRoutes routesForScheme:scheme].routes[1];
+    JLRRouteDefinition *globalUserRoute = [JLRoutes globalRoutes].routes[0];
+    
+    // equal strings are shared by every route using them
+    XCTAssertEqual(userRoute.segments[1].value, postRoute.segments[1].value);
+    XCTAssertEqual(userRoute.segments[1].value, globalUserRoute.segments[1].value);
+    XCTAssertEqual(userRoute.pattern, globalUserRoute.pattern);
+    XCTAssertEqual(userRoute.scheme, postRoute.scheme);
+    XCTAssertNotEqual(userRoute.scheme, (id)scheme);
+    
+    [self route:@"interned://post/5/edit"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/post/:id/:action");
+    JLValidateScheme(@"interned");
+    JLValidateParameterCount(2);
+    JLValidateParameter(@{@"id": @"5"});
+    JLValidateParameter(@{@"action": @"edit"});
+    
+    [self route:@"interned://user/1?id=2"];
+    JLValidateParameter(@{@"id": @"1"});
+    XCTAssertEqualObjects(self.lastMatch[JLRouteURLKey], [NSURL URLWithString:@"interned://user/1?id=2"]);
+}
+
+- (void)testScratchStorage
+{
+    // the thread's storage and its buffers are reused once they're given back
+    JLRScratchStorage *storage = JLRScratchStorageAcquire();
+    void *buffer = JLRScratchStorageGetBuffer(storage, JLRScratchBufferPath, 64);
+    
+    // storage taken while the thread's is in use is separate
+    JLRScratchStorage *nestedStorage = JLRScratchStorageAcquire();
+    XCTAssertNotEqual(storage, nestedStorage);
+    XCTAssertNotEqual(buffer, JLRScratchStorageGetBuffer(nestedStorage, JLRScratchBufferPath, 64));
+    JLRScratchStorageRelinquish(nestedStorage);
+    JLRScratchStorageRelinquish(storage);
+    
+    storage = JLRScratchStorageAcquire();
+    XCTAssertEqual(buffer, JLRScratchStorageGetBuffer(storage, JLRScratchBufferPath, 32));
+    JLRScratchStorageRelinquish(storage);
+    
+    id defaultRoutes = [JLRoutes globalRoutes];
+    [defaultRoutes addRoute:@"/scratch/:id/*" handler:[[self class] defaultRouteHandler]];
+    [defaultRoutes addRoute:@"/nested/:id" handler:^BOOL(NSDictionary *parameters) {
+        // routing from inside a handler uses separate scratch storage
+        [JLRoutes routeURL:[NSURL URLWithString:@"tests://scratch/inner/a/b"]];
+        return [[self class] defaultRouteHandler](parameters);
+    }];
+    
+    NSString *longComponent = [@"" stringByPaddingToLength:300 withString:@"abc" startingAtIndex:0];
+    [self route:[NSString stringWithFormat:@"tests://scratch/1/%@/%@?name=J%%C3%%B6rg%%20Smith", longComponent, longComponent]];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/scratch/:id/*");
+    JLValidateParameter(@{@"id": @"1"});
+    JLValidateParameter((@{JLRouteWildcardComponentsKey: @[longComponent, longComponent]}));
+    JLValidateParameter(@{@"name": @"J\u00f6rg Smith"});
+    
+    [self route:@"tests://nested/2"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/nested/:id");
+    JLValidateParameter(@{@"id": @"2"});
+    
+    // an escaped percent sign decodes to itself rather than starting another escape
+    [self route:@"tests://scratch/3/x?name=100%25"];
+    JLValidateParameter(@{@"name": @"100%"});
+}
+
+- (void)testCompiledMatcher
+{
+    id defaultHandler = [[self class] defaultRouteHandler];
+    
+    [JLRoutes globalRoutes].usesCompiledMatcher = YES;
+    
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/:userID" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/current" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/user/view/admin" priority:10 handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/xyz/wildcard/*" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/:object/:action" handler:defaultHandler];
+    [[JLRoutes globalRoutes] addRoute:@"/path/:thing(/new)" handler:defaultHandler];
+    
+    [self route:@"tests://user/view/joeldev"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/:userID");
+    JLValidateParameter(@{@"userID": @"joeldev"});
+    
+    // registration order is preserved between a variable and a literal at the same depth
+    [self route:@"tests://user/view/current"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/:userID");
+    
+    // and priority still wins over registration order
+    [self route:@"tests://user/view/admin"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/admin");
+    
+    [self route:@"tests://xyz/wildcard"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/xyz/wildcard/*");
+    
+    [self route:@"tests://xyz/wildcard/matches/with/extra/path/components"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/xyz/wildcard/*");
+    JLValidateParameter((@{JLRouteWildcardComponentsKey: @[@"matches", @"with", @"extra", @"path", @"components"]}));
+    
+    [self route:@"tests://post/edit"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/:object/:action");
+    
+    [self route:@"tests://path/abc/new"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/path/:thing/new");
+    
+    [self route:@"tests://doesnt/exist/and/wont/match"];
+    JLValidateNoLastMatch();
+    
+    [[JLRoutes globalRoutes] removeRoute:@"/user/view/:userID"];
+    
+    [self route:@"tests://user/view/current"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/current");
+    
+    [self route:@"tests://user/view/joeldev"];
+    JLValidateNoLastMatch();
+    
+    // turning the compiled matcher off and back on compiles the existing routes
+    [JLRoutes globalRoutes].usesCompiledMatcher = NO;
+    [JLRoutes globalRoutes].usesCompiledMatcher = YES;
+    
+    [self route:@"tests://user/view/admin"];
+    JLValidateAnyRouteMatched();
+    JLValidatePattern(@"/user/view/admin");
+    
+    [[JLRoutes globalRoutes] removeAllRoutes];
+    
+    [self route:@"tests://user/view/admin"];
+    JLValidateNoLastMatch();
+}
+
+- (void)testRouteTrie
+{
+    JLRRouteDefinition *(^makeRoute)(NSString *, NSUInteger) = ^JLRRouteDefinition *(NSString *pattern, NSUInteger priority) {
+        return [[JLRRouteDefinition alloc] initWithScheme:JLRoutesGlobalRoutesScheme pattern:pattern priority:priority handlerBlock:nil];
+    };
+    
+    JLRRouteDefinition *wildcardRoute = makeRoute(@"/user/*", 0);
+    JLRRouteDefinition *variableRoute = makeRoute(@"/user/:userID", 0);
+    JLRRouteDefinition *adminRoute = makeRoute(@"/user/admin", 5);
+    JLRRouteDefinition *currentRoute = makeRoute(@"/user/current", 0);
+    
+    JLRRouteTrie *trie = [[JLRRouteTrie alloc] init];
+    for (JLRRouteDefinition *route in @[wildcardRoute, variableRoute, adminRoute, currentRoute]) {
+        [trie addRoute:route];
+    }
+    
+    // the routes of every node the path reaches come back in priority and then registration order
+    XCTAssertEqualObjects([trie candidateRoutesForPathComponents:@[@"user", @"admin"]], (@[adminRoute, wildcardRoute, variableRoute]));
+    XCTAssertEqualObjects([trie candidateRoutesForPathComponents:@[@"user", @"current"]], (@[wildcardRoute, variableRoute, currentRoute]));
+    XCTAssertEqualObjects([trie candidateRoutesForPathComponents:@[@"user"]], (@[wildcardRoute]));
+    
+    // paths no route can match all share one empty array
+    NSArray *noCandidates = [trie candidateRoutesForPathComponents:@[@"post", @"edit"]];
+    XCTAssertEqual(noCandidates.count, 0UL);
+    XCTAssertTrue([trie candidateRoutesForPathComponents:@[@"settings"]] == noCandidates);
+    
+    // a copy keeps the routes it was taken with while the trie it was copied from changes, and the other way around
+    JLRRouteTrie *copy = [trie copy];
+    JLRRouteDefinition *nameRoute = makeRoute(@"/user/:name", 10);
+    [trie removeRoute:variableRoute];
+    [trie addRoute:nameRoute];
+    
+    XCTAssertEqualObjects([copy candidateRoutesForPathComponents:@[@"user", @"current"]], (@[wildcardRoute, variableRoute, currentRoute]));
+    XCTAssertEqualObjects([trie candidateRoutesForPathComponents:@[@"user", @"current"]], (@[nameRoute, wildcardRoute, currentRoute]));
+    
+    [copy removeRoute:adminRoute];
+    XCTAssertEqualObjects([copy candidateRoutesForPathComponents:@[@"user", @"admin"]], (@[wildcardRoute, variableRoute]));
+    XCTAssertEqualObjects([trie candidateRoutesForPathComponents:@[@"user", @"admin"]], (@[nameRoute, adminRoute, wildcardRoute]));
+    
+    [trie removeAllRoutes];
+    XCTAssertEqual([trie candidateRoutesForPathComponents:@[@"user", @"current"]].count, 0UL);
+    XCTAssertEqual([copy candidateRoutesForPathComponents:@[@"user", @"current"]].count, 3UL);
+}
+
+- (void)testCompiledRouteDefinition
+{
+    JLRRouteDefinition *route = [[JLRRouteDefinition alloc] initWithScheme:JLRoutesGlobalRoutesScheme pattern:@"/user/:userID/*" priority:0 handlerBlock:nil];
+    
+    XCTAssertEqual(route.segmentCount, 3UL);
+    XCTAssertEqual(route.segments[0].type, JLRRouteSegmentTypeLiteral);
+    XCTAssertEqualObjects(route.segments[0].value, @"user");
+    XCTAssertEqual(route.segments[1].type, JLRRouteSegmentTypeVariable);
+    XCTAssertEqualObjects(route.segments[1].value, @"userID");
+    XCTAssertEqual(route.segments[2].type, JLRRouteSegmentTypeWildcard);
+    XCTAssertNil(route.segments[2].value);
+    XCTAssertTrue(route.containsWildcard);
+    XCTAssertEqual(route.minimumPathComponentCount, 2UL);
+    XCTAssertEqual(route.maximumPathComponentCount, NSUIntegerMax);
+    
+    JLRRouteDefinition *fragmentRoute = [[JLRRouteDefinition alloc] initWithScheme:JLRoutesGlobalRoutesScheme pattern:@"/:object#/:action" priority:0 handlerBlock:nil];
+    
+    XCTAssertEqualObjects(fragmentRoute.segments[0].value, @"object");
+    XCTAssertEqualObjects(fragmentRoute.segments[1].value, @"action");
+    XCTAssertFalse(fragmentRoute.containsWildcard);
+    XCTAssertEqual(fragmentRoute.minimumPathComponentCount, 2UL);
+    XCTAssertEqual(fragmentRoute.maximumPathComponentCount, 2UL);
+}
+
+- (void)testMissPathAllocations
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"allocationTests"];
+    for (NSUInteger index = 0; index < 1000; index++) {
+        [routes addRoute:[NSString stringWithFormat:@"/feature%@/:itemID", @(index)] handler:nil];
+    }
+    
+    NSArray <JLRRouteDefinition *> *allRoutes = routes.routes;
+    JLRRouteRequest *request = [[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:@"allocationTests://unknown/123"] alwaysTreatsHostAsPathComponent:NO];
+    NSUInteger matchCount = 0;
+    
+    // every route has the same number of components as the URL, so each one gets all the way to comparing literals
+    JLRStartCountingAllocations();
+    for (JLRRouteDefinition *route in allRoutes) {
+        if ([route routeResponseForRequest:request decodePlusSymbols:YES].isMatch) {
+            matchCount++;
+        }
+    }
+    JLRStopCountingAllocations();
+    
+    XCTAssertEqual(matchCount, 0UL);
+    XCTAssertEqual(JLRResponseAllocationCount, 0UL, @"A miss should not allocate a response");
+    XCTAssertEqual(JLRMutableDictionaryAllocationCount, 0UL, @"A miss should not allocate parameters");
+    XCTAssertEqual([JLRRouteResponse invalidMatchResponse], [JLRRouteResponse invalidMatchResponse]);
+    
+    // a hit still gets its own response and parameters
+    JLRRouteRequest *matchingRequest = [[JLRRouteRequest alloc] initWithURL:[NSURL URLWithString:@"allocationTests://feature999/123"] alwaysTreatsHostAsPathComponent:NO];
+    JLRStartCountingAllocations();
+    JLRRouteResponse *response = [allRoutes.lastObject routeResponseForRequest:matchingRequest decodePlusSymbols:YES];
+    JLRStopCountingAllocations();
+    
+    XCTAssertTrue(response.isMatch);
+    XCTAssertEqualObjects(response.parameters[@"itemID"], @"123");
+    XCTAssertEqual(JLRResponseAllocationCount, 1UL);
+}
+
+- (void)testMissPathPerformance
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"allocationTests"];
+    for (NSUInteger index = 0; index < 1000; index++) {
+        [routes addRoute:[NSString stringWithFormat:@"/feature%@/:itemID", @(index)] handler:nil];
+    }
+    
+    NSURL *URL = [NSURL URLWithString:@"allocationTests://unknown/123"];
+    
+    [self measureBlock:^{
+        for (NSUInteger iteration = 0; iteration < 100; iteration++) {
+            [routes routeURL:URL];
+        }
+    }];
+}
+
+- (void)testConcurrentRegistrationRoutingAndRemoval
+{
+    JLRoutes *routes = [JLRoutes routesForScheme:@"concurrencyTests"];
+    [routes addRoute:@"/stable/:value" handler:nil];
+    [[JLRoutes globalRoutes] addRoute:@"/global/:value" handler:nil];
+    routes.shouldFallbackToGlobalRoutes = YES;
+    
+    NSURL *stableURL = [NSURL URLWithString:@"concurrencyTests://stable/123"];
+    NSURL *fallbackURL = [NSURL URLWithString:@"concurrencyTests://global/123"];
+    __block NSUInteger failureCount = 0;
+    
+    dispatch_apply(4000, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        NSString *pattern = [NSString stringWithFormat:@"/dynamic%@/:value", @(iteration % 50)];
+        NSString *scheme = [NSString stringWithFormat:@"concurrencyTests%@", @(iteration % 10)];
+        BOOL succeeded = YES;
+        
+        switch (iteration % 6) {
+            case 0:
+                [routes addRoute:pattern priority:(iteration % 3) handler:nil];
+                break;
+            case 1:
+                [routes removeRoute:pattern];
+                break;
+            case 2:
+                succeeded = [routes routeURL:stableURL] && [JLRoutes canRouteURL:stableURL];
+                break;
+            case 3:
+                succeeded = [routes routeURL:fallbackURL];
+                break;
+            case 4:
+                [[JLRoutes routesForScheme:scheme] addRoute:pattern handler:nil];
+                succeeded = [JLRoutes canRouteURL:[NSURL URLWithString:[NSString stringWithFormat:@"%@://dynamic%@/1", scheme, @(iteration % 50)]]];
+                break;
+            default:
+                routes.usesCompiledMatcher = (iteration % 4 == 1);
+                succeeded = ([JLRoutes allRoutes].count > 0 && [routes routes].count > 0);
+                break;
+        }
+        
+        if (!succeeded) {
+            @synchronized (routes) {
+                failureCount++;
+            }
+        }
+    });
+    
+    XCTAssertEqual(failureCount, 0UL);
+    XCTAssertTrue([routes routeURL:stableURL]);
+}
+
 #pragma mark - Convenience Methods
 
 + (BOOL (^)(NSDictionary *))defaultRouteHandler